@@ -0,0 +1,497 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Catalog.h"
+#include "CatalogCache.h"
+#include "Clock.h"
+#include "IO.h"
+#include "MainLoop.h"
+#include "MappedFile.h"
+#include "P3IOButtons.h"
+#include "P3IOButtonsReference.h"
+#include "P3IOFrame.h"
+#include "PrefixIndex.h"
+#include "Scheduler.h"
+#include "ScriptedBackend.h"
+#include "TimerWheel.h"
+#include "Viewport.h"
+
+/* How long each case runs for, long enough to drown out clock granularity */
+#define BENCH_MIN_TIME_US 200000
+#define BENCH_QUICK_TIME_US 20000
+
+/* Same row layout the menu draws with at 1080 lines */
+#define BENCH_ROW_HEIGHT 20
+#define BENCH_ROW_PADDING 5
+#define BENCH_SCREEN_HEIGHT 1080
+
+#define BENCH_CATALOG_INI "bench_catalog.ini"
+#define BENCH_CATALOG_CACHE "bench_catalog.cache"
+
+/* Each call does operations units of work, results are reported per unit */
+typedef void (*bench_func_t)(void *context);
+
+static unsigned long long minimumTime = BENCH_MIN_TIME_US;
+static const char *filter = NULL;
+
+/* Results land here so the compiler can't throw the work away */
+static volatile unsigned int sink;
+
+/**
+ * Runs a case enough times to fill the minimum time and prints one CSV row:
+ * benchmark,parameter,iterations,ns_per_op
+ */
+static void Run(const char *name, unsigned int parameter, unsigned int operations, bench_func_t func, void *context)
+{
+    if (filter != NULL && strstr(name, filter) == NULL)
+    {
+        return;
+    }
+
+    /* One untimed pass so first touch page faults don't count */
+    func(context);
+
+    unsigned long long iterations = 1;
+    while (true)
+    {
+        unsigned long long start = ClockMicroseconds();
+        for (unsigned long long i = 0; i < iterations; i++)
+        {
+            func(context);
+        }
+        unsigned long long elapsed = ClockMicroseconds() - start;
+
+        if (elapsed >= minimumTime)
+        {
+            double ns = ((double)elapsed * 1000.0) / ((double)iterations * operations);
+            printf("%s,%u,%llu,%.2f\n", name, parameter, iterations * operations, ns);
+            fflush(stdout);
+            return;
+        }
+
+        /* Aim a little past the minimum so we usually only need one more pass */
+        if (elapsed < 1000)
+        {
+            iterations *= 10;
+        }
+        else
+        {
+            iterations = (iterations * minimumTime * 5) / (elapsed * 4) + 1;
+        }
+    }
+}
+
+/* Small deterministic generator so every run sees the same data */
+static unsigned int seed = 1;
+
+static unsigned int Random()
+{
+    seed = (seed * 1103515245) + 12345;
+    return (seed >> 8) & 0xFFFFFF;
+}
+
+/******************************************************************************
+ * P3IO framing
+ *****************************************************************************/
+
+typedef struct
+{
+    unsigned char payload[P3IO_MAX_PAYLOAD_LENGTH];
+    unsigned int length;
+    unsigned char frame[P3IO_MAX_FRAME_LENGTH];
+    unsigned int framelen;
+    P3IOFrameDecoder decoder;
+} frame_context_t;
+
+static void FillPayload(frame_context_t *context, unsigned int length)
+{
+    context->length = length;
+    for (unsigned int i = 0; i < length; i++)
+    {
+        /* Roughly one byte in sixteen needs escaping, like real JAMMA state */
+        unsigned int value = Random();
+        context->payload[i] = (value & 0xF00) == 0 ? ((value & 1) ? P3IO_SOM : P3IO_ESCAPE) : (unsigned char)value;
+    }
+    context->framelen = P3IOEncodeFrame(context->payload, length, 0, context->frame, sizeof(context->frame));
+}
+
+static void EncodeFrame(void *param)
+{
+    frame_context_t *context = (frame_context_t *)param;
+    sink += P3IOEncodeFrame(context->payload, context->length, sink & 0xF, context->frame, sizeof(context->frame));
+}
+
+static void DecodeFrame(void *param)
+{
+    frame_context_t *context = (frame_context_t *)param;
+    context->decoder.Reset();
+    context->decoder.Feed(context->frame, context->framelen);
+    sink += context->decoder.Length();
+}
+
+/******************************************************************************
+ * Button decode
+ *****************************************************************************/
+
+#define BENCH_JAMMA_PATTERNS 256
+
+typedef struct
+{
+    unsigned char jamma[BENCH_JAMMA_PATTERNS][P3IO_JAMMA_LENGTH];
+} buttons_context_t;
+
+static void DecodeButtons(void *param)
+{
+    buttons_context_t *context = (buttons_context_t *)param;
+    unsigned int buttons = 0;
+    for (unsigned int i = 0; i < BENCH_JAMMA_PATTERNS; i++)
+    {
+        buttons ^= P3IODecodeButtons(context->jamma[i]);
+    }
+    sink += buttons;
+}
+
+static void DecodeButtonsReference(void *param)
+{
+    buttons_context_t *context = (buttons_context_t *)param;
+    unsigned int buttons = 0;
+    for (unsigned int i = 0; i < BENCH_JAMMA_PATTERNS; i++)
+    {
+        buttons ^= P3IODecodeButtonsReference(context->jamma[i]);
+    }
+    sink += buttons;
+}
+
+/******************************************************************************
+ * Catalog loading
+ *****************************************************************************/
+
+typedef struct
+{
+    char *ini;
+    unsigned int length;
+    Catalog *catalog;
+    PrefixIndex *index;
+    char search[4];
+} catalog_context_t;
+
+/* Builds an INI of the given size with names spread over the alphabet */
+static void GenerateCatalog(catalog_context_t *context, unsigned int entries)
+{
+    /* Every entry comes out well under this many bytes */
+    context->ini = (char *)malloc((entries * 128) + 1);
+    context->length = 0;
+
+    for (unsigned int i = 0; i < entries; i++)
+    {
+        context->length += sprintf(
+            context->ini + context->length,
+            "[%c%c%c Game Mix %u]\r\nlaunch=C:\\games\\game%u\\contents\\gamestart.bat\r\n\r\n",
+            'A' + (Random() % 26),
+            'a' + (Random() % 26),
+            'a' + (Random() % 26),
+            i,
+            i
+        );
+    }
+
+    context->catalog = new Catalog();
+    context->catalog->Parse(context->ini, context->length);
+    context->index = new PrefixIndex();
+    context->index->Build(context->catalog);
+
+    /* Search for the first three letters of an entry from the middle */
+    memcpy(context->search, context->catalog->GetName(entries / 2), 3);
+    context->search[3] = 0;
+}
+
+static void FreeCatalog(catalog_context_t *context)
+{
+    delete context->index;
+    delete context->catalog;
+    free(context->ini);
+}
+
+static void ParseCatalog(void *param)
+{
+    catalog_context_t *context = (catalog_context_t *)param;
+    Catalog catalog;
+    catalog.Parse(context->ini, context->length);
+    sink += catalog.Count();
+}
+
+static void LoadCatalog(void *param)
+{
+    (void)param;
+    MappedFile file;
+    if (file.Open(BENCH_CATALOG_INI))
+    {
+        Catalog catalog;
+        catalog.Parse(file.Data(), file.Length());
+        sink += catalog.Count();
+    }
+}
+
+static void LoadCatalogCache(void *param)
+{
+    catalog_source_t *source = (catalog_source_t *)param;
+    MappedFile *image = CatalogCacheOpen(BENCH_CATALOG_CACHE);
+    if (image != NULL && CatalogCacheMatches(image, source, false))
+    {
+        /* Everything boot does before the menu can be searched */
+        Catalog catalog;
+        CatalogCacheAdopt(&catalog, image);
+        PrefixIndex index;
+        index.Build(&catalog);
+        sink += index.Count();
+    }
+    else
+    {
+        delete image;
+    }
+}
+
+static void SortCatalog(void *param)
+{
+    catalog_context_t *context = (catalog_context_t *)param;
+    context->catalog->Sort();
+    sink += context->catalog->Order()[0];
+}
+
+static void SearchIndex(void *param)
+{
+    catalog_context_t *context = (catalog_context_t *)param;
+    unsigned int first = 0;
+    unsigned int last = context->index->Count();
+    for (unsigned int depth = 0; context->search[depth] != 0; depth++)
+    {
+        context->index->Narrow(depth, context->search[depth], &first, &last);
+        sink += context->index->NextLetter(depth + 1, first, last, 0);
+    }
+    sink += last - first;
+}
+
+/******************************************************************************
+ * Menu layout
+ *****************************************************************************/
+
+#define BENCH_LAYOUT_STEPS 64
+
+typedef struct
+{
+    Viewport viewport;
+    unsigned int count;
+    unsigned int selected;
+} layout_context_t;
+
+/* One selection change and the row walk the display does to draw it */
+static void LayoutMenu(void *param)
+{
+    layout_context_t *context = (layout_context_t *)param;
+    for (unsigned int step = 0; step < BENCH_LAYOUT_STEPS; step++)
+    {
+        context->selected = (context->selected + 7) % context->count;
+        context->viewport.ScrollTo(context->selected);
+
+        int top = 0;
+        for (unsigned int item = context->viewport.First(); item < context->viewport.Last(); item++)
+        {
+            top += context->viewport.RowTop(item);
+        }
+        sink += top + context->viewport.RowAt(BENCH_SCREEN_HEIGHT / 2);
+    }
+}
+
+/******************************************************************************
+ * Main loop
+ *****************************************************************************/
+
+/* How long the scripted player keeps tapping right, longer than any run */
+#define BENCH_SCRIPT_SECONDS 600
+#define BENCH_SCRIPT_TAP_MS 20
+
+/* A menu with no window, where the player only ever scrolls right */
+class BenchView : public MenuView
+{
+public:
+    IO *io;
+    Viewport viewport;
+    unsigned int count;
+    unsigned int selected;
+
+    void Tick()
+    {
+        if (io->ButtonPressed(BUTTON_1P_MENURIGHT))
+        {
+            selected = (selected + 1) % count;
+            viewport.ScrollTo(selected);
+        }
+    }
+
+    bool WasClosed() { return false; }
+    bool ShouldBootDefault() { return false; }
+    unsigned int GetSelectedItem() { return selected; }
+};
+
+typedef struct
+{
+    MainLoop *loop;
+    BenchView *view;
+} loop_context_t;
+
+/* Everything the menu does on a tick short of drawing and waiting */
+static void MainLoopTick(void *param)
+{
+    loop_context_t *context = (loop_context_t *)param;
+    context->loop->Tick();
+    sink += context->view->selected;
+}
+
+/******************************************************************************
+ * Driver
+ *****************************************************************************/
+
+static const unsigned int payloadSizes[] = { 1, 6, 64, P3IO_MAX_PAYLOAD_LENGTH };
+static const unsigned int catalogSizes[] = { 10, 100, 1000, 10000, 100000 };
+
+static void BenchFrames()
+{
+    frame_context_t *context = new frame_context_t;
+
+    for (unsigned int i = 0; i < sizeof(payloadSizes) / sizeof(payloadSizes[0]); i++)
+    {
+        FillPayload(context, payloadSizes[i]);
+        Run("p3io_encode", payloadSizes[i], 1, EncodeFrame, context);
+        Run("p3io_decode", payloadSizes[i], 1, DecodeFrame, context);
+    }
+
+    delete context;
+}
+
+static void BenchButtons()
+{
+    buttons_context_t context;
+    for (unsigned int i = 0; i < BENCH_JAMMA_PATTERNS; i++)
+    {
+        for (unsigned int j = 0; j < P3IO_JAMMA_LENGTH; j++)
+        {
+            context.jamma[i][j] = (unsigned char)Random();
+        }
+    }
+
+    Run("button_decode", 0, BENCH_JAMMA_PATTERNS, DecodeButtons, &context);
+    Run("button_decode_branches", 0, BENCH_JAMMA_PATTERNS, DecodeButtonsReference, &context);
+}
+
+static void BenchCatalogs()
+{
+    for (unsigned int i = 0; i < sizeof(catalogSizes) / sizeof(catalogSizes[0]); i++)
+    {
+        unsigned int entries = catalogSizes[i];
+        catalog_context_t context;
+        GenerateCatalog(&context, entries);
+
+        Run("ini_parse", entries, 1, ParseCatalog, &context);
+
+        FILE *fp = fopen(BENCH_CATALOG_INI, "wb");
+        if (fp != NULL)
+        {
+            fwrite(context.ini, 1, context.length, fp);
+            fclose(fp);
+
+            catalog_source_t source;
+            if (CatalogSourceInfo(BENCH_CATALOG_INI, &source))
+            {
+                source.hash = CatalogHash(context.ini, context.length);
+                Run("ini_load", entries, 1, LoadCatalog, NULL);
+                if (CatalogCacheSave(context.catalog, BENCH_CATALOG_CACHE, &source))
+                {
+                    Run("cache_load", entries, 1, LoadCatalogCache, &source);
+                }
+            }
+
+            remove(BENCH_CATALOG_CACHE);
+            remove(BENCH_CATALOG_INI);
+        }
+        else
+        {
+            fprintf(stderr, "Couldn't write %s, skipping file loads!\n", BENCH_CATALOG_INI);
+        }
+
+        Run("index_sort", entries, 1, SortCatalog, &context);
+        Run("index_search", entries, 1, SearchIndex, &context);
+
+        layout_context_t *layout = new layout_context_t;
+        layout->viewport.SetLayout(BENCH_ROW_HEIGHT, BENCH_ROW_PADDING, BENCH_SCREEN_HEIGHT);
+        layout->viewport.SetCount(entries);
+        layout->count = entries;
+        layout->selected = 0;
+        Run("menu_layout", entries, BENCH_LAYOUT_STEPS, LayoutMenu, layout);
+        delete layout;
+
+        FreeCatalog(&context);
+    }
+}
+
+static void BenchMainLoop()
+{
+    ScriptedBackend *backend = new ScriptedBackend();
+    for (unsigned int ms = BENCH_SCRIPT_TAP_MS; ms < BENCH_SCRIPT_SECONDS * 1000; ms += BENCH_SCRIPT_TAP_MS * 2)
+    {
+        backend->Add(ms, BUTTON_1P_MENURIGHT);
+        backend->Add(ms + BENCH_SCRIPT_TAP_MS, 0);
+    }
+
+    IO *io = new IO(backend);
+    TimerWheel *timers = new TimerWheel(ClockUpdate());
+    Scheduler *scheduler = new Scheduler();
+
+    BenchView *view = new BenchView();
+    view->io = io;
+    view->viewport.SetLayout(BENCH_ROW_HEIGHT, BENCH_ROW_PADDING, BENCH_SCREEN_HEIGHT);
+    view->viewport.SetCount(1000);
+    view->count = 1000;
+    view->selected = 0;
+
+    loop_context_t context;
+    context.loop = new MainLoop(io, timers, scheduler, view);
+    context.view = view;
+    context.loop->Start(ClockNow());
+
+    Run("main_loop_tick", view->count, 1, MainLoopTick, &context);
+
+    delete context.loop;
+    delete view;
+    delete scheduler;
+    delete timers;
+    delete io;
+}
+
+int main(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--quick") == 0)
+        {
+            minimumTime = BENCH_QUICK_TIME_US;
+        }
+        else if (argv[i][0] == '-')
+        {
+            fprintf(stderr, "Usage: %s [--quick] [benchmark name filter]\n", argv[0]);
+            return 1;
+        }
+        else
+        {
+            filter = argv[i];
+        }
+    }
+
+    printf("benchmark,parameter,iterations,ns_per_op\n");
+    BenchFrames();
+    BenchButtons();
+    BenchCatalogs();
+    BenchMainLoop();
+
+    return 0;
+}
@@ -0,0 +1,67 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Clock.h"
+#include "EvdevSource.h"
+#include "IO.h"
+
+/* How long to watch for when no time is given */
+#define MONITOR_DEFAULT_SECONDS 10
+
+/* Stands in for a cabinet that isn't there, so only the other sources count */
+class NoCabinet : public IOBackend
+{
+public:
+    bool Ready() { return false; }
+    unsigned int PollButtons() { return 0; }
+    void SetCabLights(unsigned int cablights) { (void)cablights; }
+    void SetPadLights(unsigned int padlights) { (void)padlights; }
+};
+
+/**
+ * Prints every button edge from the keyboards and gamepads on this machine,
+ * then how long each of them took to get through to the main loop.
+ */
+int main(int argc, char *argv[])
+{
+    unsigned int seconds = argc > 1 ? (unsigned int)atoi(argv[1]) : MONITOR_DEFAULT_SECONDS;
+
+    InputMux *inputs = new InputMux();
+    if (EvdevSource::Discover(inputs) == 0)
+    {
+        fprintf(stderr, "No usable input devices, check permissions on /dev/input!\n");
+        delete inputs;
+        return 1;
+    }
+
+    for (unsigned int i = 0; i < inputs->Count(); i++)
+    {
+        printf("watching %s\n", inputs->Name(i));
+    }
+
+    IO *io = new IO(new NoCabinet(), inputs);
+    unsigned long long started = ClockMicroseconds();
+    unsigned long long stop = started + (seconds * 1000000ULL);
+
+    while (ClockMicroseconds() < stop)
+    {
+        /* Only wake up when there's something, like the menu does */
+        io->InputEvent()->Wait(100);
+        io->Tick();
+
+        if (io->ButtonsPressed() != 0)
+        {
+            printf(
+                "%llu ms: pressed %06X, holding %06X\n",
+                (io->ButtonPressedAt(io->ButtonsPressed()) - started) / 1000,
+                io->ButtonsPressed(),
+                io->ButtonsHeld()
+            );
+        }
+    }
+
+    io->DumpInputStats(stdout);
+    delete io;
+
+    return 0;
+}
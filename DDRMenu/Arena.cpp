@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Arena.h"
+
+Arena::Arena()
+{
+    base = NULL;
+    used = 0;
+    capacity = 0;
+}
+
+Arena::~Arena()
+{
+    free(base);
+}
+
+/**
+ * Makes sure there is room for at least size bytes in total, so callers who
+ * know roughly how much they need can avoid growing more than once.
+ */
+bool Arena::Reserve(unsigned int size)
+{
+    if (size <= capacity)
+    {
+        return true;
+    }
+
+    unsigned int newCapacity = capacity > 0 ? capacity : ARENA_INITIAL_SIZE;
+    while (newCapacity < size)
+    {
+        newCapacity *= 2;
+    }
+
+    char *newBase = (char *)realloc(base, newCapacity);
+    if (newBase == NULL)
+    {
+        fprintf(stderr, "Failed to grow arena to %u bytes!\n", newCapacity);
+        return false;
+    }
+
+    base = newBase;
+    capacity = newCapacity;
+    return true;
+}
+
+unsigned int Arena::Allocate(unsigned int length)
+{
+    /* Keep everything pointer aligned so records can live here too */
+    unsigned int aligned = (length + (sizeof(void *) - 1)) & ~(unsigned int)(sizeof(void *) - 1);
+    if (!Reserve(used + aligned))
+    {
+        abort();
+    }
+
+    unsigned int offset = used;
+    used += aligned;
+    return offset;
+}
+
+unsigned int Arena::AddString(const char *string, unsigned int length)
+{
+    if (!Reserve(used + length + 1))
+    {
+        abort();
+    }
+
+    /* Strings are packed back to back with no padding */
+    unsigned int offset = used;
+    memcpy(base + offset, string, length);
+    base[offset + length] = 0;
+    used += length + 1;
+    return offset;
+}
+
+void Arena::Reset()
+{
+    used = 0;
+}
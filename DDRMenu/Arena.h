@@ -0,0 +1,29 @@
+#pragma once
+
+/* Arenas start out this big and double whenever they run out */
+#define ARENA_INITIAL_SIZE 4096
+
+/**
+ * Bump allocator over one contiguous block. Allocations hand back offsets
+ * rather than pointers, since the block moves when it grows. Nothing is freed
+ * individually, the whole arena goes away at once.
+ */
+class Arena
+{
+public:
+    Arena();
+    ~Arena();
+
+    bool Reserve(unsigned int size);
+    unsigned int Allocate(unsigned int length);
+    unsigned int AddString(const char *string, unsigned int length);
+    void Reset();
+
+    char *Get(unsigned int offset) { return base + offset; }
+    char *Base() { return base; }
+    unsigned int Size() { return used; }
+private:
+    char *base;
+    unsigned int used;
+    unsigned int capacity;
+};
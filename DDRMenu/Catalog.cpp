@@ -0,0 +1,182 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "Catalog.h"
+
+/* One entry being sorted, with its name looked up once instead of on every compare */
+typedef struct
+{
+    const char *name;
+    unsigned int entry;
+} catalog_sort_t;
+
+static char Fold(char letter)
+{
+    return (letter >= 'a' && letter <= 'z') ? letter - 'a' + 'A' : letter;
+}
+
+int CatalogCompareNames(const char *leftName, const char *rightName)
+{
+    const unsigned char *left = (const unsigned char *)leftName;
+    const unsigned char *right = (const unsigned char *)rightName;
+
+    while (*left != 0 && Fold(*left) == Fold(*right))
+    {
+        left++;
+        right++;
+    }
+
+    return (unsigned char)Fold(*left) - (unsigned char)Fold(*right);
+}
+
+static int CompareEntries(const void *a, const void *b)
+{
+    const catalog_sort_t *left = (const catalog_sort_t *)a;
+    const catalog_sort_t *right = (const catalog_sort_t *)b;
+
+    int difference = CatalogCompareNames(left->name, right->name);
+    if (difference == 0)
+    {
+        /* Keep the catalog order between entries with the same name */
+        return left->entry < right->entry ? -1 : 1;
+    }
+    return difference;
+}
+
+Catalog::Catalog()
+{
+    image = NULL;
+    table = NULL;
+    order = NULL;
+    text = NULL;
+    textlen = 0;
+    count = 0;
+}
+
+Catalog::~Catalog()
+{
+    delete image;
+}
+
+void Catalog::Add(const char *name, unsigned int namelen, const char *location, unsigned int locationlen)
+{
+    unsigned int entry = entries.Allocate(sizeof(launcher_program_t));
+    unsigned int nameOffset = strings.AddString(name, namelen);
+    unsigned int locationOffset = strings.AddString(location, locationlen);
+
+    launcher_program_t *program = (launcher_program_t *)entries.Get(entry);
+    program->name = nameOffset;
+    program->location = locationOffset;
+    count++;
+    order = NULL;
+
+    /* Arenas may have moved while growing */
+    table = (const launcher_program_t *)entries.Base();
+    text = strings.Base();
+    textlen = strings.Size();
+}
+
+/**
+ * Points the catalog at entries, their name order and strings that already
+ * exist in memory, taking ownership of the file they were mapped from.
+ */
+void Catalog::Adopt(MappedFile *file, const launcher_program_t *newTable, unsigned int newCount, const unsigned int *newOrder, const char *newText, unsigned int newTextlen)
+{
+    delete image;
+    entries.Reset();
+    strings.Reset();
+    orders.Reset();
+
+    image = file;
+    table = newTable;
+    count = newCount;
+    order = newOrder;
+    text = newText;
+    textlen = newTextlen;
+}
+
+/**
+ * Works out every entry's place in name order, ignoring case, for Order().
+ * Everything the sort needs is local, so catalogs can be sorted on any
+ * thread at once.
+ */
+void Catalog::Sort()
+{
+    catalog_sort_t *pending = (catalog_sort_t *)malloc((count > 0 ? count : 1) * sizeof(catalog_sort_t));
+    for (unsigned int i = 0; i < count; i++)
+    {
+        pending[i].name = GetName(i);
+        pending[i].entry = i;
+    }
+    qsort(pending, count, sizeof(catalog_sort_t), CompareEntries);
+
+    orders.Reset();
+    unsigned int *sorted = (unsigned int *)orders.Get(orders.Allocate((count > 0 ? count : 1) * sizeof(unsigned int)));
+    for (unsigned int i = 0; i < count; i++)
+    {
+        sorted[i] = pending[i].entry;
+    }
+    order = sorted;
+
+    free(pending);
+}
+
+/**
+ * Parses an INI file with the following format, in a single pass:
+ *
+ * [Name of game to launch]
+ * launch=<location of batch/executable>
+ */
+void Catalog::Parse(const char *data, unsigned int length)
+{
+    /* Every string we keep is a piece of the file, so this is enough room */
+    strings.Reserve(strings.Size() + length + 1);
+
+    const char *end = data + length;
+    const char *line = data;
+    const char *name = NULL;
+    unsigned int namelen = 0;
+
+    while (line < end)
+    {
+        /* Find the end of this line, ignoring \r */
+        const char *eol = (const char *)memchr(line, '\n', end - line);
+        if (eol == NULL)
+        {
+            eol = end;
+        }
+
+        unsigned int buflen = (unsigned int)(eol - line);
+        while (buflen > 0 && line[buflen - 1] == '\r')
+        {
+            buflen--;
+        }
+
+        /* Process line */
+        if (buflen > 2 && line[0] == '[' && line[buflen - 1] == ']')
+        {
+            name = line + 1;
+            namelen = buflen - 2;
+        }
+        else if (buflen >= 6 && strncmp(line, "launch", 6) == 0)
+        {
+            unsigned int loc = 6;
+
+            // Find equals sign after space
+            while (loc < buflen && (line[loc] == ' ' || line[loc] == '\t')) { loc++; }
+            if (loc < buflen && line[loc] == '=')
+            {
+                loc++;
+                while (loc < buflen && (line[loc] == ' ' || line[loc] == '\t')) { loc++; }
+                if (loc < buflen && name != NULL)
+                {
+                    /* We have a name to associate with this */
+                    Add(name, namelen, line + loc, buflen - loc);
+                    name = NULL;
+                }
+            }
+        }
+
+        line = eol + 1;
+    }
+}
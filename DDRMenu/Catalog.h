@@ -0,0 +1,53 @@
+#pragma once
+
+#include "Arena.h"
+#include "MappedFile.h"
+
+/* Offsets of each string in the catalog's string table */
+typedef struct
+{
+    unsigned int location;
+    unsigned int name;
+} launcher_program_t;
+
+/* Orders names ignoring case, the way Sort() lines entries up */
+int CatalogCompareNames(const char *leftName, const char *rightName);
+
+/**
+ * The list of games we know how to launch. Entries and their strings both
+ * live in arenas, so building a catalog costs a handful of allocations no
+ * matter how many games are in it. A catalog can also be backed directly by
+ * a mapped cache image, in which case nothing is copied at all, not even the
+ * name order the image was saved with.
+ */
+class Catalog
+{
+public:
+    Catalog();
+    ~Catalog();
+
+    void Parse(const char *data, unsigned int length);
+    void Add(const char *name, unsigned int namelen, const char *location, unsigned int locationlen);
+    void Adopt(MappedFile *file, const launcher_program_t *table, unsigned int count, const unsigned int *order, const char *text, unsigned int textlen);
+    void Sort();
+
+    unsigned int Count() { return count; }
+    const char *GetName(unsigned int entry) { return text + table[entry].name; }
+    const char *GetLocation(unsigned int entry) { return text + table[entry].location; }
+
+    const launcher_program_t *Table() { return table; }
+    const unsigned int *Order() { return order; }
+    const char *Text() { return text; }
+    unsigned int TextLength() { return textlen; }
+private:
+    Arena entries;
+    Arena strings;
+    Arena orders;
+    MappedFile *image;
+
+    const launcher_program_t *table;
+    const unsigned int *order;
+    const char *text;
+    unsigned int textlen;
+    unsigned int count;
+};
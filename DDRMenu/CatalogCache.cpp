@@ -0,0 +1,273 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+#include "CatalogCache.h"
+
+bool CatalogSourceInfo(const _TCHAR *path, catalog_source_t *source)
+{
+    source->hash = 0;
+
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    if (!GetFileAttributesEx(path, GetFileExInfoStandard, &info))
+    {
+        return false;
+    }
+
+    source->size = ((unsigned long long)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+    source->modified = ((unsigned long long)info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime;
+#else
+    struct stat info;
+    if (stat(path, &info) != 0)
+    {
+        return false;
+    }
+
+    source->size = (unsigned long long)info.st_size;
+    source->modified = ((unsigned long long)info.st_mtim.tv_sec * 1000000000) + info.st_mtim.tv_nsec;
+#endif
+
+    return true;
+}
+
+/**
+ * 64-bit FNV-1a. Not cryptographic, only needs to notice edits.
+ */
+unsigned long long CatalogHash(const char *data, unsigned int length)
+{
+    unsigned long long hash = 0xCBF29CE484222325ULL;
+    for (unsigned int i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)data[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+/**
+ * Maps a cache image in and makes sure it's structurally sound. This only
+ * walks the table checking offsets, nothing is parsed.
+ */
+MappedFile *CatalogCacheOpen(const _TCHAR *path)
+{
+    MappedFile *image = new MappedFile();
+    if (!image->Open(path) || image->Length() < sizeof(catalog_cache_header_t))
+    {
+        delete image;
+        return NULL;
+    }
+
+    const catalog_cache_header_t *header = (const catalog_cache_header_t *)image->Data();
+    unsigned long long expected = sizeof(catalog_cache_header_t) +
+                                  ((unsigned long long)header->count * (sizeof(launcher_program_t) + sizeof(unsigned int))) +
+                                  header->textlen;
+
+    if (
+        header->magic != CATALOG_CACHE_MAGIC ||
+        header->version != CATALOG_CACHE_VERSION ||
+        expected != image->Length() ||
+        header->textlen == 0 ||
+        image->Data()[image->Length() - 1] != 0
+    ) {
+        fprintf(stderr, "Ignoring malformed catalog cache!\n");
+        delete image;
+        return NULL;
+    }
+
+    /* The text ends in a terminator, so any string starting inside it ends inside it too */
+    const launcher_program_t *table = (const launcher_program_t *)(header + 1);
+    const unsigned int *order = (const unsigned int *)(table + header->count);
+    for (unsigned int i = 0; i < header->count; i++)
+    {
+        if (table[i].name >= header->textlen || table[i].location >= header->textlen || order[i] >= header->count)
+        {
+            fprintf(stderr, "Ignoring corrupt catalog cache!\n");
+            delete image;
+            return NULL;
+        }
+    }
+
+    return image;
+}
+
+bool CatalogCacheMatches(MappedFile *image, const catalog_source_t *source, bool checkHash)
+{
+    const catalog_cache_header_t *header = (const catalog_cache_header_t *)image->Data();
+
+    if (header->source.size != source->size)
+    {
+        return false;
+    }
+
+    /* Same size and contents means a file that was only touched or copied */
+    if (checkHash)
+    {
+        return header->source.hash == source->hash;
+    }
+    return header->source.modified == source->modified;
+}
+
+void CatalogCacheAdopt(Catalog *catalog, MappedFile *image)
+{
+    const catalog_cache_header_t *header = (const catalog_cache_header_t *)image->Data();
+    const launcher_program_t *table = (const launcher_program_t *)(header + 1);
+    const unsigned int *order = (const unsigned int *)(table + header->count);
+    const char *text = (const char *)(order + header->count);
+
+    catalog->Adopt(image, table, header->count, order, text, header->textlen);
+}
+
+/**
+ * Writes the catalog out as a cache image for next time, sorted so that
+ * loading it never has to sort.
+ */
+bool CatalogCacheSave(Catalog *catalog, const _TCHAR *path, const catalog_source_t *source)
+{
+    if (catalog->Order() == NULL)
+    {
+        catalog->Sort();
+    }
+
+    catalog_cache_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.magic = CATALOG_CACHE_MAGIC;
+    header.version = CATALOG_CACHE_VERSION;
+    header.source = *source;
+    header.count = catalog->Count();
+    header.textlen = catalog->TextLength();
+
+    /* An empty catalog still gets a terminator so the image is never zero length */
+    const char *text = catalog->Text();
+    if (header.textlen == 0)
+    {
+        text = "";
+        header.textlen = 1;
+    }
+
+    const void *pieces[4] = { &header, catalog->Table(), catalog->Order(), text };
+    unsigned int lengths[4] = {
+        sizeof(header),
+        (unsigned int)(header.count * sizeof(launcher_program_t)),
+        (unsigned int)(header.count * sizeof(unsigned int)),
+        header.textlen
+    };
+
+    return CacheWrite(path, pieces, lengths, 4);
+}
+
+/**
+ * Writes a file out in pieces next to a temporary name and swaps it into
+ * place, so a power cut halfway through never leaves a torn cache behind.
+ */
+bool CacheWrite(const _TCHAR *path, const void *const *pieces, const unsigned int *lengths, unsigned int count)
+{
+#ifdef _WIN32
+    unsigned int templen = wcslen(path) + 5;
+    wchar_t *temp = new wchar_t[templen];
+    wcscpy_s(temp, templen, path);
+    wcscat_s(temp, templen, L".tmp");
+
+    HANDLE file = CreateFile(temp, GENERIC_WRITE, 0, 0, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        fprintf(stderr, "Failed to create cache file!\n");
+        delete[] temp;
+        return false;
+    }
+
+    bool ok = true;
+    for (unsigned int i = 0; i < count && ok; i++)
+    {
+        DWORD actual = 0;
+        ok = lengths[i] == 0 || (WriteFile(file, pieces[i], lengths[i], &actual, 0) && actual == lengths[i]);
+    }
+
+    /* On disk before the rename, or a power cut can leave the new name on empty blocks */
+    ok = ok && FlushFileBuffers(file);
+    CloseHandle(file);
+
+    if (!ok || !MoveFileEx(temp, path, MOVEFILE_REPLACE_EXISTING))
+    {
+        fprintf(stderr, "Failed to write cache file!\n");
+        DeleteFile(temp);
+        delete[] temp;
+        return false;
+    }
+    delete[] temp;
+#else
+    unsigned int templen = strlen(path) + 5;
+    char *temp = new char[templen];
+    strcpy(temp, path);
+    strcat(temp, ".tmp");
+
+    FILE *file = fopen(temp, "wb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Failed to create cache file!\n");
+        delete[] temp;
+        return false;
+    }
+
+    bool ok = true;
+    for (unsigned int i = 0; i < count && ok; i++)
+    {
+        ok = lengths[i] == 0 || fwrite(pieces[i], 1, lengths[i], file) == lengths[i];
+    }
+
+    /* On disk before the rename, or a power cut can leave the new name on empty blocks */
+    ok = ok && fflush(file) == 0 && fsync(fileno(file)) == 0;
+    ok = (fclose(file) == 0) && ok;
+
+    if (!ok || rename(temp, path) != 0)
+    {
+        fprintf(stderr, "Failed to write cache file!\n");
+        remove(temp);
+        delete[] temp;
+        return false;
+    }
+    delete[] temp;
+#endif
+
+    return true;
+}
+
+/**
+ * Updates the source recorded in an existing cache without rewriting the
+ * body, for when the INI was touched but its contents didn't change.
+ */
+bool CatalogCacheTouch(const _TCHAR *path, const catalog_source_t *source)
+{
+    unsigned int offset = offsetof(catalog_cache_header_t, source);
+
+#ifdef _WIN32
+    HANDLE file = CreateFile(path, GENERIC_WRITE, 0, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    OVERLAPPED position = { 0 };
+    position.Offset = offset;
+    DWORD actual = 0;
+    bool ok = WriteFile(file, source, sizeof(*source), &actual, &position) && actual == sizeof(*source);
+    CloseHandle(file);
+    return ok;
+#else
+    int file = open(path, O_WRONLY);
+    if (file < 0)
+    {
+        return false;
+    }
+
+    bool ok = pwrite(file, source, sizeof(*source), offset) == (ssize_t)sizeof(*source);
+    close(file);
+    return ok;
+#endif
+}
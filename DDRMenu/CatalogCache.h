@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Catalog.h"
+#include "MappedFile.h"
+
+/* Bump this whenever the layout below changes */
+#define CATALOG_CACHE_MAGIC 0x43524444
+#define CATALOG_CACHE_VERSION 2
+
+/* What a cache image was built from, so we can tell when it's stale */
+typedef struct
+{
+    unsigned long long size;
+    unsigned long long modified;
+    unsigned long long hash;
+} catalog_source_t;
+
+/* Followed by count entries, count entry numbers in name order, then textlen bytes of strings */
+typedef struct
+{
+    unsigned int magic;
+    unsigned int version;
+    catalog_source_t source;
+    unsigned int count;
+    unsigned int textlen;
+} catalog_cache_header_t;
+
+bool CatalogSourceInfo(const _TCHAR *path, catalog_source_t *source);
+unsigned long long CatalogHash(const char *data, unsigned int length);
+
+MappedFile *CatalogCacheOpen(const _TCHAR *path);
+bool CatalogCacheMatches(MappedFile *image, const catalog_source_t *source, bool checkHash);
+void CatalogCacheAdopt(Catalog *catalog, MappedFile *image);
+bool CatalogCacheSave(Catalog *catalog, const _TCHAR *path, const catalog_source_t *source);
+bool CatalogCacheTouch(const _TCHAR *path, const catalog_source_t *source);
+
+bool CacheWrite(const _TCHAR *path, const void *const *pieces, const unsigned int *lengths, unsigned int count);
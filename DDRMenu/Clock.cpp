@@ -0,0 +1,77 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#include <sys/resource.h>
+#endif
+
+#include "Clock.h"
+
+unsigned long long ClockMicroseconds()
+{
+#ifdef _WIN32
+    static LONGLONG frequency = 0;
+    if (frequency == 0)
+    {
+        LARGE_INTEGER freq;
+        QueryPerformanceFrequency(&freq);
+        frequency = freq.QuadPart;
+    }
+
+    /* Split the division up so we don't overflow on long uptimes */
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    unsigned long long seconds = counter.QuadPart / frequency;
+    unsigned long long remainder = counter.QuadPart % frequency;
+    return (seconds * 1000000) + ((remainder * 1000000) / frequency);
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((unsigned long long)now.tv_sec * 1000000) + (now.tv_nsec / 1000);
+#endif
+}
+
+static unsigned long long tickTime = 0;
+
+unsigned long long ClockUpdate()
+{
+    tickTime = ClockMicroseconds();
+    return tickTime;
+}
+
+unsigned long long ClockNow()
+{
+    if (tickTime == 0)
+    {
+        return ClockUpdate();
+    }
+    return tickTime;
+}
+
+unsigned long long ClockProcessMicroseconds()
+{
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+    {
+        return 0;
+    }
+
+    /* Both are in 100ns units */
+    ULARGE_INTEGER kernelTime, userTime;
+    kernelTime.LowPart = kernel.dwLowDateTime;
+    kernelTime.HighPart = kernel.dwHighDateTime;
+    userTime.LowPart = user.dwLowDateTime;
+    userTime.HighPart = user.dwHighDateTime;
+    return (kernelTime.QuadPart + userTime.QuadPart) / 10;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+        return 0;
+    }
+
+    return ((unsigned long long)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000) +
+           usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+#endif
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+/* Microseconds since some arbitrary point, never goes backwards */
+unsigned long long ClockMicroseconds();
+
+/* Reads the clock once for the main loop tick, ClockNow() returns the same
+   value until the next update so a tick sees one consistent time */
+unsigned long long ClockUpdate();
+unsigned long long ClockNow();
+
+/* Microseconds of CPU time this process has used across all threads */
+unsigned long long ClockProcessMicroseconds();
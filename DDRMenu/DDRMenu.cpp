@@ -9,6 +9,63 @@
 #include "Display.h"
 #include "Menu.h"
 #include "IO.h"
+#include "P3IOBackend.h"
+#include "ScriptedBackend.h"
+#include "RawInputSource.h"
+#include "Clock.h"
+#include "Scheduler.h"
+#include "Launcher.h"
+#include "MainLoop.h"
+#include "Prefetcher.h"
+#include "TimerWheel.h"
+
+/**
+ * The window and the menu behind it, as the main loop sees them. Also keeps
+ * the prefetcher following whatever is highlighted.
+ */
+class DisplayView : public MenuView
+{
+public:
+    DisplayView(Display *display, Menu *menu, Prefetcher *prefetcher)
+    {
+        this->display = display;
+        this->menu = menu;
+        this->prefetcher = prefetcher;
+        prefetched = display->GetSelectedItem();
+        prefetchedGeneration = menu->Generation();
+        prefetcher->Target(menu->GetEntryPath(prefetched));
+    }
+
+    void Tick()
+    {
+        display->Tick();
+
+        /* Follow the selection with the prefetcher, entries are numbered
+           differently once the INI has been reloaded */
+        if (display->GetSelectedItem() != prefetched || menu->Generation() != prefetchedGeneration)
+        {
+            prefetched = display->GetSelectedItem();
+            prefetchedGeneration = menu->Generation();
+            prefetcher->Target(menu->GetEntryPath(prefetched));
+        }
+    }
+
+    bool WasClosed() { return display->WasClosed(); }
+    bool ShouldBootDefault() { return menu->ShouldBootDefault(); }
+    unsigned int GetSelectedItem() { return display->GetSelectedItem(); }
+
+    void DumpStats(FILE *fp)
+    {
+        display->DumpLatency(fp);
+        menu->DumpValidation(fp);
+    }
+private:
+    Display *display;
+    Menu *menu;
+    Prefetcher *prefetcher;
+    unsigned int prefetched;
+    unsigned int prefetchedGeneration;
+};
 
 int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine, int nCmdShow)
 {
@@ -29,7 +86,24 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine
         return 1;
     }
 
-    if( argc > 2 )
+    /* Optionally run against a scripted cabinet instead of real hardware */
+    ScriptedBackend *script = NULL;
+    if( argc == 4 && wcscmp(argv[2], L"--script") == 0 )
+    {
+        script = new ScriptedBackend();
+        if (!script->Load(argv[3]))
+        {
+            MessageBox(
+                NULL,
+                (LPCWSTR)L"Could not open input script!",
+                (LPCWSTR)L"Invalid Invocation",
+                MB_ICONERROR | MB_OK | MB_DEFBUTTON1
+            );
+            delete script;
+            return 1;
+        }
+    }
+    else if( argc > 2 )
     {
         MessageBox(
             NULL,
@@ -41,7 +115,18 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine
     }
 
     // Initialize the IO
-    IO *io = new IO();
+    bool scripted = script != NULL;
+    IOBackend *backend = script;
+    InputMux *inputs = NULL;
+    if (backend == NULL)
+    {
+        backend = new P3IOBackend();
+
+        /* Keyboards work alongside the cabinet, or instead of one that's missing */
+        inputs = new InputMux();
+        inputs->Add(new RawInputSource());
+    }
+    IO *io = new IO(backend, inputs);
     if (!io->Ready())
     {
         // Failed to initialize, give up
@@ -67,79 +152,82 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine
         return 1;
     }
 
+    /* Everything that has to happen at a certain time goes through here */
+    unsigned long long started = ClockUpdate();
+    TimerWheel *timers = new TimerWheel(started);
+
     /* Create menu screen */
-    Display *display = new Display(hInstance, io, menu);
+    Display *display = new Display(hInstance, io, menu, timers);
+
+    /* The first frame is up, so check launch targets behind it */
+    menu->StartValidation();
 
     /* Actual game to load */
     char *path = NULL;
 
-    /* It may have taken a long time to init */
-    menu->ResetTimeout();
+    /* Get the highlighted game off the disk while people make up their minds */
+    Prefetcher *prefetcher = new Prefetcher();
+    DisplayView view(display, menu, prefetcher);
 
-    // Input loop
-    while(true) {
-        io->Tick();
-        menu->Tick();
-        display->Tick();
+    /* It may have taken a long time to init, so start the countdown now */
+    started = ClockUpdate();
+    menu->StartTimeout(timers);
 
-        /* See if somebody killed the display window */
-        if (display->WasClosed())
-        {
-            break;
-        }
+    /* Only run the loop when there's something to do */
+    Scheduler *scheduler = new Scheduler(MENU_TICK_RATE_HZ);
+    HANDLE inputEvent = io->InputEvent()->Handle();
 
-        /* Check to see if we ran out of time waiting for input, and to see
-           if the user confirmed a selection */
-        if (
-            menu->ShouldBootDefault() ||
-            io->ButtonPressed(BUTTON_1P_START) ||
-            io->ButtonPressed(BUTTON_2P_START)
-        ) {
-            int entry = display->GetSelectedItem();
-            path = menu->GetEntryPath(entry);
-            break;
-        }
+    MainLoop *loop = new MainLoop(io, timers, scheduler, &view);
+    loop->Start(started);
 
-        /* Update lights blinking so people know they can use the menu */
-        if (menu->SecondsLeft() & 1)
-        {
-            io->LightOn(LIGHT_1P_MENU);
-            io->LightOn(LIGHT_2P_MENU);
-        }
-        else
-        {
-            io->LightOff(LIGHT_1P_MENU);
-            io->LightOff(LIGHT_2P_MENU);
-        }
+    /* Sleep until the next tick or timer is due, the poller sees an input
+       edge, or the window has messages to handle */
+    while (loop->Tick())
+    {
+        MsgWaitForMultipleObjects(1, &inputEvent, FALSE, loop->MillisecondsUntilNext(), QS_ALLINPUT);
     }
 
-    // Close and free libraries
+    if (loop->Chosen() != MAIN_LOOP_NO_ENTRY)
+    {
+        /* Hang on to our own copy, the menu is going away */
+        const char *location = menu->GetEntryPath(loop->Chosen());
+        path = new char[strlen(location) + 1];
+        strcpy_s(path, strlen(location) + 1, location);
+    }
+
+    // Close and free libraries, leaving the disk to the game
+    prefetcher->Stop();
+    prefetcher->Dump(stderr);
+    delete prefetcher;
+    scheduler->Dump(stderr);
+    display->DumpLatency(stderr);
+    io->DumpLightStats(stderr);
+    io->DumpInputStats(stderr);
+    loop->Lights()->Dump(stderr);
+    menu->DumpValidation(stderr);
+    delete loop;
+    delete scheduler;
     delete display;
     delete menu;
+    delete timers;
+    /* Stop first so the lights going off are in the script's record */
+    io->Stop();
+    if (script != NULL)
+    {
+        script->DumpLights(stderr);
+    }
     delete io;
 
     if (path != NULL)
     {
-        /* Crate a batch file that launches the game after we exit */
-        char tempPath[1024];
-        GetTempPathA(1024, tempPath);
-        strncat_s(tempPath, 1024, "/launch.bat", 11);
-        HANDLE hBat = CreateFileA(tempPath, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
-
-        char command[MAX_GAME_LOCATION_LENGTH + 128];
-        sprintf_s(command, MAX_GAME_LOCATION_LENGTH + 128, "ping 127.0.0.1 -n 5 -w 1000 > nul\r\n%s\r\n", path);
-        DWORD bytesWritten;
-        WriteFile(hBat, command, strlen(command), &bytesWritten, NULL);
-        CloseHandle(hBat);
-
-        wchar_t* wCommand = new wchar_t[4096];
-        MultiByteToWideChar(CP_ACP, 0, tempPath, -1, wCommand, 4096);
-
-        STARTUPINFO info={sizeof(info)};
-        PROCESS_INFORMATION processInfo;
-        CreateProcess(NULL, wCommand, NULL, NULL, FALSE, 0, NULL, NULL, &info, &processInfo);
-
-        delete wCommand;
+        /* Start the game as soon as it can get at the IO itself */
+        Launcher *launcher = new Launcher(path);
+        launcher->WaitForRelease(scripted ? NULL : P3IOBackend::Released, LAUNCH_RELEASE_TIMEOUT_MS);
+        launcher->Launch();
+        launcher->Dump(stderr);
+
+        delete launcher;
+        delete[] path;
     }
 
     // All done
@@ -4,11 +4,166 @@
 #include "Display.h"
 #include "Menu.h"
 #include "IO.h"
+#include "Clock.h"
+#include "LatencyHistogram.h"
+#include "Viewport.h"
+#include "PrefixIndex.h"
 
 Menu *globalMenu;
 int globalResX, globalResY;
 bool globalQuit;
 unsigned int globalSelected;
+Viewport globalViewport;
+
+/* Drawing resources, created once and kept for the life of the window */
+HDC globalBackBuffer;
+HBITMAP globalBackBitmap;
+HGDIOBJ globalOldBitmap;
+HGDIOBJ globalOldFont;
+HFONT globalFont;
+HBRUSH globalBackground;
+wchar_t **globalNames;
+
+/* Launch check result each entry was last drawn with */
+unsigned char *globalDrawnStatus;
+
+/* Type-ahead search, narrowing the list down to a run of the prefix index */
+PrefixIndex *globalIndex;
+bool globalSearching;
+char globalSearch[SEARCH_MAX_LENGTH + 1];
+unsigned int globalSearchLength;
+char globalCandidate;
+unsigned int globalMatchFirst;
+unsigned int globalMatchLast;
+
+/* When the selection change waiting to be painted was pressed and handled */
+unsigned long long globalInputTime;
+unsigned long long globalSelectTime;
+
+LatencyHistogram globalInputToSelect("input to select");
+LatencyHistogram globalSelectToPaint("select to paint");
+LatencyHistogram globalInputToPaint("input to paint");
+
+unsigned int GetItemCount()
+{
+    return globalSearching ? globalMatchLast - globalMatchFirst : globalMenu->NumberOfEntries();
+}
+
+unsigned int GetItemEntry(unsigned int item)
+{
+    /* Rows are catalog entries, or matches in name order while searching */
+    return globalSearching ? globalIndex->Entry(globalMatchFirst + item) : item;
+}
+
+void GetItemRect(unsigned int item, RECT *rect)
+{
+    rect->top = globalViewport.RowTop(item);
+    rect->bottom = rect->top + ITEM_HEIGHT;
+    rect->left = ITEM_PADDING;
+    rect->right = globalResX - ITEM_PADDING;
+}
+
+wchar_t *GetItemName(unsigned int entry)
+{
+    /* Convert names as they first scroll into view, so huge catalogs don't
+       pay for entries nobody ever looks at */
+    if (globalNames[entry] == NULL)
+    {
+        int length = MultiByteToWideChar(CP_ACP, 0, globalMenu->GetEntryName(entry), -1, NULL, 0);
+        globalNames[entry] = new wchar_t[length > 0 ? length : 1];
+        globalNames[entry][0] = 0;
+        MultiByteToWideChar(CP_ACP, 0, globalMenu->GetEntryName(entry), -1, globalNames[entry], length);
+    }
+
+    return globalNames[entry];
+}
+
+unsigned int GetEntryStatus(unsigned int entry)
+{
+    /* Only broken entries look any different, unchecked and fine are drawn the same */
+    unsigned int status = globalMenu->EntryStatus(entry);
+    return status > VALIDATE_OK ? status : VALIDATE_UNKNOWN;
+}
+
+void GetSearchRect(RECT *rect)
+{
+    rect->top = globalResY - SEARCH_BAR_HEIGHT + ITEM_PADDING;
+    rect->bottom = rect->top + ITEM_HEIGHT;
+    rect->left = ITEM_PADDING;
+    rect->right = globalResX - ITEM_PADDING;
+}
+
+void DrawSearch(HDC hdc)
+{
+    RECT rect;
+    GetSearchRect(&rect);
+
+    char text[SEARCH_MAX_LENGTH + 128];
+    if (!globalSearching)
+    {
+        sprintf_s(text, sizeof(text), "Step on a pad arrow to search");
+    }
+    else
+    {
+        /* Show spaces so people can tell they're there */
+        char candidate = globalCandidate == ' ' ? '_' : globalCandidate;
+        sprintf_s(
+            text,
+            sizeof(text),
+            "Search: %s[%c]    %u found    Left/Right: letter, Down: add, Up: remove",
+            globalSearch,
+            candidate != 0 ? candidate : ' ',
+            GetItemCount()
+        );
+    }
+
+    wchar_t wideText[SEARCH_MAX_LENGTH + 128];
+    MultiByteToWideChar(CP_ACP, 0, text, -1, wideText, SEARCH_MAX_LENGTH + 128);
+
+    SetDCPenColor(hdc, RGB(128,128,128));
+    Rectangle(hdc, rect.left, rect.top, rect.right, rect.bottom);
+    DrawText(hdc, wideText, -1, &rect, DT_SINGLELINE | DT_NOCLIP | DT_CENTER | DT_VCENTER);
+}
+
+void DrawItem(HDC hdc, unsigned int item)
+{
+    RECT rect;
+    GetItemRect(item, &rect);
+
+    /* Draw bounding rectangle */
+    if (item == globalSelected)
+    {
+        SetDCPenColor(hdc, RGB(255,255,255));
+    }
+    else
+    {
+        SetDCPenColor(hdc, RGB(0,0,0));
+    }
+    Rectangle(hdc, rect.left, rect.top, rect.right, rect.bottom);
+
+    /* Draw text, greyed out with the reason when the game can't be launched */
+    unsigned int entry = GetItemEntry(item);
+    unsigned int status = GetEntryStatus(entry);
+    globalDrawnStatus[entry] = (unsigned char)status;
+    if (status > VALIDATE_OK)
+    {
+        SetTextColor(hdc, RGB(110, 110, 110));
+    }
+    DrawText(hdc, GetItemName(entry), -1, &rect, DT_SINGLELINE | DT_NOCLIP | DT_CENTER | DT_VCENTER);
+    if (status > VALIDATE_OK)
+    {
+        RECT reason = rect;
+        reason.right -= ITEM_PADDING;
+        DrawText(
+            hdc,
+            status == VALIDATE_MISSING ? L"missing" : (status == VALIDATE_UNREADABLE ? L"unreadable" : L"empty"),
+            -1,
+            &reason,
+            DT_SINGLELINE | DT_NOCLIP | DT_RIGHT | DT_VCENTER
+        );
+        SetTextColor(hdc, RGB(240, 240, 240));
+    }
+}
 
 LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 {
@@ -26,71 +181,58 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
             globalQuit = true;
             return 0;
         case WM_PAINT:
-            /* Set up double buffer */
             PAINTSTRUCT ps;
             HDC windowHdc = BeginPaint(hwnd, &ps);
-            HDC hdc = CreateCompatibleDC(windowHdc);
-            HBITMAP Membitmap = CreateCompatibleBitmap(windowHdc, globalResX, globalResY);
-            SelectObject(hdc, Membitmap);
-
-            /* Paint the window background */
-            HBRUSH background = CreateSolidBrush(RGB(0,0,0));
-            FillRect(hdc, &ps.rcPaint, background);
-            DeleteObject(background);
-
-            /* Set up text display */
-            SetTextColor(hdc, RGB(240, 240, 240));
-            SetBkMode(hdc, TRANSPARENT);
-            SetBkColor(hdc, RGB(24, 24, 24));
-            HFONT hFont = CreateFont(FONT_SIZE, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, L"Verdana");
-            SelectObject(hdc, hFont);
-
-            /* Set up brush colors */
-            SelectObject(hdc, GetStockObject(DC_PEN));
-            SelectObject(hdc, GetStockObject(DC_BRUSH));
-            SetDCBrushColor(hdc, RGB(0,0,0));
-            SetDCPenColor(hdc, RGB(255,255,255));
-
-            /* Draw each menu item */
-            for( unsigned int i = 0; i < globalMenu->NumberOfEntries(); i++ ) {
-                unsigned int top = ((ITEM_HEIGHT + ITEM_PADDING) * i) + ITEM_PADDING;
-                unsigned int bottom = top + ITEM_HEIGHT;
-                unsigned int left = ITEM_PADDING;
-                unsigned int right = globalResX - ITEM_PADDING;
-
-                /* Draw bounding rectangle */
-                if (i == globalSelected)
-                {
-                    SetDCPenColor(hdc, RGB(255,255,255));
-                }
-                else
-                {
-                    SetDCPenColor(hdc, RGB(0,0,0));
-                }
-                Rectangle(hdc, left, top, right, bottom);
 
-                /* Draw text */
-                RECT rect;
-                rect.top = top;
-                rect.bottom = bottom;
-                rect.left = left;
-                rect.right = right;
-
-                wchar_t* wString = new wchar_t[4096];
-                MultiByteToWideChar(CP_ACP, 0, globalMenu->GetEntryName(i), -1, wString, 4096);
-                DrawText(hdc, wString, -1, &rect, DT_SINGLELINE | DT_NOCLIP | DT_CENTER | DT_VCENTER);
-                delete wString;
+            /* Paint the invalidated part of the background */
+            FillRect(globalBackBuffer, &ps.rcPaint, globalBackground);
+
+            /* Only redraw the visible rows that overlap the invalidated area */
+            unsigned int first = globalViewport.RowAt(ps.rcPaint.top);
+            unsigned int last = globalViewport.RowAt(ps.rcPaint.bottom) + 1;
+            if (last > globalViewport.Last())
+            {
+                last = globalViewport.Last();
             }
 
-            DeleteObject(hFont);
+            for( unsigned int i = first; i < last; i++ ) {
+                DrawItem(globalBackBuffer, i);
+            }
+
+            /* The search bar sits below the rows */
+            if (ps.rcPaint.bottom > globalResY - SEARCH_BAR_HEIGHT)
+            {
+                DrawSearch(globalBackBuffer);
+            }
 
-            /* Copy double-buffer over */
-            BitBlt(windowHdc, 0, 0, globalResX, globalResY, hdc, 0, 0, SRCCOPY);
-            DeleteObject(Membitmap);
-            DeleteDC(hdc);
-            DeleteDC(windowHdc);
+            /* Copy the changed part of the double-buffer over */
+            BitBlt(
+                windowHdc,
+                ps.rcPaint.left,
+                ps.rcPaint.top,
+                ps.rcPaint.right - ps.rcPaint.left,
+                ps.rcPaint.bottom - ps.rcPaint.top,
+                globalBackBuffer,
+                ps.rcPaint.left,
+                ps.rcPaint.top,
+                SRCCOPY
+            );
 
             EndPaint(hwnd, &ps);
+
+            /* The new selection is on screen now */
+            if (globalSelectTime != 0)
+            {
+                unsigned long long painted = ClockMicroseconds();
+                globalSelectToPaint.Record(painted - globalSelectTime);
+                if (globalInputTime != 0)
+                {
+                    globalInputToPaint.Record(painted - globalInputTime);
+                }
+
+                globalSelectTime = 0;
+                globalInputTime = 0;
+            }
             return 0;
     }
 
@@ -106,7 +248,7 @@ void GetDesktopResolution(int& horizontal, int& vertical)
    vertical = desktop.bottom;
 }
 
-Display::Display(HINSTANCE hInstance, IO *ioInst, Menu *mInst)
+Display::Display(HINSTANCE hInstance, IO *ioInst, Menu *mInst, TimerWheel *wheel)
 {
     inst = hInstance;
     globalMenu = mInst;
@@ -122,12 +264,62 @@ Display::Display(HINSTANCE hInstance, IO *ioInst, Menu *mInst)
     GetDesktopResolution(globalResX, globalResY);
     globalQuit = false;
     globalSelected = 0;
+    globalSelectTime = 0;
+    globalInputTime = 0;
     selected = 0;
+    moved = false;
+    validated = 0;
     menu = mInst;
     io = ioInst;
+    timers = wheel;
+    repeatTimer = -1;
+    repeatButtons = 0;
+    repeatDelta = 0;
+    repeatAccelerate = false;
+    repeatStart = 0;
+
+    // Entry names are converted once, the first time they are drawn
+    globalNames = new wchar_t*[menu->NumberOfEntries()]();
+    globalDrawnStatus = new unsigned char[menu->NumberOfEntries()]();
+
+    // Start out showing everything
+    globalIndex = menu->GetIndex();
+    globalSearching = false;
+    globalSearch[0] = 0;
+    globalSearchLength = 0;
+    globalCandidate = 0;
+    globalMatchFirst = 0;
+    globalMatchLast = 0;
+
+    // Work out how many rows fit on screen above the search bar
+    globalViewport.SetLayout(ITEM_HEIGHT, ITEM_PADDING, globalResY - SEARCH_BAR_HEIGHT);
+    globalViewport.SetCount(menu->NumberOfEntries());
+    globalViewport.ScrollTo(0);
 
     // Create an empty window
     hwnd = CreateWindow(CLASS_NAME, 0, WS_BORDER, 0, 0, globalResX, globalResY, NULL, NULL, inst, NULL);
+
+    // Set up double buffer and everything we draw with
+    HDC windowHdc = GetDC(hwnd);
+    globalBackBuffer = CreateCompatibleDC(windowHdc);
+    globalBackBitmap = CreateCompatibleBitmap(windowHdc, globalResX, globalResY);
+    globalOldBitmap = SelectObject(globalBackBuffer, globalBackBitmap);
+    ReleaseDC(hwnd, windowHdc);
+
+    globalBackground = CreateSolidBrush(RGB(0,0,0));
+    globalFont = CreateFont(FONT_SIZE, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, L"Verdana");
+    globalOldFont = SelectObject(globalBackBuffer, globalFont);
+
+    /* Set up text display */
+    SetTextColor(globalBackBuffer, RGB(240, 240, 240));
+    SetBkMode(globalBackBuffer, TRANSPARENT);
+    SetBkColor(globalBackBuffer, RGB(24, 24, 24));
+
+    /* Set up brush colors */
+    SelectObject(globalBackBuffer, GetStockObject(DC_PEN));
+    SelectObject(globalBackBuffer, GetStockObject(DC_BRUSH));
+    SetDCBrushColor(globalBackBuffer, RGB(0,0,0));
+    SetDCPenColor(globalBackBuffer, RGB(255,255,255));
     LONG lStyle = GetWindowLong(hwnd, GWL_STYLE);
     lStyle &= ~(WS_CAPTION | WS_THICKFRAME | WS_MINIMIZE | WS_MAXIMIZE | WS_SYSMENU);
     SetWindowLong(hwnd, GWL_STYLE, lStyle);
@@ -144,34 +336,138 @@ Display::Display(HINSTANCE hInstance, IO *ioInst, Menu *mInst)
 
 Display::~Display(void)
 {
+    StopRepeat();
     ShowCursor(true);
     DestroyWindow(hwnd);
     UnregisterClass(CLASS_NAME, inst);
+
+    // Free drawing resources
+    SelectObject(globalBackBuffer, globalOldFont);
+    SelectObject(globalBackBuffer, globalOldBitmap);
+    DeleteObject(globalFont);
+    DeleteObject(globalBackground);
+    DeleteObject(globalBackBitmap);
+    DeleteDC(globalBackBuffer);
+
+    for (unsigned int i = 0; i < menu->NumberOfEntries(); i++)
+    {
+        if (globalNames[i] != NULL)
+        {
+            delete[] globalNames[i];
+        }
+    }
+    delete[] globalNames;
+    delete[] globalDrawnStatus;
 }
 
 void Display::Tick(void)
 {
-    /* Firat, handle inputs */
+    /* Firat, handle inputs. Left and right move one entry at a time, up and
+       down move a whole screen, and holding any of them repeats. */
+    unsigned long long inputTime = 0;
+    int page = globalViewport.Rows() > 0 ? (int)globalViewport.Rows() : 1;
     if (io->ButtonPressed(BUTTON_1P_MENULEFT) || io->ButtonPressed(BUTTON_2P_MENULEFT))
     {
-        if (selected > 0)
+        Move(-1);
+        StartRepeat(BUTTON_1P_MENULEFT | BUTTON_2P_MENULEFT, -1, true);
+        inputTime = io->ButtonPressedAt(BUTTON_1P_MENULEFT | BUTTON_2P_MENULEFT);
+    }
+    if (io->ButtonPressed(BUTTON_1P_MENURIGHT) || io->ButtonPressed(BUTTON_2P_MENURIGHT))
+    {
+        Move(1);
+        StartRepeat(BUTTON_1P_MENURIGHT | BUTTON_2P_MENURIGHT, 1, true);
+        inputTime = io->ButtonPressedAt(BUTTON_1P_MENURIGHT | BUTTON_2P_MENURIGHT);
+    }
+    if (io->ButtonPressed(BUTTON_1P_MENUUP) || io->ButtonPressed(BUTTON_2P_MENUUP))
+    {
+        Move(-page);
+        StartRepeat(BUTTON_1P_MENUUP | BUTTON_2P_MENUUP, -page, false);
+        inputTime = io->ButtonPressedAt(BUTTON_1P_MENUUP | BUTTON_2P_MENUUP);
+    }
+    if (io->ButtonPressed(BUTTON_1P_MENUDOWN) || io->ButtonPressed(BUTTON_2P_MENUDOWN))
+    {
+        Move(page);
+        StartRepeat(BUTTON_1P_MENUDOWN | BUTTON_2P_MENUDOWN, page, false);
+        inputTime = io->ButtonPressedAt(BUTTON_1P_MENUDOWN | BUTTON_2P_MENUDOWN);
+    }
+
+    /* Pad arrows drive the search */
+    unsigned int arrows = io->ButtonsPressed() & (
+        BUTTON_1P_UP | BUTTON_1P_DOWN | BUTTON_1P_LEFT | BUTTON_1P_RIGHT |
+        BUTTON_2P_UP | BUTTON_2P_DOWN | BUTTON_2P_LEFT | BUTTON_2P_RIGHT
+    );
+    if (arrows != 0)
+    {
+        Search(arrows);
+    }
+
+    /* Somebody is using the menu, so don't boot out from under them. This
+       waits until now because held buttons move from inside the timer wheel,
+       which can't have its other timers rescheduled while it runs. */
+    if (moved)
+    {
+        moved = false;
+        menu->ResetTimeout();
+    }
+
+    /* Pick up an edited INI, the watcher has already done the slow parts */
+    if (menu->ReloadPending())
+    {
+        unsigned int previous = GetItemCount() > 0 ? GetItemEntry(selected) : 0;
+        const unsigned int *remap;
+        unsigned int oldCount;
+        if (menu->Reload(&remap, &oldCount))
         {
-            selected --;
+            Reloaded(previous, remap, oldCount);
         }
     }
-    if (io->ButtonPressed(BUTTON_1P_MENURIGHT) || io->ButtonPressed(BUTTON_2P_MENURIGHT))
+
+    /* Launch checks came back, so flag any games on screen that turned out broken */
+    if (menu->ValidationProgress() != validated)
     {
-        if (selected < (menu->NumberOfEntries() - 1))
+        validated = menu->ValidationProgress();
+        for (unsigned int item = globalViewport.First(); item < globalViewport.Last(); item++)
         {
-            selected ++;
+            unsigned int entry = GetItemEntry(item);
+            if (GetEntryStatus(entry) != globalDrawnStatus[entry])
+            {
+                RECT rect;
+                GetItemRect(item, &rect);
+                InvalidateRect(hwnd, &rect, FALSE);
+            }
         }
     }
 
     /* Now, handle whether we should repaint */
     if (globalSelected != selected)
     {
+        /* Time from the earliest input that hasn't made it to the screen yet */
+        if (globalSelectTime == 0)
+        {
+            globalSelectTime = ClockMicroseconds();
+            globalInputTime = inputTime;
+            if (inputTime != 0)
+            {
+                globalInputToSelect.Record(globalSelectTime - inputTime);
+            }
+        }
+
+        if (globalViewport.ScrollTo(selected))
+        {
+            /* Everything on screen moved */
+            InvalidateRect(hwnd, NULL, FALSE);
+        }
+        else
+        {
+            /* Only the old and new selection need repainting */
+            RECT rect;
+            GetItemRect(globalSelected, &rect);
+            InvalidateRect(hwnd, &rect, FALSE);
+            GetItemRect(selected, &rect);
+            InvalidateRect(hwnd, &rect, FALSE);
+        }
+
         globalSelected = selected;
-        InvalidateRect(hwnd, NULL, FALSE);
         UpdateWindow(hwnd);
     }
 
@@ -184,12 +480,276 @@ void Display::Tick(void)
     }
 }
 
+void Display::Move(int delta)
+{
+    int last = (int)GetItemCount() - 1;
+    int target = (int)selected + delta;
+    if (target < 0)
+    {
+        target = 0;
+    }
+    if (target > last)
+    {
+        target = last;
+    }
+
+    if ((unsigned int)target != selected)
+    {
+        selected = target;
+        moved = true;
+    }
+}
+
+void Display::StartRepeat(unsigned int buttons, int delta, bool accelerate)
+{
+    /* The most recently pressed button is the one that repeats */
+    repeatButtons = buttons;
+    repeatDelta = delta;
+    repeatAccelerate = accelerate;
+    repeatStart = ClockNow();
+
+    unsigned long long deadline = repeatStart + REPEAT_DELAY_MS * 1000ULL;
+    if (repeatTimer < 0)
+    {
+        repeatTimer = timers->Add(deadline, RepeatTimer, this);
+    }
+    else
+    {
+        timers->Reschedule(repeatTimer, deadline);
+    }
+}
+
+void Display::StopRepeat()
+{
+    if (repeatTimer >= 0)
+    {
+        timers->Cancel(repeatTimer);
+        repeatTimer = -1;
+    }
+    repeatButtons = 0;
+}
+
+unsigned long long Display::RepeatTimer(void *context, unsigned long long now)
+{
+    Display *display = (Display *)context;
+    if (!display->io->ButtonHeld(display->repeatButtons))
+    {
+        display->repeatTimer = -1;
+        display->repeatButtons = 0;
+        return 0;
+    }
+
+    /* Step size doubles every so often once the button has been held a while */
+    int step = 1;
+    unsigned long long held = (now - display->repeatStart) / 1000;
+    if (display->repeatAccelerate && held > REPEAT_DELAY_MS + REPEAT_ACCELERATE_MS)
+    {
+        unsigned long long doublings = (held - REPEAT_DELAY_MS - REPEAT_ACCELERATE_MS) / REPEAT_DOUBLE_MS + 1;
+        step = 1;
+        while (doublings > 0 && step < REPEAT_MAX_STEP)
+        {
+            step *= 2;
+            doublings--;
+        }
+    }
+
+    display->Move(display->repeatDelta * step);
+    return now + REPEAT_INTERVAL_MS * 1000ULL;
+}
+
+/**
+ * Left and right pick the next letter, down adds it to the search and up
+ * takes the last one back off. Only letters that some game continues with
+ * are offered, so the list can never filter down to nothing.
+ */
+void Display::Search(unsigned int buttons)
+{
+    bool left = (buttons & (BUTTON_1P_LEFT | BUTTON_2P_LEFT)) != 0;
+    bool right = (buttons & (BUTTON_1P_RIGHT | BUTTON_2P_RIGHT)) != 0;
+    bool down = (buttons & (BUTTON_1P_DOWN | BUTTON_2P_DOWN)) != 0;
+    bool up = (buttons & (BUTTON_1P_UP | BUTTON_2P_UP)) != 0;
+
+    /* The first step just brings the search up */
+    if (!globalSearching)
+    {
+        globalSearching = true;
+        globalSearchLength = 0;
+        globalSearch[0] = 0;
+        globalMatchFirst = 0;
+        globalMatchLast = globalIndex->Count();
+        globalCandidate = globalIndex->NextLetter(0, globalMatchFirst, globalMatchLast, 0);
+        Refilter();
+        return;
+    }
+
+    unsigned int depth = globalSearchLength;
+    if (right)
+    {
+        char letter = globalIndex->NextLetter(depth, globalMatchFirst, globalMatchLast, globalCandidate);
+        globalCandidate = letter != 0 ? letter : globalIndex->NextLetter(depth, globalMatchFirst, globalMatchLast, 0);
+    }
+    if (left)
+    {
+        char letter = globalIndex->PrevLetter(depth, globalMatchFirst, globalMatchLast, globalCandidate);
+        globalCandidate = letter != 0 ? letter : globalIndex->PrevLetter(depth, globalMatchFirst, globalMatchLast, 0);
+    }
+    if (down && globalCandidate != 0 && globalSearchLength < SEARCH_MAX_LENGTH)
+    {
+        globalIndex->Narrow(depth, globalCandidate, &globalMatchFirst, &globalMatchLast);
+        globalSearch[globalSearchLength++] = globalCandidate;
+        globalSearch[globalSearchLength] = 0;
+        globalCandidate = globalIndex->NextLetter(globalSearchLength, globalMatchFirst, globalMatchLast, 0);
+        Refilter();
+        return;
+    }
+    if (up)
+    {
+        if (globalSearchLength == 0)
+        {
+            globalSearching = false;
+        }
+        else
+        {
+            /* Widen back out by redoing the shorter search from the top */
+            globalCandidate = globalSearch[--globalSearchLength];
+            globalSearch[globalSearchLength] = 0;
+            globalMatchFirst = 0;
+            globalMatchLast = globalIndex->Count();
+            for (unsigned int i = 0; i < globalSearchLength; i++)
+            {
+                globalIndex->Narrow(i, globalSearch[i], &globalMatchFirst, &globalMatchLast);
+            }
+        }
+        Refilter();
+        return;
+    }
+
+    /* Only the picked letter changed */
+    RECT rect;
+    GetSearchRect(&rect);
+    InvalidateRect(hwnd, &rect, FALSE);
+    menu->ResetTimeout();
+}
+
+void Display::Refilter()
+{
+    /* The rows mean something different now, start from the top */
+    StopRepeat();
+    selected = 0;
+    globalSelected = 0;
+    globalViewport.SetCount(GetItemCount());
+    globalViewport.ScrollTo(0);
+
+    InvalidateRect(hwnd, NULL, FALSE);
+    menu->ResetTimeout();
+}
+
+/**
+ * Carries everything over to a freshly reloaded catalog. Games that are
+ * still there keep their converted names, the selection stays on the same
+ * game, or the closest one that survived, and the search is redone against
+ * the new index.
+ */
+void Display::Reloaded(unsigned int previous, const unsigned int *remap, unsigned int oldCount)
+{
+    unsigned int count = menu->NumberOfEntries();
+    wchar_t **names = new wchar_t*[count]();
+    for (unsigned int i = 0; i < oldCount; i++)
+    {
+        if (remap[i] != INDEX_NO_ENTRY)
+        {
+            names[remap[i]] = globalNames[i];
+        }
+        else if (globalNames[i] != NULL)
+        {
+            delete[] globalNames[i];
+        }
+    }
+    delete[] globalNames;
+    globalNames = names;
+
+    /* Everything is checked again, and the whole screen repainted below */
+    delete[] globalDrawnStatus;
+    globalDrawnStatus = new unsigned char[count]();
+
+    /* Look outwards from the old selection for something still there */
+    unsigned int entry = 0;
+    for (unsigned int distance = 0; distance < oldCount; distance++)
+    {
+        if (previous + distance < oldCount && remap[previous + distance] != INDEX_NO_ENTRY)
+        {
+            entry = remap[previous + distance];
+            break;
+        }
+        if (previous >= distance && remap[previous - distance] != INDEX_NO_ENTRY)
+        {
+            entry = remap[previous - distance];
+            break;
+        }
+    }
+
+    /* Redo the search, keeping as much of it as still matches something */
+    globalIndex = menu->GetIndex();
+    if (globalSearching)
+    {
+        globalMatchFirst = 0;
+        globalMatchLast = globalIndex->Count();
+        for (unsigned int i = 0; i < globalSearchLength; i++)
+        {
+            unsigned int first = globalMatchFirst;
+            unsigned int last = globalMatchLast;
+            globalIndex->Narrow(i, globalSearch[i], &first, &last);
+            if (first == last)
+            {
+                globalSearchLength = i;
+                globalSearch[i] = 0;
+                break;
+            }
+            globalMatchFirst = first;
+            globalMatchLast = last;
+        }
+        globalCandidate = globalIndex->NextLetter(globalSearchLength, globalMatchFirst, globalMatchLast, 0);
+    }
+
+    /* Find the row the selected game ended up on */
+    unsigned int row = 0;
+    if (!globalSearching)
+    {
+        row = entry;
+    }
+    else
+    {
+        for (unsigned int i = 0; i < GetItemCount(); i++)
+        {
+            if (GetItemEntry(i) == entry)
+            {
+                row = i;
+                break;
+            }
+        }
+    }
+
+    /* Rows may have moved anywhere, so repaint the lot */
+    selected = row;
+    globalSelected = row;
+    globalViewport.SetCount(GetItemCount());
+    globalViewport.ScrollTo(row);
+    InvalidateRect(hwnd, NULL, FALSE);
+}
+
 bool Display::WasClosed()
 {
     return globalQuit;
 }
 
+void Display::DumpLatency(FILE *fp)
+{
+    globalInputToSelect.Dump(fp);
+    globalSelectToPaint.Dump(fp);
+    globalInputToPaint.Dump(fp);
+}
+
 unsigned int Display::GetSelectedItem()
 {
-    return selected;
+    return GetItemEntry(selected);
 }
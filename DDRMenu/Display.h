@@ -5,6 +5,7 @@
 
 #include "Menu.h"
 #include "IO.h"
+#include "TimerWheel.h"
 
 #define CLASS_NAME L"DDR Cabinet Button Launcher"
 
@@ -12,14 +13,26 @@
 #define ITEM_PADDING 10
 #define FONT_SIZE 18
 
+/* Holding a menu button repeats after a pause, then speeds up the longer it's held */
+#define REPEAT_DELAY_MS 300
+#define REPEAT_INTERVAL_MS 33
+#define REPEAT_ACCELERATE_MS 500
+#define REPEAT_DOUBLE_MS 250
+#define REPEAT_MAX_STEP 64
+
+/* Pad arrows spell out a search in a bar along the bottom of the screen */
+#define SEARCH_BAR_HEIGHT (ITEM_HEIGHT + (ITEM_PADDING * 2))
+#define SEARCH_MAX_LENGTH 32
+
 class Display
 {
 public:
-    Display(HINSTANCE hInstance, IO *io, Menu *mInst);
+    Display(HINSTANCE hInstance, IO *io, Menu *mInst, TimerWheel *wheel);
     ~Display();
 
     void Tick();
     bool WasClosed();
+    void DumpLatency(FILE *fp);
 
     unsigned int GetSelectedItem();
 
@@ -29,6 +42,28 @@ private:
 
     Menu *menu;
     IO *io;
+    TimerWheel *timers;
 
     unsigned int selected;
+
+    /* Set when the selection moves, the countdown is restarted from Tick() */
+    bool moved;
+
+    /* How many launch checks had come back when we last repainted for them */
+    unsigned int validated;
+
+    /* Which buttons are being held for auto-repeat, and how far each repeat moves */
+    int repeatTimer;
+    unsigned int repeatButtons;
+    int repeatDelta;
+    bool repeatAccelerate;
+    unsigned long long repeatStart;
+
+    void Move(int delta);
+    void Search(unsigned int buttons);
+    void Refilter();
+    void Reloaded(unsigned int previous, const unsigned int *remap, unsigned int oldCount);
+    void StartRepeat(unsigned int buttons, int delta, bool accelerate);
+    void StopRepeat();
+    static unsigned long long RepeatTimer(void *context, unsigned long long now);
 };
@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "EXTIOLink.h"
+
+void EXTIOEncodeFrame(unsigned int message, unsigned char *frame)
+{
+    /* Construct packet, sign with CRC */
+    frame[0] = (message & 0xFF) | 0x80;
+    frame[1] = (message >> 8) & 0xFF;
+    frame[2] = (message >> 16) & 0xFF;
+    frame[3] = (frame[0] + frame[1] + frame[2]) & 0x7F;
+}
+
+EXTIOLink::EXTIOLink() : ackLatency("extio ack")
+{
+    waiting = false;
+    message = 0;
+    memset(sentAt, 0, sizeof(sentAt));
+    outstanding = 0;
+    sent = 0;
+    acked = 0;
+    dropped = 0;
+    timeouts = 0;
+    malformed = 0;
+    firstSent = 0;
+    lastAcked = 0;
+}
+
+void EXTIOLink::Submit(unsigned int newmessage)
+{
+    /* Anything still waiting to go out is stale now */
+    if (waiting)
+    {
+        dropped++;
+    }
+
+    waiting = true;
+    message = newmessage;
+}
+
+/**
+ * Frames the waiting light frame if the EXTIO has room for it. Returns the
+ * number of bytes to write to the serial port.
+ */
+unsigned int EXTIOLink::Encode(unsigned char *buffer, unsigned int buflen, unsigned long long now)
+{
+    if (!waiting || outstanding >= EXTIO_MAX_IN_FLIGHT || buflen < EXTIO_FRAME_LENGTH)
+    {
+        return 0;
+    }
+
+    EXTIOEncodeFrame(message, buffer);
+    waiting = false;
+
+    sentAt[outstanding++] = now;
+    if (sent == 0)
+    {
+        firstSent = now;
+    }
+    sent++;
+
+    return EXTIO_FRAME_LENGTH;
+}
+
+/**
+ * Matches acks from the EXTIO up with frames we sent, oldest first. Returns
+ * how many frames were acknowledged.
+ */
+unsigned int EXTIOLink::Receive(const unsigned char *data, unsigned int length, unsigned long long now)
+{
+    unsigned int completed = 0;
+
+    for (unsigned int i = 0; i < length; i++)
+    {
+        if (data[i] != EXTIO_ACK)
+        {
+            malformed++;
+            continue;
+        }
+
+        if (outstanding == 0)
+        {
+            /* Late ack for a frame we already gave up on */
+            continue;
+        }
+
+        ackLatency.Record(now - sentAt[0]);
+        lastAcked = now;
+        acked++;
+        completed++;
+        Retire();
+    }
+
+    return completed;
+}
+
+/**
+ * Gives up on frames the EXTIO never acknowledged, so a wedged or missing
+ * EXTIO can't stop newer frames from going out.
+ */
+void EXTIOLink::Timeout(unsigned long long now)
+{
+    while (outstanding > 0 && now - sentAt[0] >= EXTIO_ACK_TIMEOUT_US)
+    {
+        timeouts++;
+        Retire();
+    }
+}
+
+/**
+ * Forgets everything in flight, for when the serial port itself failed.
+ */
+void EXTIOLink::Fail()
+{
+    timeouts += outstanding;
+    outstanding = 0;
+}
+
+void EXTIOLink::Retire()
+{
+    outstanding--;
+    memmove(sentAt, sentAt + 1, outstanding * sizeof(sentAt[0]));
+}
+
+void EXTIOLink::Dump(FILE *fp)
+{
+    /* Frame rate the EXTIO actually kept up with, over the time it was busy */
+    double fps = 0.0;
+    if (acked > 1 && lastAcked > firstSent)
+    {
+        fps = (double)acked * 1000000.0 / (double)(lastAcked - firstSent);
+    }
+
+    fprintf(
+        fp,
+        "extio: %u frames sent, %u acked, %u dropped, %u timed out, %u bad acks, %.1f fps\n",
+        sent,
+        acked,
+        dropped,
+        timeouts,
+        malformed,
+        fps
+    );
+    ackLatency.Dump(fp);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdio.h>
+
+#include "LatencyHistogram.h"
+
+/* Every light frame is three bytes of lights and a checksum, acked with one byte */
+#define EXTIO_FRAME_LENGTH 4
+#define EXTIO_ACK 0x11
+
+/* How many frames we let the EXTIO buffer before waiting on acks */
+#define EXTIO_MAX_IN_FLIGHT 2
+
+/* How long we wait on an ack before deciding it is never coming */
+#define EXTIO_ACK_TIMEOUT_US 100000
+
+void EXTIOEncodeFrame(unsigned int message, unsigned char *frame);
+
+/**
+ * Keeps the EXTIO fed with light frames without ever waiting on it. This does
+ * no I/O of its own, callers move the bytes produced by Encode() to the serial
+ * port and hand whatever comes back to Receive(). Only the newest frame is
+ * worth sending, so when the link can't keep up older frames are dropped.
+ */
+class EXTIOLink
+{
+public:
+    EXTIOLink();
+
+    void Submit(unsigned int message);
+    unsigned int Encode(unsigned char *buffer, unsigned int buflen, unsigned long long now);
+    unsigned int Receive(const unsigned char *data, unsigned int length, unsigned long long now);
+    void Timeout(unsigned long long now);
+    void Fail();
+
+    bool Idle() { return !waiting && outstanding == 0; }
+    unsigned int Outstanding() { return outstanding; }
+    unsigned int Sent() { return sent; }
+    unsigned int Acked() { return acked; }
+    unsigned int Dropped() { return dropped; }
+    unsigned int Timeouts() { return timeouts; }
+    unsigned int Malformed() { return malformed; }
+    LatencyHistogram *AckLatency() { return &ackLatency; }
+
+    void Dump(FILE *fp);
+private:
+    /* The next frame to go out, if any */
+    bool waiting;
+    unsigned int message;
+
+    /* When each unacknowledged frame went out, oldest first */
+    unsigned long long sentAt[EXTIO_MAX_IN_FLIGHT];
+    unsigned int outstanding;
+
+    unsigned int sent;
+    unsigned int acked;
+    unsigned int dropped;
+    unsigned int timeouts;
+    unsigned int malformed;
+    unsigned long long firstSent;
+    unsigned long long lastAcked;
+    LatencyHistogram ackLatency;
+
+    void Retire();
+};
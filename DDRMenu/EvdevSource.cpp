@@ -0,0 +1,259 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/input.h>
+
+#include "EvdevSource.h"
+#include "IO.h"
+#include "Clock.h"
+
+#define EVDEV_DIRECTORY "/dev/input"
+
+/* How many events we pull out of the kernel per read() */
+#define EVDEV_READ_EVENTS 64
+
+/* Large enough for every KEY_ and BTN_ code */
+#define EVDEV_KEY_BYTES ((KEY_MAX / 8) + 1)
+
+typedef struct
+{
+    unsigned short code;
+    unsigned int button;
+} evdev_key_t;
+
+static const evdev_key_t evdevKeys[] = {
+    /* Keyboards */
+    { KEY_LEFT, BUTTON_1P_MENULEFT },
+    { KEY_RIGHT, BUTTON_1P_MENURIGHT },
+    { KEY_UP, BUTTON_1P_MENUUP },
+    { KEY_DOWN, BUTTON_1P_MENUDOWN },
+    { KEY_ENTER, BUTTON_1P_START },
+    { KEY_KPENTER, BUTTON_1P_START },
+    { KEY_W, BUTTON_1P_UP },
+    { KEY_S, BUTTON_1P_DOWN },
+    { KEY_A, BUTTON_1P_LEFT },
+    { KEY_D, BUTTON_1P_RIGHT },
+    { KEY_F1, BUTTON_TEST },
+    { KEY_F2, BUTTON_SERVICE },
+    { KEY_F3, BUTTON_COIN },
+
+    /* Gamepads that report their d-pad as buttons */
+    { BTN_DPAD_LEFT, BUTTON_1P_MENULEFT },
+    { BTN_DPAD_RIGHT, BUTTON_1P_MENURIGHT },
+    { BTN_DPAD_UP, BUTTON_1P_MENUUP },
+    { BTN_DPAD_DOWN, BUTTON_1P_MENUDOWN },
+    { BTN_START, BUTTON_1P_START },
+    { BTN_SOUTH, BUTTON_1P_START },
+};
+
+#define EVDEV_KEY_COUNT (sizeof(evdevKeys) / sizeof(evdevKeys[0]))
+
+/* Gamepads that report their d-pad as a hat instead */
+#define EVDEV_HAT_X_MASK (BUTTON_1P_MENULEFT | BUTTON_1P_MENURIGHT)
+#define EVDEV_HAT_Y_MASK (BUTTON_1P_MENUUP | BUTTON_1P_MENUDOWN)
+
+static bool TestBit(const unsigned char *bits, unsigned int bit)
+{
+    return (bits[bit / 8] & (1 << (bit % 8))) != 0;
+}
+
+static unsigned int HatButtons(int value, unsigned int negative, unsigned int positive)
+{
+    return value < 0 ? negative : (value > 0 ? positive : 0);
+}
+
+/**
+ * Opens a device, keeping it only if it has at least one input we map.
+ * Mice, power buttons and the like are closed again straight away.
+ */
+EvdevSource::EvdevSource(const char *path)
+{
+    held = 0;
+    reported = 0;
+    dropped = false;
+    kernelTime = false;
+    snprintf(name, sizeof(name), "evdev %s", path);
+
+    device = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (device < 0)
+    {
+        return;
+    }
+
+    unsigned char keys[EVDEV_KEY_BYTES];
+    unsigned char abs[(ABS_MAX / 8) + 1];
+    memset(keys, 0, sizeof(keys));
+    memset(abs, 0, sizeof(abs));
+    ioctl(device, EVIOCGBIT(EV_KEY, sizeof(keys)), keys);
+    ioctl(device, EVIOCGBIT(EV_ABS, sizeof(abs)), abs);
+
+    bool useful = TestBit(abs, ABS_HAT0X) && TestBit(abs, ABS_HAT0Y);
+    for (unsigned int i = 0; i < EVDEV_KEY_COUNT && !useful; i++)
+    {
+        useful = TestBit(keys, evdevKeys[i].code);
+    }
+
+    if (!useful)
+    {
+        close(device);
+        device = -1;
+        return;
+    }
+
+    char devname[EVDEV_NAME_LENGTH];
+    if (ioctl(device, EVIOCGNAME(sizeof(devname)), devname) > 0)
+    {
+        devname[sizeof(devname) - 1] = 0;
+        snprintf(name, sizeof(name), "evdev %s", devname);
+    }
+
+    /* Have the kernel stamp events on the same clock we use */
+    int clock = CLOCK_MONOTONIC;
+    kernelTime = ioctl(device, EVIOCSCLOCKID, &clock) == 0;
+
+    /* Whatever is already held counts as held from the start */
+    Resync();
+    reported = held;
+}
+
+EvdevSource::~EvdevSource()
+{
+    if (device >= 0)
+    {
+        close(device);
+    }
+}
+
+void EvdevSource::Read(source_change_t change, void *context)
+{
+    struct input_event events[EVDEV_READ_EVENTS];
+
+    while (true)
+    {
+        ssize_t length = read(device, events, sizeof(events));
+        if (length < (ssize_t)sizeof(events[0]))
+        {
+            /* Drained, or gone, which the mux finds out about separately */
+            return;
+        }
+
+        unsigned int count = (unsigned int)(length / sizeof(events[0]));
+        for (unsigned int i = 0; i < count; i++)
+        {
+            const struct input_event *event = &events[i];
+
+            if (event->type == EV_SYN && event->code == SYN_DROPPED)
+            {
+                dropped = true;
+            }
+            else if (event->type == EV_SYN && event->code == SYN_REPORT)
+            {
+                /* Everything up to here happened at once */
+                if (dropped)
+                {
+                    Resync();
+                    dropped = false;
+                }
+
+                if (held != reported)
+                {
+                    unsigned long long when = ClockMicroseconds();
+                    if (kernelTime)
+                    {
+                        when = ((unsigned long long)event->input_event_sec * 1000000) + event->input_event_usec;
+                    }
+
+                    reported = held;
+                    change(context, held, when);
+                }
+            }
+            else if (dropped)
+            {
+                /* Don't trust anything in a frame that lost events */
+            }
+            else if (event->type == EV_KEY && event->value != 2)
+            {
+                for (unsigned int key = 0; key < EVDEV_KEY_COUNT; key++)
+                {
+                    if (evdevKeys[key].code == event->code)
+                    {
+                        held = event->value ? (held | evdevKeys[key].button) : (held & ~evdevKeys[key].button);
+                    }
+                }
+            }
+            else if (event->type == EV_ABS && event->code == ABS_HAT0X)
+            {
+                held = (held & ~EVDEV_HAT_X_MASK) | HatButtons(event->value, BUTTON_1P_MENULEFT, BUTTON_1P_MENURIGHT);
+            }
+            else if (event->type == EV_ABS && event->code == ABS_HAT0Y)
+            {
+                held = (held & ~EVDEV_HAT_Y_MASK) | HatButtons(event->value, BUTTON_1P_MENUUP, BUTTON_1P_MENUDOWN);
+            }
+        }
+    }
+}
+
+/**
+ * Reads back the whole device state, for when we can't trust our own idea of it.
+ */
+void EvdevSource::Resync()
+{
+    unsigned char keys[EVDEV_KEY_BYTES];
+    memset(keys, 0, sizeof(keys));
+    ioctl(device, EVIOCGKEY(sizeof(keys)), keys);
+
+    held = 0;
+    for (unsigned int key = 0; key < EVDEV_KEY_COUNT; key++)
+    {
+        if (TestBit(keys, evdevKeys[key].code))
+        {
+            held |= evdevKeys[key].button;
+        }
+    }
+
+    struct input_absinfo info;
+    if (ioctl(device, EVIOCGABS(ABS_HAT0X), &info) == 0)
+    {
+        held |= HatButtons(info.value, BUTTON_1P_MENULEFT, BUTTON_1P_MENURIGHT);
+    }
+    if (ioctl(device, EVIOCGABS(ABS_HAT0Y), &info) == 0)
+    {
+        held |= HatButtons(info.value, BUTTON_1P_MENUUP, BUTTON_1P_MENUDOWN);
+    }
+}
+
+/**
+ * Adds every keyboard and gamepad we're allowed to open. Returns how many.
+ */
+unsigned int EvdevSource::Discover(InputMux *mux)
+{
+    DIR *directory = opendir(EVDEV_DIRECTORY);
+    if (directory == NULL)
+    {
+        return 0;
+    }
+
+    unsigned int added = 0;
+    struct dirent *entry;
+    while ((entry = readdir(directory)) != NULL)
+    {
+        if (strncmp(entry->d_name, "event", 5) != 0)
+        {
+            continue;
+        }
+
+        char path[sizeof(EVDEV_DIRECTORY) + 256];
+        snprintf(path, sizeof(path), "%s/%s", EVDEV_DIRECTORY, entry->d_name);
+        if (mux->Add(new EvdevSource(path)))
+        {
+            added++;
+        }
+    }
+
+    closedir(directory);
+    return added;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "InputSource.h"
+#include "InputMux.h"
+
+/* Longest device name we keep around for stats, not counting the "evdev "
+   it gets prefixed with */
+#define EVDEV_NAME_LENGTH 64
+
+/**
+ * A Linux keyboard or gamepad read straight from /dev/input. The arrow keys
+ * or d-pad drive the menu buttons, enter or the gamepad start button starts,
+ * WASD stand in for the 1P pad arrows, and F1 to F3 are test, service and
+ * coin. Times come from the kernel's own event stamps, so latency covers
+ * everything after the device was read.
+ */
+class EvdevSource : public InputSource
+{
+public:
+    EvdevSource(const char *path);
+    ~EvdevSource();
+
+    const char *Name() { return name; }
+    bool Ready() { return device >= 0; }
+    int Descriptor() { return device; }
+    void Read(source_change_t change, void *context);
+
+    static unsigned int Discover(InputMux *mux);
+private:
+    int device;
+    char name[EVDEV_NAME_LENGTH + 6];
+    bool kernelTime;
+
+    /* Buttons held as of the events read so far, vs as of the last report */
+    unsigned int held;
+    unsigned int reported;
+
+    /* The kernel dropped events, ignore the rest of the frame and re-read state */
+    bool dropped;
+
+    void Resync();
+};
@@ -0,0 +1,337 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include "FileWatcher.h"
+
+/* Enough for a good burst of change notifications in one go */
+#define WATCH_BUFFER_BYTES 4096
+
+FileWatcher::FileWatcher()
+{
+    running = 0;
+    callback = NULL;
+    context = NULL;
+    directory[0] = 0;
+    file[0] = 0;
+    fileLength = 0;
+
+#ifdef _WIN32
+    handle = INVALID_HANDLE_VALUE;
+#else
+    inotify = -1;
+    wake[0] = -1;
+    wake[1] = -1;
+#endif
+}
+
+FileWatcher::~FileWatcher()
+{
+    Stop();
+}
+
+/**
+ * Starts watching a file, calling back on the watcher's thread every time it
+ * changes. The file name can also be a star followed by an ending, such as
+ * *.ini, to watch every matching file in the directory. Returns false if the
+ * directory can't be watched.
+ */
+bool FileWatcher::Watch(const _TCHAR *path, watch_callback_t newCallback, void *newContext)
+{
+    if (thread.Started())
+    {
+        return false;
+    }
+
+    /* Split the path into the directory to watch and the name to look for */
+    unsigned int length = 0;
+    unsigned int split = 0;
+    bool hasDirectory = false;
+    while (path[length] != 0 && length < WATCH_MAX_PATH - 1)
+    {
+        if (path[length] == '\\' || path[length] == '/')
+        {
+            split = length;
+            hasDirectory = true;
+        }
+        length++;
+    }
+
+    if (hasDirectory)
+    {
+        memcpy(directory, path, split * sizeof(_TCHAR));
+        directory[split > 0 ? split : 1] = 0;
+        if (split == 0)
+        {
+            /* The root directory */
+            directory[0] = path[0];
+        }
+        memcpy(file, path + split + 1, (length - split - 1) * sizeof(_TCHAR));
+        fileLength = length - split - 1;
+    }
+    else
+    {
+        directory[0] = '.';
+        directory[1] = 0;
+        memcpy(file, path, length * sizeof(_TCHAR));
+        fileLength = length;
+    }
+    file[fileLength] = 0;
+
+    callback = newCallback;
+    context = newContext;
+
+#ifdef _WIN32
+    handle = CreateFile(
+        directory,
+        FILE_LIST_DIRECTORY,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL,
+        OPEN_EXISTING,
+        FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+        NULL
+    );
+    if (handle == INVALID_HANDLE_VALUE)
+    {
+        fprintf(stderr, "Failed to watch %ls for changes!\n", directory);
+        return false;
+    }
+#else
+    inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify < 0 || inotify_add_watch(inotify, directory, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_MODIFY) < 0)
+    {
+        fprintf(stderr, "Failed to watch %s for changes!\n", directory);
+        if (inotify >= 0)
+        {
+            close(inotify);
+            inotify = -1;
+        }
+        return false;
+    }
+
+    if (pipe(wake) < 0)
+    {
+        close(inotify);
+        inotify = -1;
+        return false;
+    }
+#endif
+
+    AtomicStore(&running, 1);
+    if (!thread.Start(WatchThread, this))
+    {
+        fprintf(stderr, "Failed to start file watcher thread!\n");
+        AtomicStore(&running, 0);
+        Stop();
+        return false;
+    }
+
+    return true;
+}
+
+void FileWatcher::Stop()
+{
+    AtomicStore(&running, 0);
+
+#ifdef _WIN32
+    stop.Set();
+    thread.Join();
+
+    if (handle != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(handle);
+        handle = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (wake[1] >= 0)
+    {
+        char byte = 0;
+        if (write(wake[1], &byte, 1) < 0)
+        {
+            fprintf(stderr, "Failed to wake file watcher!\n");
+        }
+    }
+    thread.Join();
+
+    if (inotify >= 0)
+    {
+        close(inotify);
+        inotify = -1;
+    }
+    for (unsigned int i = 0; i < 2; i++)
+    {
+        if (wake[i] >= 0)
+        {
+            close(wake[i]);
+            wake[i] = -1;
+        }
+    }
+#endif
+}
+
+bool FileWatcher::Matches(const _TCHAR *name, unsigned int length)
+{
+    /* A leading star matches any name with the rest as its ending */
+    const _TCHAR *wanted = file;
+    unsigned int wantedLength = fileLength;
+    if (fileLength > 0 && file[0] == '*')
+    {
+        wanted++;
+        wantedLength--;
+        if (length < wantedLength)
+        {
+            return false;
+        }
+        name += length - wantedLength;
+        length = wantedLength;
+    }
+
+#ifdef _WIN32
+    /* Windows file names don't care about case */
+    return length == wantedLength && _wcsnicmp(name, wanted, length) == 0;
+#else
+    return length == wantedLength && memcmp(name, wanted, length) == 0;
+#endif
+}
+
+void FileWatcher::WatchThread(void *param)
+{
+    FileWatcher *watcher = (FileWatcher *)param;
+
+    /* Set once our file has changed, cleared once it's been quiet long enough */
+    bool pending = false;
+
+#ifdef _WIN32
+    DWORD buffer[WATCH_BUFFER_BYTES / sizeof(DWORD)];
+    OVERLAPPED overlapped;
+    memset(&overlapped, 0, sizeof(overlapped));
+    overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    bool reading = false;
+
+    while (AtomicLoad(&watcher->running))
+    {
+        if (!reading)
+        {
+            ResetEvent(overlapped.hEvent);
+            reading = ReadDirectoryChangesW(
+                watcher->handle,
+                buffer,
+                sizeof(buffer),
+                FALSE,
+                FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE,
+                NULL,
+                &overlapped,
+                NULL
+            ) != FALSE;
+            if (!reading)
+            {
+                fprintf(stderr, "Failed to read directory changes!\n");
+                break;
+            }
+        }
+
+        HANDLE handles[2] = { overlapped.hEvent, watcher->stop.Handle() };
+        DWORD result = WaitForMultipleObjects(2, handles, FALSE, pending ? WATCH_SETTLE_MS : INFINITE);
+        if (result == WAIT_OBJECT_0)
+        {
+            reading = false;
+            DWORD bytes = 0;
+            if (!GetOverlappedResult(watcher->handle, &overlapped, &bytes, FALSE))
+            {
+                continue;
+            }
+
+            /* No bytes means too much happened to report, so assume the worst */
+            if (bytes == 0)
+            {
+                pending = true;
+                continue;
+            }
+
+            const unsigned char *record = (const unsigned char *)buffer;
+            while (true)
+            {
+                const FILE_NOTIFY_INFORMATION *info = (const FILE_NOTIFY_INFORMATION *)record;
+                if (watcher->Matches(info->FileName, info->FileNameLength / sizeof(WCHAR)))
+                {
+                    pending = true;
+                }
+
+                if (info->NextEntryOffset == 0)
+                {
+                    break;
+                }
+                record += info->NextEntryOffset;
+            }
+        }
+        else if (result == WAIT_TIMEOUT)
+        {
+            pending = false;
+            watcher->callback(watcher->context);
+        }
+        else
+        {
+            /* Asked to stop */
+            break;
+        }
+    }
+
+    if (reading)
+    {
+        DWORD bytes = 0;
+        CancelIo(watcher->handle);
+        GetOverlappedResult(watcher->handle, &overlapped, &bytes, TRUE);
+    }
+    CloseHandle(overlapped.hEvent);
+#else
+    /* inotify records carry their names, so they must stay aligned */
+    struct inotify_event buffer[WATCH_BUFFER_BYTES / sizeof(struct inotify_event)];
+
+    while (AtomicLoad(&watcher->running))
+    {
+        struct pollfd fds[2];
+        fds[0].fd = watcher->inotify;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        fds[1].fd = watcher->wake[0];
+        fds[1].events = POLLIN;
+        fds[1].revents = 0;
+
+        int ready = poll(fds, 2, pending ? WATCH_SETTLE_MS : -1);
+        if (ready == 0)
+        {
+            pending = false;
+            watcher->callback(watcher->context);
+            continue;
+        }
+        if (ready < 0 || fds[1].revents != 0)
+        {
+            /* Asked to stop */
+            break;
+        }
+
+        ssize_t length;
+        while ((length = read(watcher->inotify, buffer, sizeof(buffer))) > 0)
+        {
+            const char *record = (const char *)buffer;
+            while (record < (const char *)buffer + length)
+            {
+                const struct inotify_event *event = (const struct inotify_event *)record;
+                if ((event->mask & IN_Q_OVERFLOW) || (event->len > 0 && watcher->Matches(event->name, strlen(event->name))))
+                {
+                    pending = true;
+                }
+                record += sizeof(struct inotify_event) + event->len;
+            }
+        }
+    }
+#endif
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "MappedFile.h"
+#include "Thread.h"
+
+/* Editors tend to write a file in several goes, so wait for it to go quiet */
+#define WATCH_SETTLE_MS 200
+
+#define WATCH_MAX_PATH 1024
+
+/* Called on the watcher's own thread once the file has changed and settled */
+typedef void (*watch_callback_t)(void *context);
+
+/**
+ * Watches one file, or every file with a given ending, for changes without
+ * polling. The directory is watched rather than the file, so editors that
+ * save by writing a new file and renaming it over the old one are still
+ * noticed.
+ */
+class FileWatcher
+{
+public:
+    FileWatcher();
+    ~FileWatcher();
+
+    bool Watch(const _TCHAR *path, watch_callback_t callback, void *context);
+    void Stop();
+private:
+    static void WatchThread(void *param);
+    bool Matches(const _TCHAR *name, unsigned int length);
+
+    Thread thread;
+    volatile long running;
+
+    watch_callback_t callback;
+    void *context;
+
+    _TCHAR directory[WATCH_MAX_PATH];
+    _TCHAR file[WATCH_MAX_PATH];
+    unsigned int fileLength;
+
+#ifdef _WIN32
+    HANDLE handle;
+    Event stop;
+#else
+    int inotify;
+    int wake[2];
+#endif
+};
@@ -0,0 +1,628 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "GameScanner.h"
+#include "CatalogCache.h"
+#include "Clock.h"
+#include "Thread.h"
+
+#ifdef _WIN32
+#define SCAN_SEPARATOR '\\'
+#else
+#define SCAN_SEPARATOR '/'
+#endif
+
+typedef struct
+{
+    const char *directory;
+    const char *file;
+} scan_script_t;
+
+/* Launch scripts we know, relative to a game's directory, best first */
+static const scan_script_t scanScripts[SCAN_SCRIPTS] = {
+    { "contents", "gamestart.bat" },
+    { "", "gamestart.bat" },
+};
+
+static char Fold(char letter)
+{
+    return (letter >= 'a' && letter <= 'z') ? letter - 'a' + 'A' : letter;
+}
+
+/* Name order ignoring case, so games come out the same way the menu sorts */
+static int CompareNames(const char *left, const char *right)
+{
+    const char *first = left;
+    const char *second = right;
+    while (*first != 0 && Fold(*first) == Fold(*second))
+    {
+        first++;
+        second++;
+    }
+
+    int difference = (unsigned char)Fold(*first) - (unsigned char)Fold(*second);
+    return difference != 0 ? difference : strcmp(left, right);
+}
+
+static int CompareNamePointers(const void *a, const void *b)
+{
+    return CompareNames(*(const char *const *)a, *(const char *const *)b);
+}
+
+/* Ignores case entirely, for telling whether two entries are the same game */
+static int CompareFolded(const void *a, const void *b)
+{
+    const char *left = *(const char *const *)a;
+    const char *right = *(const char *const *)b;
+    while (*left != 0 && Fold(*left) == Fold(*right))
+    {
+        left++;
+        right++;
+    }
+    return (unsigned char)Fold(*left) - (unsigned char)Fold(*right);
+}
+
+/**
+ * Looks a path up, returning when it last changed, or zero if it doesn't
+ * exist or isn't the kind of thing we wanted.
+ */
+static unsigned long long ScanModified(const char *path, bool directory)
+{
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &info) ||
+        ((info.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0) != directory)
+    {
+        return 0;
+    }
+
+    unsigned long long modified = ((unsigned long long)info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime;
+#else
+    struct stat info;
+    if (stat(path, &info) != 0 || (S_ISDIR(info.st_mode) ? !directory : (directory || !S_ISREG(info.st_mode))))
+    {
+        return 0;
+    }
+
+    unsigned long long modified = ((unsigned long long)info.st_mtim.tv_sec * 1000000000) + info.st_mtim.tv_nsec;
+#endif
+
+    /* Zero means missing, so nudge anything that really has that time */
+    return modified != 0 ? modified : 1;
+}
+
+/* Adds a separator and another piece to a path, returning its new length */
+static unsigned int AppendPath(char *path, unsigned int length, const char *piece)
+{
+    unsigned int piecelen = strlen(piece);
+    if (piecelen == 0 || length + 1 + piecelen + 1 > SCAN_MAX_PATH)
+    {
+        return length;
+    }
+
+    /* Roots of drives already end in one */
+    if (length == 0 || (path[length - 1] != '\\' && path[length - 1] != '/'))
+    {
+        path[length++] = SCAN_SEPARATOR;
+    }
+    memcpy(path + length, piece, piecelen + 1);
+    return length + piecelen;
+}
+
+GameScanner::GameScanner()
+{
+    rootCount = 0;
+    games = NULL;
+    gameCount = 0;
+    cache = NULL;
+    rescannedRoots = 0;
+    rescannedGames = 0;
+}
+
+GameScanner::~GameScanner()
+{
+    Reset();
+    for (unsigned int i = 0; i < rootCount; i++)
+    {
+        free(roots[i]);
+    }
+}
+
+/**
+ * Throws away the results of the last scan, keeping the roots.
+ */
+void GameScanner::Reset()
+{
+    for (unsigned int i = 0; i < rootCount; i++)
+    {
+        for (unsigned int j = 0; j < nameCount[i]; j++)
+        {
+            free(names[i][j]);
+        }
+        free(names[i]);
+        names[i] = NULL;
+        nameCount[i] = 0;
+    }
+
+    free(games);
+    games = NULL;
+    gameCount = 0;
+}
+
+bool GameScanner::AddRoot(const char *path, unsigned int length)
+{
+    /* Trailing separators would only end up doubled in every path, though
+       a drive's root needs its one */
+    while (length > 1 && (path[length - 1] == '\\' || path[length - 1] == '/') && path[length - 2] != ':')
+    {
+        length--;
+    }
+
+    if (rootCount == SCAN_MAX_ROOTS || length == 0 || length >= SCAN_MAX_PATH)
+    {
+        fprintf(stderr, "Too many roots to look for games in!\n");
+        return false;
+    }
+
+    roots[rootCount] = (char *)malloc(length + 1);
+    memcpy(roots[rootCount], path, length);
+    roots[rootCount][length] = 0;
+    names[rootCount] = NULL;
+    nameCount[rootCount] = 0;
+    rootCount++;
+    return true;
+}
+
+/**
+ * Finds every game under the configured roots, reusing the previous scan
+ * from the cache file for anything that hasn't changed since.
+ */
+void GameScanner::Scan(const _TCHAR *cachePath)
+{
+    unsigned long long start = ClockMicroseconds();
+    Reset();
+    rescannedRoots = 0;
+    rescannedGames = 0;
+
+    OpenCache(cachePath);
+    ParallelFor(rootCount, SCAN_THREADS, ScanRoot, this);
+
+    /* Every directory under every root is a possible game */
+    for (unsigned int i = 0; i < rootCount; i++)
+    {
+        gameCount += nameCount[i];
+    }
+    games = (scan_game_t *)malloc(sizeof(scan_game_t) * (gameCount > 0 ? gameCount : 1));
+
+    unsigned int game = 0;
+    for (unsigned int i = 0; i < rootCount; i++)
+    {
+        for (unsigned int j = 0; j < nameCount[i]; j++)
+        {
+            memset(&games[game], 0, sizeof(scan_game_t));
+            games[game].root = i;
+            games[game].name = j;
+            games[game].script = -1;
+            game++;
+        }
+    }
+
+    ParallelFor(gameCount, SCAN_THREADS, ScanGame, this);
+
+    delete cache;
+    cache = NULL;
+
+    if (AtomicLoad(&rescannedRoots) > 0 || AtomicLoad(&rescannedGames) > 0)
+    {
+        SaveCache(cachePath);
+    }
+
+    fprintf(
+        stderr,
+        "Found %u games under %u roots in %llu us, looking again in %ld of %u directories\n",
+        Found(),
+        rootCount,
+        ClockMicroseconds() - start,
+        AtomicLoad(&rescannedRoots) + AtomicLoad(&rescannedGames),
+        rootCount + gameCount
+    );
+}
+
+unsigned int GameScanner::Found()
+{
+    unsigned int found = 0;
+    for (unsigned int i = 0; i < gameCount; i++)
+    {
+        if (games[i].script >= 0)
+        {
+            found++;
+        }
+    }
+    return found;
+}
+
+/**
+ * Lists the directories under one root, straight from the cache if the
+ * root itself hasn't changed, since that's the only way to add or remove one.
+ */
+void GameScanner::ScanRoot(void *context, unsigned int item)
+{
+    GameScanner *scanner = (GameScanner *)context;
+    const char *root = scanner->roots[item];
+    unsigned long long modified = ScanModified(root, true);
+    scanner->rootModified[item] = modified;
+
+    const scan_root_t *cached = scanner->cachedRoots[item];
+    if (cached != NULL && cached->modified == modified)
+    {
+        const scan_game_t *cachedGames = scanner->CachedGames();
+        const char *text = scanner->CachedText();
+
+        scanner->names[item] = (char **)malloc(sizeof(char *) * (cached->count > 0 ? cached->count : 1));
+        for (unsigned int i = 0; i < cached->count; i++)
+        {
+            const char *name = text + cachedGames[cached->first + i].name;
+            scanner->names[item][i] = (char *)malloc(strlen(name) + 1);
+            strcpy(scanner->names[item][i], name);
+        }
+        scanner->nameCount[item] = cached->count;
+        return;
+    }
+
+    AtomicIncrement(&scanner->rescannedRoots);
+    if (modified == 0)
+    {
+        fprintf(stderr, "Can't look for games in %s!\n", root);
+        return;
+    }
+
+    unsigned int capacity = 0;
+    char path[SCAN_MAX_PATH];
+    unsigned int length = strlen(root);
+    memcpy(path, root, length + 1);
+
+#ifdef _WIN32
+    if (length + 3 > SCAN_MAX_PATH)
+    {
+        return;
+    }
+    strcpy(path + length, path[length - 1] == '\\' ? "*" : "\\*");
+
+    WIN32_FIND_DATAA found;
+    HANDLE search = FindFirstFileA(path, &found);
+    path[length] = 0;
+    if (search == INVALID_HANDLE_VALUE)
+    {
+        return;
+    }
+
+    do
+    {
+        const char *name = found.cFileName;
+        if ((found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0)
+        {
+            continue;
+        }
+#else
+    DIR *search = opendir(path);
+    if (search == NULL)
+    {
+        return;
+    }
+
+    struct dirent *found;
+    while ((found = readdir(search)) != NULL)
+    {
+        const char *name = found->d_name;
+#endif
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+        {
+            continue;
+        }
+
+#ifndef _WIN32
+        AppendPath(path, length, name);
+        bool isDirectory = ScanModified(path, true) != 0;
+        path[length] = 0;
+        if (!isDirectory)
+        {
+            continue;
+        }
+#endif
+
+        if (scanner->nameCount[item] == capacity)
+        {
+            capacity = capacity > 0 ? capacity * 2 : 16;
+            scanner->names[item] = (char **)realloc(scanner->names[item], sizeof(char *) * capacity);
+        }
+        char *copy = (char *)malloc(strlen(name) + 1);
+        strcpy(copy, name);
+        scanner->names[item][scanner->nameCount[item]++] = copy;
+#ifdef _WIN32
+    } while (FindNextFileA(search, &found));
+    FindClose(search);
+#else
+    }
+    closedir(search);
+#endif
+
+    /* Directory listings come back in whatever order the file system likes */
+    qsort(scanner->names[item], scanner->nameCount[item], sizeof(char *), CompareNamePointers);
+}
+
+/**
+ * Checks one directory for a launch script, unless neither it nor any
+ * directory a script would be in has changed since the last scan.
+ */
+void GameScanner::ScanGame(void *context, unsigned int item)
+{
+    GameScanner *scanner = (GameScanner *)context;
+    scan_game_t *game = &scanner->games[item];
+
+    char path[SCAN_MAX_PATH];
+    unsigned int length = scanner->GamePath(game, path);
+    game->modified[0] = ScanModified(path, true);
+    for (unsigned int i = 0; i < SCAN_SCRIPTS; i++)
+    {
+        unsigned int scriptLength = AppendPath(path, length, scanScripts[i].directory);
+        game->modified[i + 1] = scriptLength == length ? game->modified[0] : ScanModified(path, true);
+        path[length] = 0;
+    }
+
+    const scan_game_t *cached = scanner->CachedGame(game->root, scanner->Name(game));
+    if (cached != NULL && memcmp(cached->modified, game->modified, sizeof(game->modified)) == 0)
+    {
+        game->script = cached->script;
+        return;
+    }
+
+    AtomicIncrement(&scanner->rescannedGames);
+    for (unsigned int i = 0; i < SCAN_SCRIPTS && game->script < 0; i++)
+    {
+        if (game->modified[i + 1] == 0)
+        {
+            continue;
+        }
+
+        unsigned int scriptLength = AppendPath(path, length, scanScripts[i].directory);
+        AppendPath(path, scriptLength, scanScripts[i].file);
+        if (ScanModified(path, false) != 0)
+        {
+            game->script = i;
+        }
+        path[length] = 0;
+    }
+}
+
+unsigned int GameScanner::GamePath(const scan_game_t *game, char *path)
+{
+    unsigned int length = strlen(roots[game->root]);
+    memcpy(path, roots[game->root], length + 1);
+    return AppendPath(path, length, Name(game));
+}
+
+/**
+ * Maps the last scan's results in, and matches its roots up with ours. Any
+ * problem with it just means scanning everything again.
+ */
+bool GameScanner::OpenCache(const _TCHAR *cachePath)
+{
+    for (unsigned int i = 0; i < rootCount; i++)
+    {
+        cachedRoots[i] = NULL;
+    }
+
+    cache = new MappedFile();
+    if (!cache->Open(cachePath) || cache->Length() < sizeof(scan_cache_header_t))
+    {
+        delete cache;
+        cache = NULL;
+        return false;
+    }
+
+    const scan_cache_header_t *header = (const scan_cache_header_t *)cache->Data();
+    unsigned long long expected = sizeof(scan_cache_header_t) +
+                                  ((unsigned long long)header->rootCount * sizeof(scan_root_t)) +
+                                  ((unsigned long long)header->gameCount * sizeof(scan_game_t)) +
+                                  header->textlen;
+
+    if (
+        header->magic != SCAN_CACHE_MAGIC ||
+        header->version != SCAN_CACHE_VERSION ||
+        expected != cache->Length() ||
+        header->textlen == 0 ||
+        cache->Data()[cache->Length() - 1] != 0
+    ) {
+        fprintf(stderr, "Ignoring malformed scan cache!\n");
+        delete cache;
+        cache = NULL;
+        return false;
+    }
+
+    const scan_root_t *cachedRootTable = (const scan_root_t *)(header + 1);
+    const scan_game_t *cachedGames = (const scan_game_t *)(cachedRootTable + header->rootCount);
+    const char *text = (const char *)(cachedGames + header->gameCount);
+
+    for (unsigned int i = 0; i < header->rootCount; i++)
+    {
+        const scan_root_t *cached = &cachedRootTable[i];
+        if (cached->path >= header->textlen || (unsigned long long)cached->first + cached->count > header->gameCount)
+        {
+            continue;
+        }
+
+        for (unsigned int j = 0; j < rootCount; j++)
+        {
+            if (cachedRoots[j] == NULL && strcmp(text + cached->path, roots[j]) == 0)
+            {
+                cachedRoots[j] = cached;
+            }
+        }
+    }
+
+    /* Strings must all be inside the image before anybody reads them */
+    for (unsigned int i = 0; i < header->gameCount; i++)
+    {
+        if (cachedGames[i].name >= header->textlen)
+        {
+            fprintf(stderr, "Ignoring malformed scan cache!\n");
+            delete cache;
+            cache = NULL;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+const scan_game_t *GameScanner::CachedGame(unsigned int root, const char *name)
+{
+    const scan_root_t *cached = cachedRoots[root];
+    if (cached == NULL)
+    {
+        return NULL;
+    }
+
+    const scan_game_t *cachedGames = CachedGames();
+    const char *text = CachedText();
+
+    /* Games were saved in name order */
+    unsigned int first = cached->first;
+    unsigned int last = cached->first + cached->count;
+    while (first < last)
+    {
+        unsigned int middle = first + ((last - first) / 2);
+        int difference = CompareNames(text + cachedGames[middle].name, name);
+        if (difference == 0)
+        {
+            return &cachedGames[middle];
+        }
+        if (difference < 0)
+        {
+            first = middle + 1;
+        }
+        else
+        {
+            last = middle;
+        }
+    }
+
+    return NULL;
+}
+
+const scan_game_t *GameScanner::CachedGames()
+{
+    const scan_cache_header_t *header = (const scan_cache_header_t *)cache->Data();
+    return (const scan_game_t *)((const scan_root_t *)(header + 1) + header->rootCount);
+}
+
+const char *GameScanner::CachedText()
+{
+    const scan_cache_header_t *header = (const scan_cache_header_t *)cache->Data();
+    return (const char *)(CachedGames() + header->gameCount);
+}
+
+bool GameScanner::SaveCache(const _TCHAR *cachePath)
+{
+    Arena text;
+    scan_root_t *savedRoots = (scan_root_t *)malloc(sizeof(scan_root_t) * (rootCount > 0 ? rootCount : 1));
+    scan_game_t *savedGames = (scan_game_t *)malloc(sizeof(scan_game_t) * (gameCount > 0 ? gameCount : 1));
+
+    /* Games are already grouped by root and in name order */
+    unsigned int game = 0;
+    for (unsigned int i = 0; i < rootCount; i++)
+    {
+        memset(&savedRoots[i], 0, sizeof(scan_root_t));
+        savedRoots[i].path = text.AddString(roots[i], strlen(roots[i]));
+        savedRoots[i].first = game;
+        savedRoots[i].count = nameCount[i];
+        savedRoots[i].modified = rootModified[i];
+
+        for (unsigned int j = 0; j < nameCount[i]; j++, game++)
+        {
+            savedGames[game] = games[game];
+            savedGames[game].name = text.AddString(names[i][j], strlen(names[i][j]));
+        }
+    }
+
+    scan_cache_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.magic = SCAN_CACHE_MAGIC;
+    header.version = SCAN_CACHE_VERSION;
+    header.rootCount = rootCount;
+    header.gameCount = gameCount;
+    header.textlen = text.Size() > 0 ? text.Size() : 1;
+
+    const void *pieces[4] = { &header, savedRoots, savedGames, text.Size() > 0 ? text.Base() : "" };
+    unsigned int lengths[4] = {
+        sizeof(header),
+        (unsigned int)(rootCount * sizeof(scan_root_t)),
+        (unsigned int)(gameCount * sizeof(scan_game_t)),
+        header.textlen
+    };
+
+    bool ok = CacheWrite(cachePath, pieces, lengths, 4);
+    free(savedRoots);
+    free(savedGames);
+    return ok;
+}
+
+/**
+ * Adds every game found to a catalog, after whatever is already there. A
+ * game the catalog already has, by name or by what it launches, is left out,
+ * so entries written by hand always win.
+ */
+void GameScanner::AddTo(Catalog *catalog)
+{
+    /* Catalog strings move around as it grows, so compare against a copy */
+    unsigned int count = catalog->Count();
+    unsigned int textlen = catalog->TextLength();
+    char *existing = (char *)malloc(textlen > 0 ? textlen : 1);
+    memcpy(existing, catalog->Text(), textlen);
+
+    const char **existingNames = (const char **)malloc(sizeof(char *) * (count > 0 ? count : 1));
+    const char **existingLocations = (const char **)malloc(sizeof(char *) * (count > 0 ? count : 1));
+    for (unsigned int i = 0; i < count; i++)
+    {
+        existingNames[i] = existing + (catalog->GetName(i) - catalog->Text());
+        existingLocations[i] = existing + (catalog->GetLocation(i) - catalog->Text());
+    }
+    qsort(existingNames, count, sizeof(char *), CompareFolded);
+    qsort(existingLocations, count, sizeof(char *), CompareFolded);
+
+    for (unsigned int i = 0; i < gameCount; i++)
+    {
+        scan_game_t *game = &games[i];
+        if (game->script < 0)
+        {
+            continue;
+        }
+
+        char location[SCAN_MAX_PATH];
+        unsigned int length = GamePath(game, location);
+        length = AppendPath(location, length, scanScripts[game->script].directory);
+        length = AppendPath(location, length, scanScripts[game->script].file);
+
+        const char *name = Name(game);
+        const char *locationKey = location;
+        if (bsearch(&name, existingNames, count, sizeof(char *), CompareFolded) != NULL ||
+            bsearch(&locationKey, existingLocations, count, sizeof(char *), CompareFolded) != NULL)
+        {
+            continue;
+        }
+
+        catalog->Add(name, strlen(name), location, length);
+    }
+
+    free(existingLocations);
+    free(existingNames);
+    free(existing);
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "Arena.h"
+#include "Catalog.h"
+#include "MappedFile.h"
+
+/* Bump this whenever the layout below changes */
+#define SCAN_CACHE_MAGIC 0x4E435344
+#define SCAN_CACHE_VERSION 1
+
+#define SCAN_MAX_ROOTS 16
+#define SCAN_MAX_PATH 1024
+
+/* Scanning mostly waits on the disk, so more threads than cores is fine */
+#define SCAN_THREADS 8
+
+/* How many launch scripts we know to look for, see GameScanner.cpp */
+#define SCAN_SCRIPTS 2
+
+/* One directory under a root that might hold a game. In the cache the name
+   is where its string is, while scanning it's which of the root's names. */
+typedef struct
+{
+    unsigned int root;
+    unsigned int name;
+    int script;
+    unsigned int reserved;
+
+    /* Times the game directory and each script's directory last changed,
+       zero for ones that don't exist */
+    unsigned long long modified[SCAN_SCRIPTS + 1];
+} scan_game_t;
+
+/* Followed in the cache by its games, which are in name order */
+typedef struct
+{
+    unsigned int path;
+    unsigned int first;
+    unsigned int count;
+    unsigned int reserved;
+    unsigned long long modified;
+} scan_root_t;
+
+/* Followed by rootCount roots, gameCount games, then textlen bytes of strings */
+typedef struct
+{
+    unsigned int magic;
+    unsigned int version;
+    unsigned int rootCount;
+    unsigned int gameCount;
+    unsigned int textlen;
+    unsigned int reserved;
+} scan_cache_header_t;
+
+/**
+ * Finds installed games by looking for known launch scripts, such as
+ * contents\gamestart.bat, in every directory directly under each root. Roots
+ * and games are checked side by side. What was found is cached along with
+ * when each directory last changed, so later scans only look inside the
+ * directories that changed since.
+ */
+class GameScanner
+{
+public:
+    GameScanner();
+    ~GameScanner();
+
+    bool AddRoot(const char *path, unsigned int length);
+    unsigned int Roots() { return rootCount; }
+
+    void Scan(const _TCHAR *cachePath);
+    void AddTo(Catalog *catalog);
+
+    unsigned int Found();
+private:
+    static void ScanRoot(void *context, unsigned int item);
+    static void ScanGame(void *context, unsigned int item);
+
+    void Reset();
+    bool OpenCache(const _TCHAR *cachePath);
+    const scan_game_t *CachedGame(unsigned int root, const char *name);
+    const scan_game_t *CachedGames();
+    const char *CachedText();
+    bool SaveCache(const _TCHAR *cachePath);
+    unsigned int GamePath(const scan_game_t *game, char *path);
+    const char *Name(const scan_game_t *game) { return names[game->root][game->name]; }
+
+    /* Roots as configured, with what's directly under each, in name order */
+    char *roots[SCAN_MAX_ROOTS];
+    unsigned long long rootModified[SCAN_MAX_ROOTS];
+    char **names[SCAN_MAX_ROOTS];
+    unsigned int nameCount[SCAN_MAX_ROOTS];
+    unsigned int rootCount;
+
+    scan_game_t *games;
+    unsigned int gameCount;
+
+    /* The last scan's results, and which of our roots each of its roots is */
+    MappedFile *cache;
+    const scan_root_t *cachedRoots[SCAN_MAX_ROOTS];
+
+    /* How much had to be looked at again, for stats */
+    volatile long rescannedRoots;
+    volatile long rescannedGames;
+};
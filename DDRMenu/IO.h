@@ -1,7 +1,23 @@
 #pragma once
 
-#include <tchar.h>
-#include <windows.h>
+#include <stdio.h>
+
+#include "IOBackend.h"
+#include "InputMux.h"
+#include "InputRing.h"
+#include "LatencyHistogram.h"
+#include "Thread.h"
+
+/* How often the background thread samples the JAMMA edge */
+#define INPUT_POLL_RATE_HZ 1000
+
+/* How long the input thread waits on other sources at a time with no cabinet
+   to poll, so it notices being stopped */
+#define INPUT_IDLE_WAIT_US 50000
+
+/* Events from the cabinet are source 0, the mux's sources follow on from it */
+#define INPUT_SOURCE_CABINET 0
+#define INPUT_SOURCE_COUNT (INPUT_MAX_SOURCES + 1)
 
 // Button definitions
 #define BUTTON_1P_UP 0x0001
@@ -57,43 +73,64 @@
 
 #define LIGHT_BASS_NEONS 0x00400000
 
-typedef struct {
-    unsigned int slot1;
-    unsigned int slot2;
-} coincount;
+/* Which lights are driven over the P3IO and which over the EXTIO */
+#define LIGHT_CAB_MASK (LIGHT_1P_MENU | LIGHT_2P_MENU | LIGHT_MARQUEE_LOWER_RIGHT | LIGHT_MARQUEE_UPPER_RIGHT | LIGHT_MARQUEE_LOWER_LEFT | LIGHT_MARQUEE_UPPER_LEFT)
+#define LIGHT_PAD_MASK (LIGHT_1P_RIGHT | LIGHT_1P_LEFT | LIGHT_1P_DOWN | LIGHT_1P_UP | LIGHT_2P_RIGHT | LIGHT_2P_LEFT | LIGHT_2P_DOWN | LIGHT_2P_UP | LIGHT_BASS_NEONS)
 
 class IO
 {
 public:
-    IO();
+    IO(IOBackend *ioBackend, InputMux *inputMux = NULL, unsigned int pollRate = INPUT_POLL_RATE_HZ);
     ~IO();
 
+    void Stop();
     bool Ready();
     void Tick();
+    Event *InputEvent();
     unsigned int ButtonsPressed();
     bool ButtonPressed(unsigned int button);
+    unsigned long long ButtonPressedAt(unsigned int button);
     unsigned int ButtonsHeld();
     bool ButtonHeld(unsigned int button);
     void SetLights(unsigned int lights);
     void LightOn(unsigned int light);
     void LightOff(unsigned int light);
+    void CommitLights();
+    void DumpLightStats(FILE *fp);
+    void DumpInputStats(FILE *fp);
 private:
-    HANDLE p3io;
-    HANDLE extio;
+    IOBackend *backend;
+    InputMux *inputs;
 
-    unsigned int ExchangeP3IO(unsigned char *outbuf, unsigned int outlen, unsigned char *inbuf, unsigned int inlen);
-    bool ExchangeEXTIO(unsigned int message);
+    static void PollThread(void *param);
+    static void SourceChanged(void *param, unsigned int source, unsigned int held, unsigned long long when);
+    void Publish(unsigned int source, unsigned long long when);
 
-    void GetVersion();
-    void SetMode();
-    unsigned int GetCabType(unsigned int request);
-    coincount GetCoinstock();
-    unsigned int GetButtonsHeld();
+    /* Only touched by the input thread, what each side holds and what we last sent */
+    unsigned int cabinetHeld;
+    unsigned int sourcesHeld;
+    unsigned int lastHeld;
+
+    /* How long each source's edges took to reach Tick() */
+    LatencyHistogram *latency[INPUT_SOURCE_COUNT];
+    unsigned int sourceCount;
 
-    bool is_ready;
-    unsigned int sequence;
     unsigned int buttons;
-    unsigned int lastButtons;
+    unsigned int pressed;
+    unsigned long long pressedAt[32];
+
+    Thread poller;
+    InputRing events;
+    Event eventsReady;
+    volatile long polling;
+    unsigned int pollInterval;
+
+    /* Light frame being built up this tick, and what the hardware has */
+    unsigned int lights;
     unsigned int lastcablights;
     unsigned int lastpadlights;
+
+    /* How many packets the light changes would have cost one by one, vs sent */
+    unsigned int lightRequests;
+    unsigned int lightPackets;
 };
@@ -0,0 +1,24 @@
+#pragma once
+
+/**
+ * Whatever actually sits on the other end of the buttons and lights. IO
+ * handles edge detection and light bookkeeping on top of this, so a backend
+ * only needs to report raw state and push out raw light values.
+ */
+class IOBackend
+{
+public:
+    virtual ~IOBackend() {}
+
+    virtual bool Ready() = 0;
+
+    /* Called from the input polling thread, returns every button held right now */
+    virtual unsigned int PollButtons() = 0;
+
+    /* Called from the main thread, only when the respective bits change */
+    virtual void SetCabLights(unsigned int cablights) = 0;
+    virtual void SetPadLights(unsigned int padlights) = 0;
+
+    /* Called from the main thread once a tick, to move along any I/O still in progress */
+    virtual void Service() {}
+};
@@ -0,0 +1,242 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <sys/epoll.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include "InputMux.h"
+#include "Clock.h"
+
+#ifdef _WIN32
+/* Needed for timeBeginPeriod() so short waits are actually short */
+#pragma comment(lib, "winmm.lib")
+
+#define INPUT_WINDOW_CLASS L"DDRMenuInput"
+#endif
+
+InputMux::InputMux()
+{
+    memset(slots, 0, sizeof(slots));
+    count = 0;
+    change = NULL;
+    context = NULL;
+
+#ifdef _WIN32
+    window = NULL;
+#else
+    epoll = -1;
+#endif
+}
+
+InputMux::~InputMux()
+{
+    Close();
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        delete slots[i].source;
+    }
+}
+
+/**
+ * Takes ownership of a source. Sources that didn't open, or that there's no
+ * room for, are thrown away straight away.
+ */
+bool InputMux::Add(InputSource *source)
+{
+    if (!source->Ready())
+    {
+        delete source;
+        return false;
+    }
+
+    if (count >= INPUT_MAX_SOURCES)
+    {
+        fprintf(stderr, "Too many input sources, ignoring %s!\n", source->Name());
+        delete source;
+        return false;
+    }
+
+    input_slot_t *slot = &slots[count];
+    slot->source = source;
+    slot->mux = this;
+    slot->index = count;
+    slot->held = 0;
+    count++;
+    return true;
+}
+
+bool InputMux::Open()
+{
+#ifdef _WIN32
+    /* Raw input goes to a window, so the input thread gets one nobody sees */
+    WNDCLASSW wc = { };
+    wc.lpfnWndProc = WindowProc;
+    wc.hInstance = GetModuleHandle(NULL);
+    wc.lpszClassName = INPUT_WINDOW_CLASS;
+    RegisterClassW(&wc);
+
+    window = CreateWindowExW(0, INPUT_WINDOW_CLASS, L"", 0, 0, 0, 0, 0, HWND_MESSAGE, NULL, wc.hInstance, NULL);
+    if (window == NULL)
+    {
+        fprintf(stderr, "Failed to create input window!\n");
+        return false;
+    }
+    SetWindowLongPtr(window, GWLP_USERDATA, (LONG_PTR)this);
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        if (!slots[i].source->Register(window))
+        {
+            fprintf(stderr, "Failed to register %s for raw input!\n", slots[i].source->Name());
+        }
+    }
+
+    /* Default scheduler granularity is ~15ms, which is useless for polling */
+    timeBeginPeriod(1);
+#else
+    epoll = epoll_create(INPUT_MAX_SOURCES);
+    if (epoll < 0)
+    {
+        fprintf(stderr, "Failed to create input epoll!\n");
+        return false;
+    }
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.u32 = i;
+        if (epoll_ctl(epoll, EPOLL_CTL_ADD, slots[i].source->Descriptor(), &event) < 0)
+        {
+            fprintf(stderr, "Failed to watch %s for input!\n", slots[i].source->Name());
+        }
+    }
+#endif
+
+    return true;
+}
+
+void InputMux::Close()
+{
+#ifdef _WIN32
+    if (window != NULL)
+    {
+        timeEndPeriod(1);
+        DestroyWindow(window);
+        window = NULL;
+    }
+#else
+    if (epoll >= 0)
+    {
+        close(epoll);
+        epoll = -1;
+    }
+#endif
+}
+
+/**
+ * Sleeps until any source has input or the time is up, then hands every
+ * change that arrived to the callback.
+ */
+void InputMux::Wait(unsigned long long microseconds, input_change_t newChange, void *newContext)
+{
+    change = newChange;
+    context = newContext;
+
+    /* Round up, waking early would only mean spinning until it's time */
+#ifdef _WIN32
+    DWORD milliseconds = (DWORD)((microseconds + 999) / 1000);
+    if (MsgWaitForMultipleObjects(0, NULL, FALSE, milliseconds, QS_RAWINPUT) == WAIT_OBJECT_0)
+    {
+        MSG msg;
+        while (PeekMessage(&msg, window, 0, 0, PM_REMOVE))
+        {
+            DispatchMessage(&msg);
+        }
+    }
+#else
+    int milliseconds = (int)((microseconds + 999) / 1000);
+    struct epoll_event events[INPUT_MAX_SOURCES];
+    int ready = epoll_wait(epoll, events, INPUT_MAX_SOURCES, milliseconds);
+
+    for (int i = 0; i < ready; i++)
+    {
+        input_slot_t *slot = &slots[events[i].data.u32];
+        if (events[i].events & EPOLLIN)
+        {
+            slot->source->Read(SourceChanged, slot);
+        }
+
+        /* Unplugged, stop listening so we don't spin on it */
+        if (events[i].events & (EPOLLERR | EPOLLHUP))
+        {
+            fprintf(stderr, "Lost input source %s!\n", slot->source->Name());
+            epoll_ctl(epoll, EPOLL_CTL_DEL, slot->source->Descriptor(), NULL);
+            if (slot->held != 0)
+            {
+                SourceChanged(slot, 0, ClockMicroseconds());
+            }
+        }
+    }
+#endif
+
+    change = NULL;
+    context = NULL;
+}
+
+void InputMux::SourceChanged(void *param, unsigned int held, unsigned long long when)
+{
+    input_slot_t *slot = (input_slot_t *)param;
+    InputMux *mux = slot->mux;
+    slot->held = held;
+
+    unsigned int merged = 0;
+    for (unsigned int i = 0; i < mux->count; i++)
+    {
+        merged |= mux->slots[i].held;
+    }
+
+    mux->change(mux->context, slot->index, merged, when);
+}
+
+#ifdef _WIN32
+LRESULT CALLBACK InputMux::WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
+{
+    if (uMsg == WM_INPUT)
+    {
+        InputMux *mux = (InputMux *)GetWindowLongPtr(hwnd, GWLP_USERDATA);
+        if (mux != NULL && mux->change != NULL)
+        {
+            mux->Dispatch((HRAWINPUT)lParam);
+        }
+    }
+
+    /* WM_INPUT still has to go through here so the system can clean up */
+    return DefWindowProc(hwnd, uMsg, wParam, lParam);
+}
+
+void InputMux::Dispatch(HRAWINPUT handle)
+{
+    /* We only ask for keyboards, anything bigger isn't ours */
+    RAWINPUT input;
+    UINT size = sizeof(input);
+    if (GetRawInputData(handle, RID_INPUT, &input, &size, sizeof(RAWINPUTHEADER)) == (UINT)-1)
+    {
+        return;
+    }
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        if (slots[i].source->Input(&input, SourceChanged, &slots[i]))
+        {
+            return;
+        }
+    }
+}
+#endif
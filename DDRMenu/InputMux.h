@@ -0,0 +1,59 @@
+#pragma once
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include "InputSource.h"
+
+/* Most sources we'll merge besides the cabinet itself */
+#define INPUT_MAX_SOURCES 8
+
+/* Handed every change on any source, with what all the sources hold together */
+typedef void (*input_change_t)(void *context, unsigned int source, unsigned int held, unsigned long long when);
+
+/**
+ * Waits on every extra input source at once, with epoll on Linux and raw
+ * input messages on Windows, and merges what they hold into one mask. Sources
+ * are added up front on the main thread. Everything after that, from Open()
+ * to Close(), happens on the input thread.
+ */
+class InputMux
+{
+public:
+    InputMux();
+    ~InputMux();
+
+    bool Add(InputSource *source);
+    unsigned int Count() { return count; }
+    const char *Name(unsigned int source) { return slots[source].source->Name(); }
+
+    bool Open();
+    void Close();
+    void Wait(unsigned long long microseconds, input_change_t change, void *context);
+private:
+    typedef struct
+    {
+        InputSource *source;
+        InputMux *mux;
+        unsigned int index;
+        unsigned int held;
+    } input_slot_t;
+
+    input_slot_t slots[INPUT_MAX_SOURCES];
+    unsigned int count;
+
+    /* Where changes go for the duration of a Wait() */
+    input_change_t change;
+    void *context;
+
+    static void SourceChanged(void *context, unsigned int held, unsigned long long when);
+
+#ifdef _WIN32
+    HWND window;
+    static LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
+    void Dispatch(HRAWINPUT handle);
+#else
+    int epoll;
+#endif
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "Thread.h"
+
+/* Must be a power of two */
+#define INPUT_RING_SIZE 256
+
+typedef struct
+{
+    unsigned long long timestamp;
+    unsigned int source;
+    unsigned int buttons;
+    unsigned int pressed;
+    unsigned int released;
+} input_event_t;
+
+/**
+ * Lock-free queue of button edges. Exactly one thread may Push() and exactly
+ * one other thread may Pop(), each side only ever writes its own index.
+ */
+class InputRing
+{
+public:
+    InputRing()
+    {
+        head = 0;
+        tail = 0;
+    }
+
+    bool Push(const input_event_t &event)
+    {
+        long write = head;
+        if (write - AtomicLoad(&tail) >= INPUT_RING_SIZE)
+        {
+            /* Consumer has fallen behind */
+            return false;
+        }
+
+        events[write & (INPUT_RING_SIZE - 1)] = event;
+        AtomicStore(&head, write + 1);
+        return true;
+    }
+
+    bool Pop(input_event_t *event)
+    {
+        long read = tail;
+        if (read == AtomicLoad(&head))
+        {
+            /* Nothing new */
+            return false;
+        }
+
+        *event = events[read & (INPUT_RING_SIZE - 1)];
+        AtomicStore(&tail, read + 1);
+        return true;
+    }
+private:
+    input_event_t events[INPUT_RING_SIZE];
+    volatile long head;
+    volatile long tail;
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+/* Handed every change a source sees, in the order it saw them, with the
+   ClockMicroseconds() time each one happened */
+typedef void (*source_change_t)(void *context, unsigned int held, unsigned long long when);
+
+/**
+ * Something besides the cabinet that can hold BUTTON_* bits down, such as a
+ * keyboard or gamepad. Sources are never polled, InputMux waits on all of them
+ * at once on the input thread and only hands them input once there is some.
+ * A source reports every change rather than just where it ended up, so a tap
+ * that comes and goes between wakeups is still seen.
+ */
+class InputSource
+{
+public:
+    virtual ~InputSource() {}
+
+    virtual const char *Name() = 0;
+    virtual bool Ready() = 0;
+
+#ifdef _WIN32
+    /* Asks for this source's raw input to be sent to the input thread's window */
+    virtual bool Register(HWND window) = 0;
+
+    /* Offered every WM_INPUT, returns false if it belongs to someone else */
+    virtual bool Input(const RAWINPUT *input, source_change_t change, void *context) = 0;
+#else
+    /* Becomes readable whenever there is input waiting */
+    virtual int Descriptor() = 0;
+
+    /* Reads everything waiting without blocking */
+    virtual void Read(source_change_t change, void *context) = 0;
+#endif
+};
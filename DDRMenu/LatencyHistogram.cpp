@@ -0,0 +1,105 @@
+#include <string.h>
+
+#include "LatencyHistogram.h"
+
+LatencyHistogram::LatencyHistogram(const char *histogramName)
+{
+    name = histogramName;
+    Reset();
+}
+
+void LatencyHistogram::Reset()
+{
+    count = 0;
+    max = 0;
+    total = 0;
+    memset(buckets, 0, sizeof(buckets));
+}
+
+void LatencyHistogram::Record(unsigned long long microseconds)
+{
+    buckets[Bucket(microseconds)]++;
+    count++;
+    total += microseconds;
+    if (microseconds > max)
+    {
+        max = microseconds;
+    }
+}
+
+/**
+ * Returns the upper bound of the bucket the given percentile falls in, so
+ * this never reports something better than what was actually measured.
+ */
+unsigned long long LatencyHistogram::Percentile(double percent)
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    unsigned long long wanted = (unsigned long long)((count * percent) / 100.0);
+    if (wanted >= count)
+    {
+        wanted = count - 1;
+    }
+
+    unsigned long long seen = 0;
+    for (unsigned int i = 0; i < LATENCY_BUCKETS; i++)
+    {
+        seen += buckets[i];
+        if (seen > wanted)
+        {
+            unsigned long long limit = BucketLimit(i);
+            return limit < max ? limit : max;
+        }
+    }
+
+    return max;
+}
+
+void LatencyHistogram::Dump(FILE *fp)
+{
+    fprintf(
+        fp,
+        "%s: count %u, mean %llu us, p50 %llu us, p99 %llu us, max %llu us\n",
+        name,
+        count,
+        count > 0 ? total / count : 0,
+        Percentile(50.0),
+        Percentile(99.0),
+        max
+    );
+}
+
+unsigned int LatencyHistogram::Bucket(unsigned long long microseconds)
+{
+    if (microseconds < LATENCY_LINEAR_BUCKETS)
+    {
+        return (unsigned int)microseconds;
+    }
+
+    /* Find the top bit, then use the next three bits to pick a sub bucket */
+    unsigned int exponent = 0;
+    while ((microseconds >> (exponent + 1)) != 0)
+    {
+        exponent++;
+    }
+
+    unsigned int sub = (unsigned int)(microseconds >> (exponent - 3)) & (LATENCY_SUB_BUCKETS - 1);
+    unsigned int bucket = LATENCY_LINEAR_BUCKETS + ((exponent - 4) * LATENCY_SUB_BUCKETS) + sub;
+    return bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1;
+}
+
+unsigned long long LatencyHistogram::BucketLimit(unsigned int bucket)
+{
+    if (bucket < LATENCY_LINEAR_BUCKETS)
+    {
+        return bucket;
+    }
+
+    unsigned int exponent = ((bucket - LATENCY_LINEAR_BUCKETS) / LATENCY_SUB_BUCKETS) + 4;
+    unsigned int sub = (bucket - LATENCY_LINEAR_BUCKETS) % LATENCY_SUB_BUCKETS;
+    unsigned long long base = 1ULL << exponent;
+    return base + (((sub + 1) * base) / LATENCY_SUB_BUCKETS) - 1;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdio.h>
+
+/* Values under this are counted exactly, above it each power of two is split into 8 */
+#define LATENCY_LINEAR_BUCKETS 16
+#define LATENCY_SUB_BUCKETS 8
+#define LATENCY_BUCKETS (LATENCY_LINEAR_BUCKETS + (60 * LATENCY_SUB_BUCKETS))
+
+/**
+ * Log-scaled histogram of microsecond latencies. Recording is constant time
+ * and allocation free, percentiles are accurate to within 1/8th of the value.
+ */
+class LatencyHistogram
+{
+public:
+    LatencyHistogram(const char *name);
+
+    void Record(unsigned long long microseconds);
+    void Reset();
+
+    unsigned int Count() { return count; }
+    unsigned long long Max() { return max; }
+    unsigned long long Percentile(double percent);
+
+    void Dump(FILE *fp);
+private:
+    const char *name;
+    unsigned int count;
+    unsigned long long max;
+    unsigned long long total;
+    unsigned int buckets[LATENCY_BUCKETS];
+
+    static unsigned int Bucket(unsigned long long microseconds);
+    static unsigned long long BucketLimit(unsigned int bucket);
+};
@@ -0,0 +1,353 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "LaunchValidator.h"
+#include "Clock.h"
+
+LaunchValidator::LaunchValidator()
+{
+    current = NULL;
+    pending = NULL;
+    running = 1;
+    if (!worker.Start(WorkerThread, this))
+    {
+        fprintf(stderr, "Failed to start launch validator thread!\n");
+        running = 0;
+    }
+}
+
+/**
+ * Only safe once Stop() says the worker has finished, a worker stuck on a
+ * dead disk is left for the process exiting to clean up instead.
+ */
+LaunchValidator::~LaunchValidator()
+{
+    if (pending != NULL)
+    {
+        Release(pending);
+    }
+    if (current != NULL)
+    {
+        Release(current);
+    }
+}
+
+void LaunchValidator::Release(validate_job_t *job)
+{
+    if (AtomicDecrement(&job->references) == 0)
+    {
+        free(job->text);
+        free(job->locations);
+        free((void *)job->status);
+        free(job->size);
+        free(job->modified);
+        free(job);
+    }
+}
+
+/**
+ * Starts checking a catalog, abandoning whatever was being checked before.
+ * Everything the worker needs is copied, so the catalog can go away as soon
+ * as this returns.
+ */
+void LaunchValidator::Validate(Catalog *catalog)
+{
+    unsigned int count = catalog->Count();
+    validate_job_t *job = (validate_job_t *)malloc(sizeof(validate_job_t));
+    job->references = 2;
+    job->cancelled = 0;
+    job->count = count;
+    job->text = (char *)malloc(catalog->TextLength() > 0 ? catalog->TextLength() : 1);
+    memcpy(job->text, catalog->Text(), catalog->TextLength());
+    job->locations = (unsigned int *)malloc(sizeof(unsigned int) * (count > 0 ? count : 1));
+    job->status = (volatile long *)calloc(count > 0 ? count : 1, sizeof(long));
+    job->size = (unsigned long long *)calloc(count > 0 ? count : 1, sizeof(unsigned long long));
+    job->modified = (unsigned long long *)calloc(count > 0 ? count : 1, sizeof(unsigned long long));
+    job->deadline = 0;
+    job->started = 0;
+    job->finished = 0;
+    job->checked = 0;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        job->locations[i] = (unsigned int)(catalog->GetLocation(i) - catalog->Text());
+    }
+
+    lock.Lock();
+    validate_job_t *previous = current;
+    validate_job_t *skipped = pending;
+    current = job;
+    pending = job;
+    lock.Unlock();
+
+    /* One reference each for us and the worker, and the worker never saw
+       a job that was still pending */
+    if (previous != NULL)
+    {
+        AtomicStore(&previous->cancelled, 1);
+        Release(previous);
+    }
+    if (skipped != NULL)
+    {
+        Release(skipped);
+    }
+
+    wake.Set();
+}
+
+unsigned int LaunchValidator::Status(unsigned int entry)
+{
+    if (current == NULL || entry >= current->count)
+    {
+        return VALIDATE_UNKNOWN;
+    }
+    return (unsigned int)AtomicLoad(&current->status[entry]);
+}
+
+/**
+ * Goes up every time another result comes in, so callers know when to look.
+ */
+unsigned int LaunchValidator::Progress()
+{
+    return current != NULL ? (unsigned int)AtomicLoad(&current->checked) : 0;
+}
+
+/**
+ * Asks the worker to finish up, waiting at most the given time for any check
+ * already in progress. Returns false if it's still stuck in one, in which
+ * case the validator must be left alone rather than deleted.
+ */
+bool LaunchValidator::Stop(unsigned int milliseconds)
+{
+    if (!worker.Started())
+    {
+        return true;
+    }
+
+    AtomicStore(&running, 0);
+    if (current != NULL)
+    {
+        AtomicStore(&current->cancelled, 1);
+    }
+    wake.Set();
+
+    if (!finished.Wait(milliseconds))
+    {
+        fprintf(stderr, "Launch validator is stuck, leaving it behind!\n");
+        return false;
+    }
+
+    worker.Join();
+    return true;
+}
+
+void LaunchValidator::WorkerThread(void *param)
+{
+    LaunchValidator *validator = (LaunchValidator *)param;
+
+    while (AtomicLoad(&validator->running))
+    {
+        if (!validator->wake.Wait(100))
+        {
+            continue;
+        }
+
+        validator->lock.Lock();
+        validate_job_t *job = validator->pending;
+        validator->pending = NULL;
+        validator->lock.Unlock();
+
+        if (job == NULL)
+        {
+            continue;
+        }
+
+        job->started = ClockMicroseconds();
+        job->deadline = job->started + (VALIDATE_BUDGET_MS * 1000ULL);
+        ParallelFor(job->count, VALIDATE_THREADS, CheckEntry, job);
+        job->finished = ClockMicroseconds();
+
+        Release(job);
+    }
+
+    validator->finished.Set();
+}
+
+static bool IsRegularFile(const char *path)
+{
+#ifdef _WIN32
+    DWORD attributes = GetFileAttributesA(path);
+    return attributes != INVALID_FILE_ATTRIBUTES && !(attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+    struct stat info;
+    return stat(path, &info) == 0 && S_ISREG(info.st_mode);
+#endif
+}
+
+/**
+ * The launcher runs anything that isn't a file as a command line. Only the
+ * program at the start of one can be checked, and only when it's given with
+ * a directory, otherwise it's up to the shell to find it. A command whose
+ * program is there is left unchecked rather than second guessing the rest.
+ */
+static long CheckCommandLine(const char *path)
+{
+    const char *start = path;
+    const char *end;
+    if (*start == '"')
+    {
+        start++;
+        end = strchr(start, '"');
+        if (end == NULL)
+        {
+            end = start + strlen(start);
+        }
+    }
+    else
+    {
+        end = start + strcspn(start, " \t");
+    }
+
+    unsigned int length = (unsigned int)(end - start);
+    bool directory = false;
+    for (unsigned int i = 0; i < length; i++)
+    {
+        directory = directory || start[i] == '\\' || start[i] == '/';
+    }
+    if (!directory)
+    {
+        return VALIDATE_UNKNOWN;
+    }
+
+    /* Nothing after it, so it's the same path that wasn't there */
+    if (start == path && *end == 0)
+    {
+        return VALIDATE_MISSING;
+    }
+
+    char *program = (char *)malloc(length + 1);
+    memcpy(program, start, length);
+    program[length] = 0;
+    long status = IsRegularFile(program) ? VALIDATE_UNKNOWN : VALIDATE_MISSING;
+    free(program);
+
+    return status;
+}
+
+/**
+ * Checks one launch target with a single metadata lookup and a single open,
+ * unless this catalog has been replaced or has run out of time.
+ */
+void LaunchValidator::CheckEntry(void *context, unsigned int item)
+{
+    validate_job_t *job = (validate_job_t *)context;
+    if (AtomicLoad(&job->cancelled) || ClockMicroseconds() > job->deadline)
+    {
+        return;
+    }
+
+    const char *path = job->text + job->locations[item];
+    long status = VALIDATE_OK;
+
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &info))
+    {
+        status = CheckCommandLine(path);
+    }
+    else if ((info.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+    {
+        status = VALIDATE_MISSING;
+    }
+    else
+    {
+        job->size[item] = ((unsigned long long)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+        job->modified[item] = ((unsigned long long)info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime;
+
+        HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            status = VALIDATE_UNREADABLE;
+        }
+        else
+        {
+            CloseHandle(file);
+        }
+    }
+#else
+    struct stat info;
+    if (stat(path, &info) != 0)
+    {
+        status = CheckCommandLine(path);
+    }
+    else if (!S_ISREG(info.st_mode))
+    {
+        status = VALIDATE_MISSING;
+    }
+    else
+    {
+        job->size[item] = (unsigned long long)info.st_size;
+        job->modified[item] = ((unsigned long long)info.st_mtim.tv_sec * 1000000000) + info.st_mtim.tv_nsec;
+
+        int file = open(path, O_RDONLY);
+        if (file < 0)
+        {
+            status = VALIDATE_UNREADABLE;
+        }
+        else
+        {
+            close(file);
+        }
+    }
+#endif
+
+    if (status == VALIDATE_OK && job->size[item] == 0)
+    {
+        status = VALIDATE_EMPTY;
+    }
+
+    AtomicStore(&job->status[item], status);
+    AtomicIncrement(&job->checked);
+}
+
+void LaunchValidator::Dump(FILE *fp)
+{
+    validate_job_t *job = current;
+    if (job == NULL)
+    {
+        return;
+    }
+
+    unsigned int counts[VALIDATE_EMPTY + 1] = { 0 };
+    for (unsigned int i = 0; i < job->count; i++)
+    {
+        unsigned int status = (unsigned int)AtomicLoad(&job->status[i]);
+        counts[status]++;
+        if (status > VALIDATE_OK)
+        {
+            fprintf(
+                fp,
+                "launch validator: %s is %s\n",
+                job->text + job->locations[i],
+                status == VALIDATE_MISSING ? "missing" : (status == VALIDATE_UNREADABLE ? "unreadable" : "empty")
+            );
+        }
+    }
+
+    fprintf(
+        fp,
+        "launch validator: %u ok, %u missing, %u unreadable, %u empty, %u unchecked\n",
+        counts[VALIDATE_OK],
+        counts[VALIDATE_MISSING],
+        counts[VALIDATE_UNREADABLE],
+        counts[VALIDATE_EMPTY],
+        counts[VALIDATE_UNKNOWN]
+    );
+}
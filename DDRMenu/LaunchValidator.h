@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stdio.h>
+
+#include "Catalog.h"
+#include "Thread.h"
+
+/* Checks run side by side, so one dead disk only holds up its own entries */
+#define VALIDATE_THREADS 4
+
+/* No check is started once a catalog has been going this long */
+#define VALIDATE_BUDGET_MS 5000
+
+/* How long shutting down waits for a check stuck on a dead disk */
+#define VALIDATE_STOP_MS 100
+
+/* What we know about an entry's launch target */
+#define VALIDATE_UNKNOWN 0
+#define VALIDATE_OK 1
+#define VALIDATE_MISSING 2
+#define VALIDATE_UNREADABLE 3
+#define VALIDATE_EMPTY 4
+
+/* One catalog's worth of checks, shared by the main thread and the checker */
+typedef struct
+{
+    volatile long references;
+    volatile long cancelled;
+
+    char *text;
+    unsigned int *locations;
+    unsigned int count;
+
+    volatile long *status;
+    unsigned long long *size;
+    unsigned long long *modified;
+
+    unsigned long long deadline;
+    unsigned long long started;
+    unsigned long long finished;
+    volatile long checked;
+} validate_job_t;
+
+/**
+ * Checks that every entry's launch target exists, can be opened and isn't
+ * empty, off the main thread, so a missing drive or renamed folder shows up
+ * in the menu instead of the launch silently doing nothing. Results come in
+ * as they're found and are read without waiting. A new catalog replaces the
+ * one being checked.
+ */
+class LaunchValidator
+{
+public:
+    LaunchValidator();
+    ~LaunchValidator();
+
+    void Validate(Catalog *catalog);
+    unsigned int Status(unsigned int entry);
+    unsigned int Progress();
+    bool Stop(unsigned int milliseconds);
+
+    void Dump(FILE *fp);
+private:
+    static void WorkerThread(void *param);
+    static void CheckEntry(void *context, unsigned int item);
+    static void Release(validate_job_t *job);
+
+    Thread worker;
+    Event wake;
+    Event finished;
+    volatile long running;
+
+    /* The newest job, which the main thread reads results from, and the
+       next one for the worker to pick up */
+    validate_job_t *current;
+    validate_job_t *pending;
+    Mutex lock;
+};
@@ -0,0 +1,183 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <spawn.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <strings.h>
+#define _stricmp strcasecmp
+extern char **environ;
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include "Launcher.h"
+#include "Clock.h"
+#include "Thread.h"
+
+Launcher::Launcher(const char *gamePath)
+{
+    unsigned int pathLength = strlen(gamePath);
+    path = new char[pathLength + 1];
+    memcpy(path, gamePath, pathLength + 1);
+
+    /* Games expect to be started from where they live */
+    directory = NULL;
+    const char *slash = strrchr(path, '\\');
+    const char *other = strrchr(path, '/');
+    if (other > slash)
+    {
+        slash = other;
+    }
+    if (slash != NULL && IsFile())
+    {
+        unsigned int length = slash - path;
+        directory = new char[length + 2];
+        memcpy(directory, path, length);
+
+        /* Keep the separator for drive roots like C:\ */
+        if (length == 0 || path[length - 1] == ':')
+        {
+            directory[length++] = *slash;
+        }
+        directory[length] = 0;
+    }
+
+    started = ClockMicroseconds();
+    released = 0;
+    launched = 0;
+    timedOut = false;
+}
+
+Launcher::~Launcher()
+{
+    delete[] path;
+    delete[] directory;
+}
+
+/**
+ * Waits for the IO to be free for the game to open, up to the given number
+ * of milliseconds. Passing a NULL check means there is nothing to wait on.
+ */
+bool Launcher::WaitForRelease(release_check_t check, unsigned int timeout)
+{
+    started = ClockMicroseconds();
+    unsigned long long deadline = started + timeout * 1000ULL;
+
+    while (check != NULL && !check())
+    {
+        if (ClockMicroseconds() >= deadline)
+        {
+            fprintf(stderr, "IO still in use after %u ms, launching anyway!\n", timeout);
+            timedOut = true;
+            break;
+        }
+        ThreadSleep(LAUNCH_RELEASE_POLL_MS * 1000);
+    }
+
+    released = ClockMicroseconds();
+    return !timedOut;
+}
+
+bool Launcher::IsFile()
+{
+#ifdef _WIN32
+    DWORD attributes = GetFileAttributesA(path);
+    return attributes != INVALID_FILE_ATTRIBUTES && !(attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+    struct stat info;
+    return stat(path, &info) == 0 && S_ISREG(info.st_mode);
+#endif
+}
+
+bool Launcher::IsScript()
+{
+    const char *extension = strrchr(path, '.');
+    if (extension == NULL)
+    {
+        return false;
+    }
+
+#ifdef _WIN32
+    return _stricmp(extension, ".bat") == 0 || _stricmp(extension, ".cmd") == 0;
+#else
+    return _stricmp(extension, ".sh") == 0;
+#endif
+}
+
+bool Launcher::Launch()
+{
+    /* Anything that isn't a plain executable needs the shell, same as
+       when this went through a batch file */
+    bool file = IsFile();
+    bool shell = !file || IsScript();
+
+#ifdef _WIN32
+    unsigned int length = strlen(path) + 32;
+    char *command = new char[length];
+    if (!file)
+    {
+        sprintf_s(command, length, "cmd.exe /c %s", path);
+    }
+    else if (shell)
+    {
+        /* cmd strips the outer quotes, leaving the path itself quoted */
+        sprintf_s(command, length, "cmd.exe /c \"\"%s\"\"", path);
+    }
+    else
+    {
+        sprintf_s(command, length, "\"%s\"", path);
+    }
+
+    STARTUPINFOA info = { sizeof(info) };
+    PROCESS_INFORMATION processInfo;
+    BOOL success = CreateProcessA(NULL, command, NULL, NULL, FALSE, 0, NULL, directory, &info, &processInfo);
+    delete[] command;
+
+    if (!success)
+    {
+        fprintf(stderr, "Failed to launch %s!\n", path);
+        return false;
+    }
+
+    CloseHandle(processInfo.hThread);
+    CloseHandle(processInfo.hProcess);
+#else
+    /* We're on our way out, so it's fine to move ourselves there first */
+    if (directory != NULL && chdir(directory) != 0)
+    {
+        fprintf(stderr, "Failed to change to %s!\n", directory);
+    }
+
+    /* Scripts are handed to the shell as a file, so spaces in the path are
+       fine, while anything else is a command line for it to split up */
+    char sh[] = "/bin/sh";
+    char c[] = "-c";
+    char *scriptArgs[] = { sh, path, NULL };
+    char *commandArgs[] = { sh, c, path, NULL };
+    char *fileArgs[] = { path, NULL };
+    char **args = !shell ? fileArgs : (file ? scriptArgs : commandArgs);
+
+    pid_t pid;
+    if (posix_spawn(&pid, args[0], NULL, NULL, args, environ) != 0)
+    {
+        fprintf(stderr, "Failed to launch %s!\n", path);
+        return false;
+    }
+#endif
+
+    launched = ClockMicroseconds();
+    return true;
+}
+
+void Launcher::Dump(FILE *fp)
+{
+    fprintf(
+        fp,
+        "launch: IO released after %llu us%s, game started %llu us later\n",
+        released >= started ? released - started : 0,
+        timedOut ? " (timed out)" : "",
+        launched >= released ? launched - released : 0
+    );
+}
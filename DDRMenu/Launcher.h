@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdio.h>
+
+/* How long we'll wait for the IO drivers to let go before launching anyway */
+#define LAUNCH_RELEASE_TIMEOUT_MS 2000
+
+/* How often we check whether the IO has been released */
+#define LAUNCH_RELEASE_POLL_MS 10
+
+/* Returns true once nothing is holding on to the IO the game needs */
+typedef bool (*release_check_t)();
+
+/**
+ * Hands the cabinet over to the chosen game. The game is started directly
+ * from its own directory, batch files go through the command interpreter
+ * and anything that isn't a file on disk is run as a command line.
+ */
+class Launcher
+{
+public:
+    Launcher(const char *path);
+    ~Launcher();
+
+    bool WaitForRelease(release_check_t released, unsigned int timeout);
+    bool Launch();
+
+    void Dump(FILE *fp);
+private:
+    char *path;
+    char *directory;
+
+    unsigned long long started;
+    unsigned long long released;
+    unsigned long long launched;
+    bool timedOut;
+
+    bool IsFile();
+    bool IsScript();
+};
@@ -0,0 +1,211 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "LightAnimator.h"
+#include "IO.h"
+
+/* Menu buttons blink once a second, so people know they can use the menu */
+static const light_keyframe_t menuBlinkFrames[] =
+{
+    { LIGHT_1P_MENU | LIGHT_2P_MENU, 1000 },
+    { 0, 1000 },
+};
+
+/* A single light chasing around the marquee corners */
+static const light_keyframe_t marqueeChaseFrames[] =
+{
+    { LIGHT_MARQUEE_UPPER_LEFT, 250 },
+    { LIGHT_MARQUEE_UPPER_RIGHT, 250 },
+    { LIGHT_MARQUEE_LOWER_RIGHT, 250 },
+    { LIGHT_MARQUEE_LOWER_LEFT, 250 },
+};
+
+/* Both pads spinning around their arrows together */
+static const light_keyframe_t padSweepFrames[] =
+{
+    { LIGHT_1P_UP | LIGHT_2P_UP, 200 },
+    { LIGHT_1P_RIGHT | LIGHT_2P_RIGHT, 200 },
+    { LIGHT_1P_DOWN | LIGHT_2P_DOWN, 200 },
+    { LIGHT_1P_LEFT | LIGHT_2P_LEFT, 200 },
+};
+
+/* Bass neons thump twice a beat */
+static const light_keyframe_t neonPulseFrames[] =
+{
+    { LIGHT_BASS_NEONS, 100 },
+    { 0, 100 },
+    { LIGHT_BASS_NEONS, 100 },
+    { 0, 700 },
+};
+
+const light_timeline_t lightMenuBlink = LIGHT_TIMELINE(menuBlinkFrames, LIGHT_1P_MENU | LIGHT_2P_MENU);
+const light_timeline_t lightMarqueeChase = LIGHT_TIMELINE(
+    marqueeChaseFrames,
+    LIGHT_MARQUEE_UPPER_LEFT | LIGHT_MARQUEE_UPPER_RIGHT | LIGHT_MARQUEE_LOWER_RIGHT | LIGHT_MARQUEE_LOWER_LEFT
+);
+const light_timeline_t lightPadSweep = LIGHT_TIMELINE(
+    padSweepFrames,
+    LIGHT_1P_UP | LIGHT_1P_RIGHT | LIGHT_1P_DOWN | LIGHT_1P_LEFT | LIGHT_2P_UP | LIGHT_2P_RIGHT | LIGHT_2P_DOWN | LIGHT_2P_LEFT
+);
+const light_timeline_t lightNeonPulse = LIGHT_TIMELINE(neonPulseFrames, LIGHT_BASS_NEONS);
+
+LightAnimator::LightAnimator()
+{
+    memset(tracks, 0, sizeof(tracks));
+    count = 0;
+    wanted = 0;
+    lights = 0;
+    cabReady = 0;
+    padReady = 0;
+    keyframes = 0;
+    frames = 0;
+    deferred = 0;
+}
+
+/**
+ * Starts a timeline from its first keyframe. A timeline that is already
+ * playing restarts.
+ */
+bool LightAnimator::Play(const light_timeline_t *timeline, unsigned long long now)
+{
+    if (timeline->count == 0)
+    {
+        return false;
+    }
+
+    Stop(timeline);
+    if (count >= LIGHT_MAX_TRACKS)
+    {
+        fprintf(stderr, "Too many light timelines playing at once!\n");
+        return false;
+    }
+
+    light_track_t *track = &tracks[count++];
+    track->timeline = timeline;
+    track->frame = 0;
+    track->period = 0;
+    for (unsigned int i = 0; i < timeline->count; i++)
+    {
+        track->period += timeline->frames[i].duration * 1000ULL;
+    }
+    track->deadline = now + timeline->frames[0].duration * 1000ULL;
+
+    /* Show the first keyframe straight away */
+    wanted = (wanted & ~timeline->mask) | (timeline->frames[0].lights & timeline->mask);
+    return true;
+}
+
+void LightAnimator::Stop(const light_timeline_t *timeline)
+{
+    for (unsigned int i = 0; i < count; i++)
+    {
+        if (tracks[i].timeline == timeline)
+        {
+            wanted &= ~timeline->mask;
+            tracks[i] = tracks[--count];
+            return;
+        }
+    }
+}
+
+/**
+ * Advances every timeline whose deadline has passed and works out what can
+ * go out to each bus. Returns true if Lights() changed.
+ */
+bool LightAnimator::Update(unsigned long long now)
+{
+    for (unsigned int i = 0; i < count; i++)
+    {
+        light_track_t *track = &tracks[i];
+        const light_timeline_t *timeline = track->timeline;
+        if (track->deadline > now)
+        {
+            continue;
+        }
+
+        /* If we slept through whole loops, don't replay them */
+        if (track->period > 0 && now - track->deadline >= track->period)
+        {
+            track->deadline += ((now - track->deadline) / track->period) * track->period;
+        }
+
+        while (track->deadline <= now)
+        {
+            track->frame = (track->frame + 1) % timeline->count;
+            track->deadline += timeline->frames[track->frame].duration * 1000ULL;
+            keyframes++;
+
+            /* Guard against a table of all zero durations */
+            if (track->period == 0)
+            {
+                track->deadline = now + 1000;
+            }
+        }
+
+        wanted = (wanted & ~timeline->mask) | (timeline->frames[track->frame].lights & timeline->mask);
+    }
+
+    /* Only buses with changed bits cost a frame */
+    bool cab = UpdateBus(LIGHT_CAB_MASK, &cabReady, LIGHT_CAB_MIN_INTERVAL_US, now);
+    bool pad = UpdateBus(LIGHT_PAD_MASK, &padReady, LIGHT_PAD_MIN_INTERVAL_US, now);
+    return cab || pad;
+}
+
+bool LightAnimator::UpdateBus(unsigned int mask, unsigned long long *ready, unsigned long long interval, unsigned long long now)
+{
+    if (((wanted ^ lights) & mask) == 0)
+    {
+        return false;
+    }
+
+    if (now < *ready)
+    {
+        /* Bus is still busy with the last frame, try again once it's free */
+        deferred++;
+        return false;
+    }
+
+    lights = (lights & ~mask) | (wanted & mask);
+    *ready = now + interval;
+    frames++;
+    return true;
+}
+
+/**
+ * Returns when Update() next has something to do, or 0 if nothing is playing.
+ */
+unsigned long long LightAnimator::NextDeadline()
+{
+    unsigned long long next = 0;
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        if (next == 0 || tracks[i].deadline < next)
+        {
+            next = tracks[i].deadline;
+        }
+    }
+
+    /* A held back frame is due as soon as its bus frees up */
+    if (((wanted ^ lights) & LIGHT_CAB_MASK) && (next == 0 || cabReady < next))
+    {
+        next = cabReady;
+    }
+    if (((wanted ^ lights) & LIGHT_PAD_MASK) && (next == 0 || padReady < next))
+    {
+        next = padReady;
+    }
+
+    return next;
+}
+
+void LightAnimator::Dump(FILE *fp)
+{
+    fprintf(
+        fp,
+        "light animator: %u keyframes played, %u frames sent, %u held back for bandwidth\n",
+        keyframes,
+        frames,
+        deferred
+    );
+}
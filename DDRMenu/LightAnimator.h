@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdio.h>
+
+/* How many timelines can play at once, each over its own set of lights */
+#define LIGHT_MAX_TRACKS 8
+
+/* P3IO 0x24 is a USB round trip, so allow one USB frame out and one back */
+#define LIGHT_CAB_MIN_INTERVAL_US 2000
+
+/* EXTIO is a 4 byte frame plus a 1 byte ack at 38400 8N1, so allow twice that */
+#define LIGHT_PAD_MIN_INTERVAL_US ((4 + 1) * 10 * 1000000 / 38400 * 2)
+
+typedef struct
+{
+    unsigned int lights;
+    unsigned short duration;
+} light_keyframe_t;
+
+typedef struct
+{
+    const light_keyframe_t *frames;
+    unsigned int count;
+    unsigned int mask;
+} light_timeline_t;
+
+/* Builds a looping timeline over a static keyframe table, with durations in milliseconds */
+#define LIGHT_TIMELINE(frames, mask) { frames, sizeof(frames) / sizeof(frames[0]), mask }
+
+/* Patterns the menu plays while waiting for someone to pick a game */
+extern const light_timeline_t lightMenuBlink;
+extern const light_timeline_t lightMarqueeChase;
+extern const light_timeline_t lightPadSweep;
+extern const light_timeline_t lightNeonPulse;
+
+/**
+ * Plays keyframe timelines over the LIGHT_* bits. Nothing is done between
+ * keyframes, Update() only does work once a deadline passes, and the caller
+ * can schedule the next call for NextDeadline(). Changes to each bus are held
+ * back so they never go out faster than that bus can take them.
+ */
+class LightAnimator
+{
+public:
+    LightAnimator();
+
+    bool Play(const light_timeline_t *timeline, unsigned long long now);
+    void Stop(const light_timeline_t *timeline);
+    bool Update(unsigned long long now);
+
+    unsigned int Lights() { return lights; }
+    unsigned long long NextDeadline();
+
+    void Dump(FILE *fp);
+private:
+    typedef struct
+    {
+        const light_timeline_t *timeline;
+        unsigned int frame;
+        unsigned long long period;
+        unsigned long long deadline;
+    } light_track_t;
+
+    light_track_t tracks[LIGHT_MAX_TRACKS];
+    unsigned int count;
+
+    /* What the timelines want right now, vs what we've let out so far */
+    unsigned int wanted;
+    unsigned int lights;
+
+    /* Earliest each bus can take another frame */
+    unsigned long long cabReady;
+    unsigned long long padReady;
+
+    unsigned int keyframes;
+    unsigned int frames;
+    unsigned int deferred;
+
+    bool UpdateBus(unsigned int mask, unsigned long long *ready, unsigned long long interval, unsigned long long now);
+};
@@ -0,0 +1,92 @@
+#include <stdio.h>
+
+#include "MainLoop.h"
+#include "Clock.h"
+
+MainLoop::MainLoop(IO *io, TimerWheel *timers, Scheduler *scheduler, MenuView *view)
+{
+    this->io = io;
+    this->timers = timers;
+    this->scheduler = scheduler;
+    this->view = view;
+    timeout = 0;
+    chosen = MAIN_LOOP_NO_ENTRY;
+}
+
+/**
+ * Lights the cabinet up so people know they can use the menu.
+ */
+void MainLoop::Start(unsigned long long now)
+{
+    lights.Play(&lightMenuBlink, now);
+    lights.Play(&lightMarqueeChase, now);
+    lights.Play(&lightPadSweep, now);
+    lights.Play(&lightNeonPulse, now);
+
+    timers->Add(now, AnimateLights, this);
+}
+
+unsigned long long MainLoop::AnimateLights(void *context, unsigned long long now)
+{
+    MainLoop *loop = (MainLoop *)context;
+    if (loop->lights.Update(now))
+    {
+        loop->io->SetLights(loop->lights.Lights());
+    }
+
+    /* Come back whenever the next keyframe or held back frame is due */
+    return loop->lights.NextDeadline();
+}
+
+/**
+ * Runs one tick, and returns false once the menu is done. Chosen() then
+ * says which entry to boot, if any.
+ */
+bool MainLoop::Tick()
+{
+    /* Read the clock once, everything this tick works from the same time */
+    unsigned long long now = ClockUpdate();
+    scheduler->BeginTick(now);
+    io->Tick();
+    timers->Advance(now);
+    view->Tick();
+
+    /* See if somebody killed the display window */
+    if (view->WasClosed())
+    {
+        return false;
+    }
+
+    /* Check to see if we ran out of time waiting for input, and to see
+       if the user confirmed a selection */
+    if (
+        view->ShouldBootDefault() ||
+        io->ButtonPressed(BUTTON_1P_START) ||
+        io->ButtonPressed(BUTTON_2P_START)
+    ) {
+        chosen = (int)view->GetSelectedItem();
+        return false;
+    }
+
+    /* Let an operator see how responsive the menu is */
+    if (io->ButtonPressed(BUTTON_TEST))
+    {
+        view->DumpStats(stderr);
+        io->DumpInputStats(stderr);
+    }
+
+    /* Send whatever lights changed this tick in one go */
+    io->CommitLights();
+
+    /* Sleep until the next tick or timer is due */
+    now = ClockMicroseconds();
+    scheduler->EndTick(now);
+    timeout = scheduler->MillisecondsUntilNextTick(now);
+    unsigned int timer = timers->MillisecondsUntilNext(now);
+    if (timer < timeout)
+    {
+        timeout = timer;
+    }
+
+    return true;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdio.h>
+
+#include "IO.h"
+#include "LightAnimator.h"
+#include "Scheduler.h"
+#include "TimerWheel.h"
+
+/* What Chosen() gives back when nothing was picked, such as the window closing */
+#define MAIN_LOOP_NO_ENTRY -1
+
+/**
+ * Whatever is showing the menu. The loop hands it a tick once input and
+ * timers have been dealt with, and asks it what is highlighted when it's
+ * time to boot something.
+ */
+class MenuView
+{
+public:
+    virtual ~MenuView() {}
+
+    /* Move the selection for this tick's input and redraw if needed */
+    virtual void Tick() = 0;
+
+    virtual bool WasClosed() = 0;
+    virtual bool ShouldBootDefault() = 0;
+    virtual unsigned int GetSelectedItem() = 0;
+
+    /* Called when an operator presses TEST, alongside the input stats */
+    virtual void DumpStats(FILE *fp) {}
+};
+
+/**
+ * Everything the menu does on a tick, short of waiting for the next one.
+ * The caller sleeps for MillisecondsUntilNext() between calls to Tick(),
+ * however suits it, and stops once Tick() returns false.
+ */
+class MainLoop
+{
+public:
+    MainLoop(IO *io, TimerWheel *timers, Scheduler *scheduler, MenuView *view);
+
+    void Start(unsigned long long now);
+    bool Tick();
+
+    unsigned int MillisecondsUntilNext() { return timeout; }
+    int Chosen() { return chosen; }
+    LightAnimator *Lights() { return &lights; }
+private:
+    IO *io;
+    TimerWheel *timers;
+    Scheduler *scheduler;
+    MenuView *view;
+
+    LightAnimator lights;
+    unsigned int timeout;
+    int chosen;
+
+    static unsigned long long AnimateLights(void *context, unsigned long long now);
+};
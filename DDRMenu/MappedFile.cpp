@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "MappedFile.h"
+
+MappedFile::MappedFile()
+{
+    data = NULL;
+    length = 0;
+    mapped = false;
+
+#ifdef _WIN32
+    file = INVALID_HANDLE_VALUE;
+    mapping = NULL;
+#else
+    file = -1;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+bool MappedFile::Open(const _TCHAR *path)
+{
+    Close();
+
+#ifdef _WIN32
+    file = CreateFile(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, 0);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.HighPart != 0)
+    {
+        Close();
+        return false;
+    }
+    length = size.LowPart;
+
+    /* Empty files can't be mapped, but there's nothing to read anyway */
+    if (length == 0)
+    {
+        return true;
+    }
+
+    mapping = CreateFileMapping(file, 0, PAGE_READONLY, 0, 0, 0);
+    if (mapping != NULL)
+    {
+        data = (const char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (data != NULL)
+        {
+            mapped = true;
+            return true;
+        }
+    }
+
+    /* Couldn't map it, so read the whole thing in one go instead */
+    char *buffer = (char *)malloc(length);
+    DWORD actual = 0;
+    if (buffer == NULL || !ReadFile(file, buffer, length, &actual, 0) || actual != length)
+    {
+        free(buffer);
+        Close();
+        return false;
+    }
+    data = buffer;
+    return true;
+#else
+    file = open(path, O_RDONLY);
+    if (file < 0)
+    {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(file, &info) != 0)
+    {
+        Close();
+        return false;
+    }
+    length = (unsigned int)info.st_size;
+
+    if (length == 0)
+    {
+        return true;
+    }
+
+    void *view = mmap(NULL, length, PROT_READ, MAP_PRIVATE, file, 0);
+    if (view != MAP_FAILED)
+    {
+        data = (const char *)view;
+        mapped = true;
+        return true;
+    }
+
+    char *buffer = (char *)malloc(length);
+    if (buffer == NULL || read(file, buffer, length) != (ssize_t)length)
+    {
+        free(buffer);
+        Close();
+        return false;
+    }
+    data = buffer;
+    return true;
+#endif
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+    if (mapped)
+    {
+        UnmapViewOfFile(data);
+    }
+    else
+    {
+        free((void *)data);
+    }
+
+    if (mapping != NULL)
+    {
+        CloseHandle(mapping);
+        mapping = NULL;
+    }
+    if (file != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(file);
+        file = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (mapped)
+    {
+        munmap((void *)data, length);
+    }
+    else
+    {
+        free((void *)data);
+    }
+
+    if (file >= 0)
+    {
+        close(file);
+        file = -1;
+    }
+#endif
+
+    data = NULL;
+    length = 0;
+    mapped = false;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#ifdef _WIN32
+#include <windows.h>
+#include <tchar.h>
+#else
+typedef char _TCHAR;
+#endif
+
+/**
+ * Read-only view of a whole file. Uses a memory mapping so there's no
+ * copying or per-byte syscalls, and falls back to one bulk read if the file
+ * can't be mapped.
+ */
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    bool Open(const _TCHAR *path);
+    void Close();
+
+    const char *Data() { return data; }
+    unsigned int Length() { return length; }
+private:
+    const char *data;
+    unsigned int length;
+    bool mapped;
+
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int file;
+#endif
+};
@@ -1,155 +1,628 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <windows.h>
 
 #include "Menu.h"
+#include "MappedFile.h"
+#include "CatalogCache.h"
+#include "Clock.h"
+#include "GameScanner.h"
+
+typedef struct
+{
+    catalog_fragment_t *fragments;
+    unsigned int count;
+    unsigned int capacity;
+} fragment_list_t;
+
+static bool IsDirectory(const _TCHAR *path)
+{
+    DWORD attributes = GetFileAttributes(path);
+    return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+}
+
+static void AddFragment(fragment_list_t *list, const _TCHAR *path, unsigned int pathlen)
+{
+    if (list->count == list->capacity)
+    {
+        list->capacity = list->capacity > 0 ? list->capacity * 2 : 8;
+        list->fragments = (catalog_fragment_t *)realloc(list->fragments, sizeof(catalog_fragment_t) * list->capacity);
+    }
+
+    catalog_fragment_t *fragment = &list->fragments[list->count++];
+    fragment->path = new _TCHAR[pathlen + 1];
+    memcpy(fragment->path, path, pathlen * sizeof(_TCHAR));
+    fragment->path[pathlen] = 0;
+    fragment->catalog = NULL;
+    fragment->loaded = false;
+    fragment->saveCache = true;
+    fragment->microseconds = 0;
+}
+
+static int CompareFragments(const void *a, const void *b)
+{
+    return _tcsicmp(((const catalog_fragment_t *)a)->path, ((const catalog_fragment_t *)b)->path);
+}
+
+/**
+ * Adds every INI file in a directory, in name order so the menu comes out
+ * the same no matter what order the file system lists them in.
+ */
+static void AddDirectory(fragment_list_t *list, const _TCHAR *directory)
+{
+    unsigned int dirlen = _tcslen(directory);
+    _TCHAR search[MAX_PATH];
+    if (dirlen + 7 > MAX_PATH)
+    {
+        return;
+    }
+    _tcscpy_s(search, MAX_PATH, directory);
+    _tcscat_s(search, MAX_PATH, _T("\\*.ini"));
+
+    WIN32_FIND_DATA found;
+    HANDLE find = FindFirstFile(search, &found);
+    if (find == INVALID_HANDLE_VALUE)
+    {
+        return;
+    }
+
+    unsigned int first = list->count;
+    do
+    {
+        /* Short names can make *.ini match longer extensions too */
+        unsigned int namelen = _tcslen(found.cFileName);
+        if ((found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0 ||
+            namelen < 4 || _tcsicmp(found.cFileName + namelen - 4, _T(".ini")) != 0)
+        {
+            continue;
+        }
+
+        _TCHAR path[MAX_PATH];
+        if (dirlen + namelen + 2 > MAX_PATH)
+        {
+            continue;
+        }
+        _tcscpy_s(path, MAX_PATH, directory);
+        _tcscat_s(path, MAX_PATH, _T("\\"));
+        _tcscat_s(path, MAX_PATH, found.cFileName);
+        AddFragment(list, path, _tcslen(path));
+    } while (FindNextFile(find, &found));
+    FindClose(find);
+
+    qsort(list->fragments + first, list->count - first, sizeof(catalog_fragment_t), CompareFragments);
+}
+
+/**
+ * Adds one included INI file or directory, relative to the including file
+ * unless it starts from the root of a drive.
+ */
+static void AddInclude(fragment_list_t *list, const _TCHAR *ini_file, unsigned int dirlen, const char *value, unsigned int valuelen)
+{
+    _TCHAR path[MAX_PATH];
+    unsigned int pathlen = 0;
+    bool relative = !(value[0] == '\\' || value[0] == '/' || (valuelen > 1 && value[1] == ':'));
+    if (relative && dirlen < MAX_PATH)
+    {
+        memcpy(path, ini_file, dirlen * sizeof(_TCHAR));
+        pathlen = dirlen;
+    }
+
+    int converted = MultiByteToWideChar(CP_ACP, 0, value, valuelen, path + pathlen, MAX_PATH - pathlen - 1);
+    if (converted <= 0)
+    {
+        return;
+    }
+
+    pathlen += converted;
+    path[pathlen] = 0;
+    if (IsDirectory(path))
+    {
+        AddDirectory(list, path);
+    }
+    else
+    {
+        AddFragment(list, path, pathlen);
+    }
+}
+
+/**
+ * Checks a line for a key, giving where its value starts if it has one.
+ */
+static bool HeaderValue(const char *line, unsigned int buflen, const char *key, unsigned int *loc)
+{
+    unsigned int keylen = strlen(key);
+    if (buflen < keylen || strncmp(line, key, keylen) != 0)
+    {
+        return false;
+    }
+
+    *loc = keylen;
+    while (*loc < buflen && (line[*loc] == ' ' || line[*loc] == '\t')) { (*loc)++; }
+    if (*loc >= buflen || line[*loc] != '=')
+    {
+        return false;
+    }
+
+    (*loc)++;
+    while (*loc < buflen && (line[*loc] == ' ' || line[*loc] == '\t')) { (*loc)++; }
+    return *loc < buflen;
+}
+
+/**
+ * Reads the settings from lines outside of any game, at the top of an INI
+ * file, which look like:
+ *
+ * include=<INI file, or directory of them>
+ * discover=<directory with a game installed in each directory under it>
+ *
+ * Relative includes are relative to the INI file. Only the top INI file is
+ * looked at, fragments can't include any further.
+ */
+static void ReadHeader(fragment_list_t *list, GameScanner *scanner, const _TCHAR *ini_file)
+{
+    MappedFile file;
+    if (!file.Open(ini_file))
+    {
+        return;
+    }
+
+    /* Where relative includes start from */
+    const _TCHAR *slash = _tcsrchr(ini_file, '\\');
+    unsigned int dirlen = slash != NULL ? (unsigned int)(slash - ini_file) + 1 : 0;
+
+    const char *data = file.Data();
+    const char *end = data + file.Length();
+    const char *line = data;
+    bool inSection = false;
+    unsigned int loc;
+
+    while (line < end)
+    {
+        const char *eol = (const char *)memchr(line, '\n', end - line);
+        if (eol == NULL)
+        {
+            eol = end;
+        }
+
+        unsigned int buflen = (unsigned int)(eol - line);
+        while (buflen > 0 && line[buflen - 1] == '\r')
+        {
+            buflen--;
+        }
+
+        if (buflen > 2 && line[0] == '[' && line[buflen - 1] == ']')
+        {
+            inSection = true;
+        }
+        else if (!inSection && HeaderValue(line, buflen, "include", &loc))
+        {
+            AddInclude(list, ini_file, dirlen, line + loc, buflen - loc);
+        }
+        else if (!inSection && HeaderValue(line, buflen, "discover", &loc))
+        {
+            scanner->AddRoot(line + loc, buflen - loc);
+        }
+
+        line = eol + 1;
+    }
+}
 
 Menu::Menu(_TCHAR *inifile)
 {
     /* Read settings */
-    settings = LoadSettings( inifile, &num_programs );
+    catalog = new Catalog();
+    LoadCatalog( catalog, inifile, true );
+
+    /* Names are in order so searching never looks at the whole catalog. A
+       catalog from a cache image was saved that way, so this doesn't sort. */
+    index = new PrefixIndex();
+    index->Build(catalog);
+    generation = 0;
+    remap = NULL;
+    validator = NULL;
 
-    /* For exiting on defaults */
-    ftime(&beginning);
+    /* Pick up edits to the INI while the menu is up */
+    unsigned int pathlen = _tcslen(inifile) + 1;
+    inipath = new _TCHAR[pathlen];
+    _tcscpy_s(inipath, pathlen, inifile);
+
+    watchCatalog = catalog;
+    watchIndex = index;
+    watchGeneration = 0;
+    reloadReady = 0;
+    pendingCatalog = NULL;
+    pendingIndex = NULL;
+    pendingRemap = NULL;
+    pendingBase = 0;
+    if (IsDirectory(inipath))
+    {
+        /* Any fragment in the directory counts */
+        unsigned int patternlen = pathlen + 6;
+        _TCHAR *pattern = new _TCHAR[patternlen];
+        _tcscpy_s(pattern, patternlen, inipath);
+        _tcscat_s(pattern, patternlen, _T("\\*.ini"));
+        watcher.Watch(pattern, IniChanged, this);
+        delete[] pattern;
+    }
+    else
+    {
+        watcher.Watch(inipath, IniChanged, this);
+    }
+
+    /* For exiting on defaults, once somebody starts the clock */
+    timers = NULL;
+    timer = -1;
+    expired = false;
+    deadline = ClockNow() + TIMEOUT_SECONDS * 1000000ULL;
 }
 
 Menu::~Menu()
 {
+    watcher.Stop();
+
+    /* One stuck on a dead disk is left for the process exiting to clean up */
+    if (validator != NULL && validator->Stop(VALIDATE_STOP_MS))
+    {
+        delete validator;
+    }
+
+    if (timers != NULL)
+    {
+        timers->Cancel(timer);
+    }
+
+    delete pendingIndex;
+    delete pendingCatalog;
+    free(pendingRemap);
+    free(remap);
+    delete index;
+    delete catalog;
+    delete[] inipath;
+}
+
+void Menu::StartTimeout(TimerWheel *wheel)
+{
+    timers = wheel;
+    ResetTimeout();
 }
 
 void Menu::ResetTimeout()
 {
-    ftime(&beginning);
+    deadline = ClockNow() + TIMEOUT_SECONDS * 1000000ULL;
+    expired = false;
+
+    if (timers == NULL)
+    {
+        return;
+    }
+    if (timer < 0)
+    {
+        timer = timers->Add(deadline, TimeoutExpired, this);
+    }
+    else
+    {
+        timers->Reschedule(timer, deadline);
+    }
 }
 
-void Menu::Tick()
+unsigned long long Menu::TimeoutExpired(void *context, unsigned long long now)
 {
-    ftime(&current);
+    Menu *menu = (Menu *)context;
+    menu->expired = true;
+    menu->timer = -1;
+    return 0;
 }
 
 bool Menu::ShouldBootDefault()
 {
-    ftime(&current);
-    return (current.time - beginning.time) > TIMEOUT_SECONDS;
+    return expired;
 }
 
 unsigned int Menu::SecondsLeft()
 {
-    ftime(&current);
-    int seconds = (int)(TIMEOUT_SECONDS - (current.time - beginning.time));
-    return seconds >= 0 ? seconds : 0;
+    return (MillisecondsLeft() + 999) / 1000;
+}
+
+unsigned int Menu::MillisecondsLeft()
+{
+    unsigned long long now = ClockNow();
+    return deadline > now ? (unsigned int)((deadline - now) / 1000) : 0;
 }
 
 /**
-* Loads an INI file with the following format:
-*
-* [Name of game to launch]
-* launch=<location of batch/executable>
-*/
-launcher_program_t *Menu::LoadSettings( _TCHAR *ini_file, unsigned int *final_length )
+ * Runs on the watcher's thread whenever the INI has been saved. Everything
+ * slow happens here, reading and parsing the file, sorting it and diffing it
+ * against the last one, so the main thread only has to swap pointers.
+ */
+void Menu::IniChanged(void *context)
+{
+    Menu *menu = (Menu *)context;
+    unsigned long long start = ClockMicroseconds();
+
+    /* Half written or emptied out files are ignored until they're saved again.
+       The catalog on screen may still be using the cache image, which Windows
+       won't let us replace while it's open, so caches are left for next boot. */
+    Catalog *fresh = new Catalog();
+    if (!LoadCatalog(fresh, menu->inipath, false) || fresh->Count() < 1)
+    {
+        fprintf(stderr, "Ignoring unusable change to the INI file!\n");
+        delete fresh;
+        return;
+    }
+
+    PrefixIndex *freshIndex = new PrefixIndex();
+    freshIndex->Build(fresh);
+
+    unsigned int count = menu->watchCatalog->Count();
+    unsigned int *freshRemap = (unsigned int *)malloc(sizeof(unsigned int) * count);
+    menu->watchIndex->Map(freshIndex, freshRemap);
+
+    /* Anything the main thread never got round to is superseded by this */
+    menu->reloadLock.Lock();
+    Catalog *staleCatalog = menu->pendingCatalog;
+    PrefixIndex *staleIndex = menu->pendingIndex;
+    unsigned int *staleRemap = menu->pendingRemap;
+    menu->pendingCatalog = fresh;
+    menu->pendingIndex = freshIndex;
+    menu->pendingRemap = freshRemap;
+    menu->pendingBase = menu->watchGeneration;
+    AtomicStore(&menu->reloadReady, 1);
+    menu->reloadLock.Unlock();
+
+    delete staleIndex;
+    delete staleCatalog;
+    free(staleRemap);
+
+    menu->watchCatalog = fresh;
+    menu->watchIndex = freshIndex;
+    menu->watchGeneration++;
+
+    fprintf(
+        stderr,
+        "Reloaded %u games from the INI file in %llu us\n",
+        fresh->Count(),
+        ClockMicroseconds() - start
+    );
+}
+
+/**
+ * Swaps in the catalog the watcher loaded last. The old catalog is gone
+ * once this returns, so remap says where each of its entries went, by the
+ * old entry number, with INDEX_NO_ENTRY for entries that were removed.
+ */
+bool Menu::Reload(const unsigned int **newRemap, unsigned int *oldCount)
 {
-    launcher_program_t *progs = 0;
-    *final_length = 0;
-    unsigned int got_name = 0;
-    launcher_program_t temp;
+    reloadLock.Lock();
+    Catalog *fresh = pendingCatalog;
+    PrefixIndex *freshIndex = pendingIndex;
+    unsigned int *freshRemap = pendingRemap;
+    unsigned int base = pendingBase;
+    pendingCatalog = NULL;
+    pendingIndex = NULL;
+    pendingRemap = NULL;
+    AtomicStore(&reloadReady, 0);
+    reloadLock.Unlock();
 
-    // Open the file
-    HANDLE hFile = CreateFile(ini_file, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
-    char buffer[16384];
-    unsigned int eof = 0;
-    unsigned int eol = 0;
-    unsigned int buflen = 0;
+    if (fresh == NULL)
+    {
+        return false;
+    }
 
-    if (hFile == 0)
+    /* The watcher diffed against a reload we skipped, so diff against ours.
+       Both are sorted already, so this is only a walk over the two. */
+    if (base != generation)
     {
-        return progs;
+        freshRemap = (unsigned int *)realloc(freshRemap, sizeof(unsigned int) * catalog->Count());
+        index->Map(freshIndex, freshRemap);
     }
 
-    memset( &temp, 0, sizeof(temp) );
-    memset( buffer, 0, sizeof(buffer) );
+    *oldCount = catalog->Count();
+    delete index;
+    delete catalog;
+    free(remap);
+
+    catalog = fresh;
+    index = freshIndex;
+    remap = freshRemap;
+    generation = base + 1;
 
-    while( !eof )
+    /* Whatever was being checked belonged to the old catalog */
+    if (validator != NULL)
     {
-        DWORD length;
-        ReadFile( hFile, buffer + buflen, 1, &length, 0 );
-        if (length == 0)
-        {
-            eof = 1;
-            eol = 1;
-        }
-        else if( *(buffer + buflen) == '\r' )
-        {
-            /* Ignore \r completely */
-            *(buffer + buflen) = 0;
-        }
-        else if( *(buffer + buflen) == '\n' )
+        validator->Validate(catalog);
+    }
+
+    *newRemap = remap;
+    return true;
+}
+
+/**
+ * Starts checking every game's launch target in the background. Meant for
+ * once the menu is up, so the checks don't compete with it for the disk.
+ */
+void Menu::StartValidation()
+{
+    if (validator == NULL)
+    {
+        validator = new LaunchValidator();
+        validator->Validate(catalog);
+    }
+}
+
+void Menu::DumpValidation(FILE *fp)
+{
+    if (validator != NULL)
+    {
+        validator->Dump(fp);
+    }
+}
+
+/**
+ * Loads a catalog from an INI file, along with anything it includes, or
+ * from every INI file in a directory. With more than one fragment they are
+ * loaded side by side, then put together in order, so the menu looks the
+ * same however long each one took. Games found under any roots the INI file
+ * asks to discover from come last. Without saveCache no cache image is
+ * written, for when one might still be in use.
+ */
+bool Menu::LoadCatalog( Catalog *catalog, const _TCHAR *path, bool saveCache )
+{
+    fragment_list_t list = { NULL, 0, 0 };
+    GameScanner scanner;
+    if (IsDirectory(path))
+    {
+        AddDirectory(&list, path);
+    }
+    else
+    {
+        AddFragment(&list, path, _tcslen(path));
+        ReadHeader(&list, &scanner, path);
+    }
+
+    /* Plain single INI, which can be used straight from its cache image */
+    if (list.count == 1 && _tcscmp(list.fragments[0].path, path) == 0 && scanner.Roots() == 0)
+    {
+        delete[] list.fragments[0].path;
+        free(list.fragments);
+        return LoadSettings(catalog, path, saveCache);
+    }
+
+    for (unsigned int i = 0; i < list.count; i++)
+    {
+        list.fragments[i].saveCache = saveCache;
+    }
+    ParallelFor(list.count, CATALOG_LOAD_THREADS, LoadFragment, list.fragments);
+
+    bool loaded = false;
+    for (unsigned int i = 0; i < list.count; i++)
+    {
+        catalog_fragment_t *fragment = &list.fragments[i];
+        if (fragment->loaded)
         {
-            /* End of line */
-            *(buffer + buflen) = 0;
-            eol = 1;
+            Catalog *part = fragment->catalog;
+            for (unsigned int entry = 0; entry < part->Count(); entry++)
+            {
+                const char *name = part->GetName(entry);
+                const char *location = part->GetLocation(entry);
+                catalog->Add(name, strlen(name), location, strlen(location));
+            }
+            loaded = true;
+
+            fprintf(stderr, "Loaded %u games from %ls in %llu us\n", part->Count(), fragment->path, fragment->microseconds);
         }
         else
         {
-            /* Valid thing */
-            buflen++;
+            fprintf(stderr, "Failed to load %ls after %llu us!\n", fragment->path, fragment->microseconds);
         }
 
-        if ( eol == 1 )
-        {
-            /* Process line */
-            if (buffer[0] == '[' && buffer[buflen - 1] == ']' && buflen > 2)
-            {
-                buffer[buflen - 1] = 0;
-                char *game = buffer + 1;
+        delete fragment->catalog;
+        delete[] fragment->path;
+    }
+    free(list.fragments);
 
-                /* Copy this into temp structure */
-                strcpy_s( temp.name, MAX_GAME_NAME_LENGTH, game );
-                got_name = 1;
-            }
-            else
-            {
-                if (strncmp(buffer, "launch", 6) == 0) {
-                    unsigned int loc = 6;
-                    // Find equals sign after space
-                    while (loc < buflen && (buffer[loc] == ' ' || buffer[loc] == '\t')) { loc++; }
-                    if (loc < buflen)
-                    {
-                        if (buffer[loc] == '=')
-                        {
-                            loc++;
-                            while (loc < buflen && (buffer[loc] == ' ' || buffer[loc] == '\t')) { loc++; }
-                            if (loc < buflen)
-                            {
-                                char *launch = buffer + loc;
-
-                                if( got_name == 1 )
-                                {
-                                    /* We have a name to associate with this */
-                                    strcpy_s( temp.location, MAX_GAME_LOCATION_LENGTH, launch );
-                                    got_name = 0;
-
-                                    /* Make a new spot for this, copy in */
-                                    (*final_length)++;
-                                    progs = (launcher_program_t *)realloc( progs, sizeof(launcher_program_t) * (*final_length) );
-                                    memcpy( progs + ((*final_length) - 1), &temp, sizeof(launcher_program_t) );
-                                    memset( &temp, 0, sizeof(temp) );
-                                }
-                            }
-                        }
-                    }
-                }
-            }
+    /* Scan results are kept next to the INI, so boots only look at what changed */
+    if (scanner.Roots() > 0)
+    {
+        unsigned int cachelen = _tcslen(path) + 6;
+        _TCHAR *cache_file = new _TCHAR[cachelen];
+        _tcscpy_s(cache_file, cachelen, path);
+        _tcscat_s(cache_file, cachelen, _T(".scan"));
 
-            /* Reset buffer */
-            if (buflen > 0)
-            {
-                memset( buffer, 0, sizeof(buffer) );
-                buflen = 0;
-            }
+        scanner.Scan(cache_file);
+        scanner.AddTo(catalog);
+        loaded = loaded || catalog->Count() > 0;
+
+        delete[] cache_file;
+    }
+
+    return loaded;
+}
 
-            /* Not end of line anymore */
-            eol = 0;
+void Menu::LoadFragment( void *context, unsigned int item )
+{
+    catalog_fragment_t *fragment = &((catalog_fragment_t *)context)[item];
+    unsigned long long start = ClockMicroseconds();
+
+    fragment->catalog = new Catalog();
+    fragment->loaded = LoadSettings(fragment->catalog, fragment->path, fragment->saveCache);
+    fragment->microseconds = ClockMicroseconds() - start;
+}
+
+/**
+* Loads an INI file with the following format:
+*
+* [Name of game to launch]
+* launch=<location of batch/executable>
+*
+* A binary image of the parsed result is kept next to the INI, so as long as
+* the INI hasn't changed we can skip reading and parsing it entirely.
+* Without saveCache the image is only read, never rewritten.
+*/
+bool Menu::LoadSettings( Catalog *catalog, const _TCHAR *ini_file, bool saveCache )
+{
+    unsigned int cachelen = _tcslen(ini_file) + 7;
+    _TCHAR *cache_file = new _TCHAR[cachelen];
+    _tcscpy_s(cache_file, cachelen, ini_file);
+    _tcscat_s(cache_file, cachelen, _T(".cache"));
+
+    // If the INI is exactly as it was when the cache was built, use it as-is
+    catalog_source_t source;
+    bool have_source = CatalogSourceInfo(ini_file, &source);
+    MappedFile *image = CatalogCacheOpen(cache_file);
+    if (image != NULL && have_source && CatalogCacheMatches(image, &source, false))
+    {
+        CatalogCacheAdopt(catalog, image);
+        delete[] cache_file;
+        return true;
+    }
+
+    // Map the whole file in so we can check its contents
+    MappedFile file;
+    if (!file.Open(ini_file))
+    {
+        delete image;
+        delete[] cache_file;
+        return false;
+    }
+
+    if (!have_source)
+    {
+        source.modified = 0;
+    }
+    source.size = file.Length();
+    source.hash = CatalogHash(file.Data(), file.Length());
+
+    // Touched but not edited, so the cache is still good once we record the new time
+    if (image != NULL && CatalogCacheMatches(image, &source, true))
+    {
+        if (!saveCache)
+        {
+            CatalogCacheAdopt(catalog, image);
+            delete[] cache_file;
+            return true;
+        }
+
+        delete image;
+        CatalogCacheTouch(cache_file, &source);
+
+        image = CatalogCacheOpen(cache_file);
+        if (image != NULL)
+        {
+            CatalogCacheAdopt(catalog, image);
+            delete[] cache_file;
+            return true;
         }
     }
+    delete image;
+
+    // Parse it in one go, and save the result for next time
+    catalog->Parse(file.Data(), file.Length());
+    if (saveCache)
+    {
+        CatalogCacheSave(catalog, cache_file, &source);
+    }
 
-    return progs;
+    delete[] cache_file;
+    return true;
 }
@@ -1,20 +1,30 @@
 #pragma once
 
 #include <tchar.h>
-#include <sys/timeb.h>
+
+#include "Catalog.h"
+#include "FileWatcher.h"
+#include "LaunchValidator.h"
+#include "PrefixIndex.h"
+#include "Thread.h"
+#include "TimerWheel.h"
 
 /* Seconds to wait for a selection before booting the default option */
 #define TIMEOUT_SECONDS       30
 
-/* Constants for limitations on how long INI file pieces can be */
-#define MAX_GAME_NAME_LENGTH 63
-#define MAX_GAME_LOCATION_LENGTH 511
+/* Catalog fragments are loaded this many at a time, any more just fight
+   over the disk */
+#define CATALOG_LOAD_THREADS  4
 
+/* One fragment of a catalog spread over several INI files */
 typedef struct
 {
-    char location[MAX_GAME_LOCATION_LENGTH + 1];
-    char name[MAX_GAME_NAME_LENGTH + 1];
-} launcher_program_t;
+    _TCHAR *path;
+    Catalog *catalog;
+    bool loaded;
+    bool saveCache;
+    unsigned long long microseconds;
+} catalog_fragment_t;
 
 class Menu
 {
@@ -22,19 +32,57 @@ public:
     Menu(_TCHAR *inifile);
     ~Menu();
 
-    unsigned int NumberOfEntries() { return num_programs; }
-    char *GetEntryName(unsigned int game) { return settings[game].name; }
-    char *GetEntryPath(unsigned int game) { return settings[game].location; }
+    unsigned int NumberOfEntries() { return catalog->Count(); }
+    const char *GetEntryName(unsigned int game) { return catalog->GetName(game); }
+    const char *GetEntryPath(unsigned int game) { return catalog->GetLocation(game); }
+    PrefixIndex *GetIndex() { return index; }
 
-    void Tick();
+    void StartTimeout(TimerWheel *wheel);
     void ResetTimeout();
     bool ShouldBootDefault();
     unsigned int SecondsLeft();
+    unsigned int MillisecondsLeft();
+
+    bool ReloadPending() { return AtomicLoad(&reloadReady) != 0; }
+    bool Reload(const unsigned int **remap, unsigned int *oldCount);
+    unsigned int Generation() { return generation; }
+
+    void StartValidation();
+    unsigned int EntryStatus(unsigned int game) { return validator != NULL ? validator->Status(game) : VALIDATE_UNKNOWN; }
+    unsigned int ValidationProgress() { return validator != NULL ? validator->Progress() : 0; }
+    void DumpValidation(FILE *fp);
 private:
-    unsigned int num_programs;
-    launcher_program_t *settings;
-    struct timeb beginning;
-    struct timeb current;
+    Catalog *catalog;
+    PrefixIndex *index;
+    unsigned int generation;
+    unsigned int *remap;
+    LaunchValidator *validator;
+    TimerWheel *timers;
+    int timer;
+    unsigned long long deadline;
+    bool expired;
+
+    static unsigned long long TimeoutExpired(void *context, unsigned long long now);
+
+    /* Reloads happen on the watcher's thread, which keeps its own idea of
+       the latest catalog so it can work out what changed since */
+    _TCHAR *inipath;
+    FileWatcher watcher;
+    Catalog *watchCatalog;
+    PrefixIndex *watchIndex;
+    unsigned int watchGeneration;
+
+    /* A reload waiting for the main thread to pick it up */
+    Mutex reloadLock;
+    volatile long reloadReady;
+    Catalog *pendingCatalog;
+    PrefixIndex *pendingIndex;
+    unsigned int *pendingRemap;
+    unsigned int pendingBase;
+
+    static void IniChanged(void *context);
 
-    launcher_program_t *LoadSettings( _TCHAR *ini_file, unsigned int *final_length );
+    static bool LoadCatalog( Catalog *catalog, const _TCHAR *path, bool saveCache );
+    static void LoadFragment( void *context, unsigned int item );
+    static bool LoadSettings( Catalog *catalog, const _TCHAR *ini_file, bool saveCache );
 };
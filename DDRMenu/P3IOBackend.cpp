@@ -0,0 +1,625 @@
+#include <stdio.h>
+#include <string.h>
+#include <windows.h>
+#include <setupapi.h>
+#include <initguid.h>
+
+#include "IO.h"
+#include "Clock.h"
+#include "P3IOBackend.h"
+#include "P3IOButtons.h"
+
+/* P3IO GUID as reversed out of a ddr.dll */
+DEFINE_GUID(P3IO_GUID, 0x1FA4A480, 0xAC60, 0x40C7, 0xA7, 0xAC, 0x52, 0x79, 0x0F, 0x34, 0x57, 0x5A);
+
+/* How many partial reads we will stitch together before giving up on a response */
+#define P3IO_MAX_READS 4
+
+/* How long we will wait on the last light frame to reach the EXTIO when closing */
+#define EXTIO_DRAIN_TIMEOUT_MS 100
+
+P3IOBackend::P3IOBackend()
+{
+    /* Start with not being ready */
+    is_ready = false;
+    extio = INVALID_HANDLE_VALUE;
+    extioWriting = false;
+    extioReading = false;
+    memset(&extioWrite, 0, sizeof(extioWrite));
+    memset(&extioRead, 0, sizeof(extioRead));
+
+    /* Try to find and initialize the P3IO */
+    wchar_t filename[256];
+    if (!GetDevicePath(filename, 256))
+    {
+        return;
+    }
+
+    /* Now, open the file */
+    p3io = CreateFileW(filename, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, 0, OPEN_EXISTING, 0, 0);
+    if (p3io == INVALID_HANDLE_VALUE)
+    {
+        /* Failed to get interface detail */
+        fprintf(stderr, "Failed to open P3IO!\n");
+        return;
+    }
+
+    /* Give the input poller its own handle so it doesn't queue up behind
+       light updates. If the driver won't allow that, share ours. */
+    pollio = CreateFileW(filename, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, 0, OPEN_EXISTING, 0, 0);
+    if (pollio == INVALID_HANDLE_VALUE)
+    {
+        pollio = p3io;
+    }
+
+    /* Now, optionally initialize the EXTIO. This gets us control over
+       the foot panel lights and bass neons. */
+    extio = CreateFileA("COM1", GENERIC_READ | GENERIC_WRITE, 0, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, 0);
+    if (extio != INVALID_HANDLE_VALUE)
+    {
+        /* Set up standard params based on game DLL */
+        DCB params = {0};
+        params.DCBlength = sizeof(params);
+        params.BaudRate = CBR_38400;
+        params.ByteSize = 8;
+        params.StopBits = ONESTOPBIT;
+        params.Parity = NOPARITY;
+
+        /* Copypasta that works */
+        params.fOutxCtsFlow = 0;
+        params.fOutxDsrFlow = 0;
+        params.fDtrControl = DTR_CONTROL_DISABLE;
+        params.fDsrSensitivity = 0;
+        params.fOutX = 0;
+        params.fInX = 0;
+        params.fRtsControl = RTS_CONTROL_DISABLE;
+
+        /* Set up the COM1 params */
+        SetCommState(extio, &params);
+
+        /* Reads return straight away with whatever acks have arrived */
+        COMMTIMEOUTS timeouts = { 0 };
+        timeouts.ReadTotalTimeoutConstant = 0;
+        timeouts.WriteTotalTimeoutConstant = 0;
+        timeouts.ReadIntervalTimeout = MAXDWORD;
+        timeouts.ReadTotalTimeoutMultiplier = 0;
+        timeouts.WriteTotalTimeoutMultiplier = 100;
+
+        /* Set up read timeouts */
+        SetCommTimeouts(extio, &timeouts);
+
+        /* Start fresh */
+        PurgeComm( extio, PURGE_RXABORT | PURGE_RXCLEAR | PURGE_TXABORT | PURGE_TXCLEAR );
+
+        extioWrite.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+        extioRead.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    }
+
+    /* Looks good! */
+    is_ready = true;
+    cabtype = CABINET_UNKNOWN;
+    coinstock.slot1 = 0;
+    coinstock.slot2 = 0;
+
+    /* Now, perform init sequence. None of these depend on an earlier response,
+       so queue them all up and pay for a single round trip. */
+    GetVersion();
+    SetMode();
+    GetCabType(1);
+    GetCoinstock();
+    GetCabType(0);
+    FlushP3IO();
+}
+
+P3IOBackend::~P3IOBackend()
+{
+    if (!is_ready) { return; }
+
+    // Kill the handle to the extio, once the last light frame is out
+    if (extio != INVALID_HANDLE_VALUE)
+    {
+        DrainEXTIO();
+        link.Dump(stderr);
+
+        CancelIo(extio);
+        CloseHandle(extio);
+        CloseHandle(extioWrite.hEvent);
+        CloseHandle(extioRead.hEvent);
+    }
+
+    if (queue.Unmatched() > 0)
+    {
+        fprintf(stderr, "Dropped %u responses from P3IO that matched no request\n", queue.Unmatched());
+    }
+
+    // Kill the handle to the file that we have
+    if (pollio != p3io)
+    {
+        CloseHandle(pollio);
+    }
+    CloseHandle(p3io);
+    is_ready = false;
+}
+
+bool P3IOBackend::Ready()
+{
+    return is_ready;
+}
+
+bool P3IOBackend::GetDevicePath(wchar_t *filename, unsigned int length)
+{
+    HDEVINFO devinfo = SetupDiGetClassDevsW(&P3IO_GUID, 0, 0, DIGCF_DEVICEINTERFACE | DIGCF_PRESENT);
+    if (devinfo == (HDEVINFO)-1)
+    {
+        /* Failed to grab initial handle */
+        fprintf(stderr, "Failed to gather P3IO devices!\n");
+        return false;
+    }
+
+    SP_DEVICE_INTERFACE_DATA deviceInfoData;
+    deviceInfoData.cbSize = sizeof(deviceInfoData);
+    if( !SetupDiEnumDeviceInterfaces(devinfo, 0, &P3IO_GUID, 0, &deviceInfoData) )
+    {
+        /* Failed to enumerate interfaces */
+        fprintf(stderr, "Failed to enumerate P3IO devices!\n");
+        SetupDiDestroyDeviceInfoList(devinfo);
+        return false;
+    }
+
+    DWORD requiredSize;
+    SetupDiGetDeviceInterfaceDetailW(devinfo, &deviceInfoData, 0, 0, &requiredSize, 0);
+    SP_DEVICE_INTERFACE_DETAIL_DATA *detailData = (SP_DEVICE_INTERFACE_DETAIL_DATA*)malloc(requiredSize);
+    detailData->cbSize = sizeof(SP_DEVICE_INTERFACE_DETAIL_DATA);
+
+    if( !SetupDiGetDeviceInterfaceDetailW(devinfo, &deviceInfoData, detailData, requiredSize, 0, 0) )
+    {
+        /* Failed to get interface detail */
+        fprintf(stderr, "Failed to get interface details!\n");
+        free(detailData);
+        SetupDiDestroyDeviceInfoList(devinfo);
+        return false;
+    }
+
+    /* Create filename so we can open the P3IO */
+    wcscpy_s(filename, length, detailData->DevicePath);
+    wcscat_s(filename, length, L"\\p3io");
+
+    free(detailData);
+    SetupDiDestroyDeviceInfoList(devinfo);
+    return true;
+}
+
+/**
+ * Checks whether the game would be able to open the P3IO and EXTIO right
+ * now, by briefly opening them without sharing. Handles are closed as soon
+ * as we're done with them, but the driver may take a moment to notice.
+ */
+bool P3IOBackend::Released()
+{
+    wchar_t filename[256];
+    if (GetDevicePath(filename, 256))
+    {
+        HANDLE device = CreateFileW(filename, GENERIC_READ | GENERIC_WRITE, 0, 0, OPEN_EXISTING, 0, 0);
+        if (device == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+        CloseHandle(device);
+    }
+
+    /* No EXTIO at all is as good as a released one */
+    HANDLE port = CreateFileA("COM1", GENERIC_READ | GENERIC_WRITE, 0, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if (port == INVALID_HANDLE_VALUE)
+    {
+        return GetLastError() == ERROR_FILE_NOT_FOUND;
+    }
+    CloseHandle(port);
+
+    return true;
+}
+
+void P3IOBackend::GetVersion()
+{
+    unsigned char outbuf[1] = { 0x01 };
+    SubmitP3IO(outbuf, 1, VersionResponse);
+}
+
+void P3IOBackend::VersionResponse(void *context, const unsigned char *inbuf, unsigned int actual)
+{
+    // Don't need to do anything with the version response. On actual
+    // cabinets, this is 8 bytes long and looks similar to this response:
+    // 0x01 0x47 0x33 0x32 0x00 0x02 0x02 0x06
+    if (actual == 0)
+    {
+        fprintf(stderr, "Got unexpected size %d back from version get request!\n", actual);
+    }
+    else if (inbuf[0] != 0x01)
+    {
+        fprintf(stderr, "Got unexpected response from version get request!\n");
+    }
+}
+
+void P3IOBackend::SetMode()
+{
+    unsigned char outbuf[1] = { 0x2F };
+    SubmitP3IO(outbuf, 1, ModeResponse);
+}
+
+void P3IOBackend::ModeResponse(void *context, const unsigned char *inbuf, unsigned int actual)
+{
+    // Don't care about response, only log if we got incorrect mode length.
+    // On actual cabinets this is 2 bytes long and looks similar to this:
+    // 0x2F 0x00
+    if (actual != 2)
+    {
+        fprintf(stderr, "Got unexpected size %d back from mode set request!\n", actual);
+    }
+    else if (inbuf[0] != 0x2F)
+    {
+        fprintf(stderr, "Got unexpected response from mode set request!\n");
+    }
+}
+
+void P3IOBackend::GetCabType(unsigned int request)
+{
+    unsigned char outbuf[2] = { 0x27, request };
+    SubmitP3IO(outbuf, 2, CabTypeResponse);
+}
+
+void P3IOBackend::CabTypeResponse(void *context, const unsigned char *inbuf, unsigned int actual)
+{
+    P3IOBackend *io = (P3IOBackend *)context;
+
+    if (actual == 2)
+    {
+        if (inbuf[0] != 0x27)
+        {
+            fprintf(stderr, "Got unexpected response from cab type get request!\n");
+            io->cabtype = CABINET_UNKNOWN;
+        }
+        else
+        {
+            io->cabtype = inbuf[1];
+        }
+    }
+    else
+    {
+        fprintf(stderr, "Got unexpected size %d back from cab type get request!\n", actual);
+        io->cabtype = CABINET_UNKNOWN;
+    }
+}
+
+void P3IOBackend::SetCabLights(unsigned int cablights)
+{
+    unsigned char outbuf[6] = { 0x24, 0xFF, cablights & 0xFF, (cablights >> 8) & 0xFF, (cablights >> 16) & 0xFF, (cablights >> 24) & 0xFF };
+    unsigned char inbuf[3] = { 0x00 };
+    unsigned int actual = ExchangeP3IO(outbuf, 6, inbuf, 3);
+
+    if (actual == 3)
+    {
+        if (inbuf[0] != outbuf[0])
+        {
+            fprintf(stderr, "Got unexpected response from lights set request!\n");
+        }
+    }
+    else
+    {
+        fprintf(stderr, "Got unexpected size %d back from lights set request!\n", actual);
+    }
+}
+
+void P3IOBackend::SetPadLights(unsigned int padlights)
+{
+    /* If the EXTIO isn't initialized, don't bother */
+    if (!is_ready || extio == INVALID_HANDLE_VALUE)
+    {
+        return;
+    }
+
+    link.Submit(padlights);
+    ServiceEXTIO();
+}
+
+void P3IOBackend::Service()
+{
+    if (!is_ready || extio == INVALID_HANDLE_VALUE)
+    {
+        return;
+    }
+
+    ServiceEXTIO();
+}
+
+void P3IOBackend::GetCoinstock()
+{
+    unsigned char outbuf[1] = { 0x31 };
+    SubmitP3IO(outbuf, 1, CoinstockResponse);
+}
+
+void P3IOBackend::CoinstockResponse(void *context, const unsigned char *inbuf, unsigned int actual)
+{
+    P3IOBackend *io = (P3IOBackend *)context;
+    io->coinstock.slot1 = 0;
+    io->coinstock.slot2 = 0;
+
+    /* The game checks to make sure that byte 1 is zero */
+    if (actual == 6)
+    {
+        if (inbuf[0] == 0x31 && inbuf[1] == 0)
+        {
+            /* From game RE, it looks like bytes 2-3, and bytes 4-5 are the 1P and 2P coinstock */
+            io->coinstock.slot1 = inbuf[2] << 8 | inbuf[3];
+            io->coinstock.slot2 = inbuf[4] << 8 | inbuf[5];
+        }
+        else
+        {
+            fprintf(
+                stderr,
+                "Got unexpected data %02X %02X %02X %02X %02X %02X back from coinstock get request!\n",
+                inbuf[0],
+                inbuf[1],
+                inbuf[2],
+                inbuf[3],
+                inbuf[4],
+                inbuf[5]
+            );
+        }
+    }
+    else
+    {
+        fprintf(stderr, "Got unexpected size %d back from coinstock get request!\n", actual);
+    }
+}
+
+typedef struct
+{
+    unsigned char *inbuf;
+    unsigned int inlen;
+    unsigned int actual;
+} p3io_exchange_t;
+
+static void ExchangeResponse(void *context, const unsigned char *response, unsigned int length)
+{
+    p3io_exchange_t *exchange = (p3io_exchange_t *)context;
+
+    /* Remember the real length even if it is longer than the buffer */
+    exchange->actual = length;
+    if (response == NULL)
+    {
+        return;
+    }
+    memcpy(exchange->inbuf, response, length < exchange->inlen ? length : exchange->inlen);
+}
+
+unsigned int P3IOBackend::ExchangeP3IO(unsigned char *outbuf, unsigned int outlen, unsigned char *inbuf, unsigned int inlen)
+{
+    if (!is_ready)
+    {
+        return 0;
+    }
+
+    p3io_exchange_t exchange;
+    exchange.inbuf = inbuf;
+    exchange.inlen = inlen;
+    exchange.actual = 0;
+
+    /* If the queue is full, push what we have out to make room */
+    if (!queue.Submit(outbuf, outlen, ExchangeResponse, &exchange))
+    {
+        FlushP3IO();
+        if (!queue.Submit(outbuf, outlen, ExchangeResponse, &exchange))
+        {
+            return 0;
+        }
+    }
+    FlushP3IO();
+
+    /* Return the real length read, even if it is longer than the buffer. We
+       stop copying when we get to the buffer length, so this is for information
+       to be passed to the caller. */
+    return exchange.actual;
+}
+
+bool P3IOBackend::SubmitP3IO(unsigned char *outbuf, unsigned int outlen, p3io_callback_t callback)
+{
+    if (!is_ready)
+    {
+        return false;
+    }
+
+    /* If the queue is full, push what we have out to make room */
+    if (!queue.Submit(outbuf, outlen, callback, this))
+    {
+        FlushP3IO();
+        return queue.Submit(outbuf, outlen, callback, this);
+    }
+
+    return true;
+}
+
+bool P3IOBackend::FlushP3IO()
+{
+    if (!is_ready)
+    {
+        queue.Fail();
+        return false;
+    }
+
+    /* Write every queued request out back to back, without waiting on responses */
+    unsigned char buffer[P3IO_MAX_FRAME_LENGTH * 2];
+    while (queue.Unsent() > 0)
+    {
+        unsigned int length = queue.Encode(buffer, sizeof(buffer));
+        DWORD actual = 0;
+        WriteFile(p3io, buffer, length, &actual, 0);
+
+        if (actual != length)
+        {
+            fprintf(stderr, "Failed to output correct amount of data to P3IO!\n");
+            queue.Fail();
+            return false;
+        }
+    }
+    FlushFileBuffers(p3io);
+
+    /* Now, collect responses until everything is accounted for. Allow a few
+       partial reads per outstanding request before giving up. */
+    unsigned int reads = 0;
+    unsigned int maxreads = queue.Pending() * P3IO_MAX_READS;
+    while (queue.Pending() > 0 && reads < maxreads)
+    {
+        DWORD actual = 0;
+        if (!ReadFile(p3io, buffer, sizeof(buffer), &actual, 0) || actual == 0)
+        {
+            break;
+        }
+
+        queue.Receive(buffer, actual);
+        reads++;
+    }
+
+    if (queue.Pending() > 0)
+    {
+        fprintf(stderr, "Failed to get %d responses back from P3IO!\n", queue.Pending());
+        queue.Fail();
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Moves the EXTIO link along as far as it will go without waiting: collects
+ * any acks that arrived, reaps the last write, and starts the next one. Ack
+ * times are only as precise as how often this gets called.
+ */
+void P3IOBackend::ServiceEXTIO()
+{
+    unsigned long long now = ClockMicroseconds();
+    DWORD actual = 0;
+
+    /* Finish off the last write if it is done */
+    if (extioWriting)
+    {
+        if (GetOverlappedResult(extio, &extioWrite, &actual, FALSE))
+        {
+            extioWriting = false;
+            if (actual != EXTIO_FRAME_LENGTH)
+            {
+                fprintf(stderr, "Failed to write to EXTIO!\n");
+            }
+        }
+        else if (GetLastError() != ERROR_IO_INCOMPLETE)
+        {
+            fprintf(stderr, "Failed to write to EXTIO!\n");
+            extioWriting = false;
+            link.Fail();
+        }
+    }
+
+    /* Pick up whatever acks have arrived */
+    while (true)
+    {
+        if (!extioReading)
+        {
+            if (!ReadFile(extio, extioIn, sizeof(extioIn), NULL, &extioRead))
+            {
+                if (GetLastError() != ERROR_IO_PENDING)
+                {
+                    fprintf(stderr, "Failed to read from EXTIO!\n");
+                    break;
+                }
+            }
+            extioReading = true;
+        }
+
+        if (!GetOverlappedResult(extio, &extioRead, &actual, FALSE))
+        {
+            if (GetLastError() != ERROR_IO_INCOMPLETE)
+            {
+                fprintf(stderr, "Failed to read from EXTIO!\n");
+                extioReading = false;
+            }
+            break;
+        }
+
+        extioReading = false;
+        if (actual == 0)
+        {
+            break;
+        }
+        link.Receive(extioIn, actual, now);
+    }
+
+    /* Don't let a frame that was never acked hold up newer ones */
+    link.Timeout(now);
+
+    /* Send the newest frame if the EXTIO has room for it */
+    if (!extioWriting)
+    {
+        unsigned int length = link.Encode(extioOut, sizeof(extioOut), now);
+        if (length > 0)
+        {
+            if (WriteFile(extio, extioOut, length, NULL, &extioWrite) || GetLastError() == ERROR_IO_PENDING)
+            {
+                extioWriting = true;
+            }
+            else
+            {
+                fprintf(stderr, "Failed to write to EXTIO!\n");
+                link.Fail();
+            }
+        }
+    }
+}
+
+/**
+ * Gives the EXTIO a bounded amount of time to take the last light frame, so
+ * lights set on the way out actually get there.
+ */
+void P3IOBackend::DrainEXTIO()
+{
+    for (unsigned int waited = 0; waited < EXTIO_DRAIN_TIMEOUT_MS; waited++)
+    {
+        ServiceEXTIO();
+        if (link.Idle() && !extioWriting)
+        {
+            break;
+        }
+        Sleep(1);
+    }
+}
+
+unsigned int P3IOBackend::GetButtonsHeld(HANDLE device)
+{
+    /* This is an IOCTL instead of a normal write/read operation.
+       Presumably this is for latency guarantees over USB. */
+    if (!is_ready)
+    {
+        return 0;
+    }
+
+    /* Poll the device using an IOCTL */
+    unsigned char realoutbuf[16] = { 0x0 };
+    DWORD actual = 0;
+    if (!DeviceIoControl(device, 0x222068, 0, 0, realoutbuf, 16, &actual, 0))
+    {
+        fprintf(stderr, "Failed to poll for buttons!\n");
+        return 0;
+    }
+
+    /* I don't know why we could get 16 bytes back, but we seem to always get 12 */
+    if (actual != 12)
+    {
+        fprintf(stderr, "Got unexpected size %d back from button poll!\n", actual);
+        return 0;
+    }
+
+    /* Buttons start at the second byte */
+    return P3IODecodeButtons(realoutbuf + 1);
+}
+
+unsigned int P3IOBackend::PollButtons()
+{
+    return GetButtonsHeld(pollio);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <windows.h>
+
+#include "IOBackend.h"
+#include "P3IOQueue.h"
+#include "EXTIOLink.h"
+
+typedef struct {
+    unsigned int slot1;
+    unsigned int slot2;
+} coincount;
+
+/**
+ * A real cabinet, with a P3IO for buttons and cabinet lights, and optionally
+ * an EXTIO on COM1 for pad lights and bass neons.
+ */
+class P3IOBackend : public IOBackend
+{
+public:
+    P3IOBackend();
+    ~P3IOBackend();
+
+    bool Ready();
+    unsigned int PollButtons();
+    void SetCabLights(unsigned int cablights);
+    void SetPadLights(unsigned int padlights);
+    void Service();
+
+    static bool Released();
+private:
+    HANDLE p3io;
+    HANDLE extio;
+    HANDLE pollio;
+
+    P3IOQueue queue;
+
+    /* EXTIO writes and reads are overlapped so light updates never block */
+    EXTIOLink link;
+    OVERLAPPED extioWrite;
+    OVERLAPPED extioRead;
+    bool extioWriting;
+    bool extioReading;
+    unsigned char extioOut[EXTIO_FRAME_LENGTH];
+    unsigned char extioIn[16];
+
+    unsigned int ExchangeP3IO(unsigned char *outbuf, unsigned int outlen, unsigned char *inbuf, unsigned int inlen);
+    bool SubmitP3IO(unsigned char *outbuf, unsigned int outlen, p3io_callback_t callback);
+    bool FlushP3IO();
+    void ServiceEXTIO();
+    void DrainEXTIO();
+
+    static bool GetDevicePath(wchar_t *filename, unsigned int length);
+
+    void GetVersion();
+    void SetMode();
+    void GetCabType(unsigned int request);
+    void GetCoinstock();
+    unsigned int GetButtonsHeld(HANDLE device);
+
+    static void VersionResponse(void *context, const unsigned char *inbuf, unsigned int actual);
+    static void ModeResponse(void *context, const unsigned char *inbuf, unsigned int actual);
+    static void CabTypeResponse(void *context, const unsigned char *inbuf, unsigned int actual);
+    static void CoinstockResponse(void *context, const unsigned char *inbuf, unsigned int actual);
+
+    bool is_ready;
+    unsigned int cabtype;
+    coincount coinstock;
+};
@@ -0,0 +1,6 @@
+#include "P3IOButtons.h"
+
+unsigned int P3IODecodeButtons(const unsigned char *jamma)
+{
+    return P3IOButtonTable<P3IO_BUTTON_WIRING>::Decode(jamma);
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "IO.h"
+
+/* How many bytes of JAMMA state the P3IO reports buttons in */
+#define P3IO_JAMMA_LENGTH 4
+
+/* Cabinet wirings we know how to decode */
+#define P3IO_WIRING_DDR 0
+
+/* Pick a different wiring by defining this for the whole build */
+#ifndef P3IO_BUTTON_WIRING
+#define P3IO_BUTTON_WIRING P3IO_WIRING_DDR
+#endif
+
+/**
+ * Which BUTTON_* bit a JAMMA input lands on for a given wiring. Inputs that
+ * aren't specialized below aren't buttons we care about. A new wiring only
+ * needs its own set of P3IO_WIRE() lines, everything else follows from them.
+ */
+template <int Wiring, int Byte, int Bit>
+struct P3IOWire
+{
+    enum { button = 0 };
+};
+
+#define P3IO_WIRE(wiring, byte, bit, mapped) \
+    template <> struct P3IOWire<wiring, byte, bit> { enum { button = mapped }; };
+
+/* 1P Pad inputs */
+P3IO_WIRE(P3IO_WIRING_DDR, 0, 1, BUTTON_1P_UP)
+P3IO_WIRE(P3IO_WIRING_DDR, 0, 2, BUTTON_1P_DOWN)
+P3IO_WIRE(P3IO_WIRING_DDR, 0, 3, BUTTON_1P_LEFT)
+P3IO_WIRE(P3IO_WIRING_DDR, 0, 4, BUTTON_1P_RIGHT)
+
+/* 2P Pad inputs */
+P3IO_WIRE(P3IO_WIRING_DDR, 1, 1, BUTTON_2P_UP)
+P3IO_WIRE(P3IO_WIRING_DDR, 1, 2, BUTTON_2P_DOWN)
+P3IO_WIRE(P3IO_WIRING_DDR, 1, 3, BUTTON_2P_LEFT)
+P3IO_WIRE(P3IO_WIRING_DDR, 1, 4, BUTTON_2P_RIGHT)
+
+/* 1P Menu inputs */
+P3IO_WIRE(P3IO_WIRING_DDR, 3, 0, BUTTON_1P_MENUUP)
+P3IO_WIRE(P3IO_WIRING_DDR, 3, 1, BUTTON_1P_MENUDOWN)
+P3IO_WIRE(P3IO_WIRING_DDR, 0, 6, BUTTON_1P_MENULEFT)
+P3IO_WIRE(P3IO_WIRING_DDR, 0, 7, BUTTON_1P_MENURIGHT)
+
+/* 2P Menu inputs */
+P3IO_WIRE(P3IO_WIRING_DDR, 3, 2, BUTTON_2P_MENUUP)
+P3IO_WIRE(P3IO_WIRING_DDR, 3, 3, BUTTON_2P_MENUDOWN)
+P3IO_WIRE(P3IO_WIRING_DDR, 1, 6, BUTTON_2P_MENULEFT)
+P3IO_WIRE(P3IO_WIRING_DDR, 1, 7, BUTTON_2P_MENURIGHT)
+
+/* Start inputs */
+P3IO_WIRE(P3IO_WIRING_DDR, 0, 0, BUTTON_1P_START)
+P3IO_WIRE(P3IO_WIRING_DDR, 1, 0, BUTTON_2P_START)
+
+/* Cabinet buttons */
+P3IO_WIRE(P3IO_WIRING_DDR, 2, 5, BUTTON_COIN)
+P3IO_WIRE(P3IO_WIRING_DDR, 2, 6, BUTTON_SERVICE)
+P3IO_WIRE(P3IO_WIRING_DDR, 2, 4, BUTTON_TEST)
+
+/* Everything held in one raw JAMMA byte. JAMMA reports active low, so a clear
+   bit is a held button. */
+template <int Wiring, int Byte, int Value>
+struct P3IOByteButtons
+{
+    enum
+    {
+        buttons =
+            ((Value & 0x01) ? 0 : (int)P3IOWire<Wiring, Byte, 0>::button) |
+            ((Value & 0x02) ? 0 : (int)P3IOWire<Wiring, Byte, 1>::button) |
+            ((Value & 0x04) ? 0 : (int)P3IOWire<Wiring, Byte, 2>::button) |
+            ((Value & 0x08) ? 0 : (int)P3IOWire<Wiring, Byte, 3>::button) |
+            ((Value & 0x10) ? 0 : (int)P3IOWire<Wiring, Byte, 4>::button) |
+            ((Value & 0x20) ? 0 : (int)P3IOWire<Wiring, Byte, 5>::button) |
+            ((Value & 0x40) ? 0 : (int)P3IOWire<Wiring, Byte, 6>::button) |
+            ((Value & 0x80) ? 0 : (int)P3IOWire<Wiring, Byte, 7>::button)
+    };
+};
+
+/* Spells out all 256 values of one byte as a table initializer */
+#define P3IO_BYTE_1(wiring, byte, value) P3IOByteButtons<wiring, byte, (value)>::buttons
+#define P3IO_BYTE_4(wiring, byte, value) \
+    P3IO_BYTE_1(wiring, byte, (value) + 0), P3IO_BYTE_1(wiring, byte, (value) + 1), \
+    P3IO_BYTE_1(wiring, byte, (value) + 2), P3IO_BYTE_1(wiring, byte, (value) + 3)
+#define P3IO_BYTE_16(wiring, byte, value) \
+    P3IO_BYTE_4(wiring, byte, (value) + 0), P3IO_BYTE_4(wiring, byte, (value) + 4), \
+    P3IO_BYTE_4(wiring, byte, (value) + 8), P3IO_BYTE_4(wiring, byte, (value) + 12)
+#define P3IO_BYTE_64(wiring, byte, value) \
+    P3IO_BYTE_16(wiring, byte, (value) + 0), P3IO_BYTE_16(wiring, byte, (value) + 16), \
+    P3IO_BYTE_16(wiring, byte, (value) + 32), P3IO_BYTE_16(wiring, byte, (value) + 48)
+#define P3IO_BYTE_256(wiring, byte) \
+    P3IO_BYTE_64(wiring, byte, 0), P3IO_BYTE_64(wiring, byte, 64), \
+    P3IO_BYTE_64(wiring, byte, 128), P3IO_BYTE_64(wiring, byte, 192)
+
+/**
+ * One 256 entry table per JAMMA byte, worked out entirely by the compiler,
+ * so decoding is four loads and three ORs with no branches.
+ */
+template <int Wiring>
+struct P3IOButtonTable
+{
+    static const unsigned int bytes[P3IO_JAMMA_LENGTH][256];
+
+    static unsigned int Decode(const unsigned char *jamma)
+    {
+        return bytes[0][jamma[0]] | bytes[1][jamma[1]] | bytes[2][jamma[2]] | bytes[3][jamma[3]];
+    }
+};
+
+template <int Wiring>
+const unsigned int P3IOButtonTable<Wiring>::bytes[P3IO_JAMMA_LENGTH][256] =
+{
+    { P3IO_BYTE_256(Wiring, 0) },
+    { P3IO_BYTE_256(Wiring, 1) },
+    { P3IO_BYTE_256(Wiring, 2) },
+    { P3IO_BYTE_256(Wiring, 3) },
+};
+
+/* Maps the P3IO's active low JAMMA bytes to our BUTTON_* bits, using the
+   wiring this build was configured for */
+unsigned int P3IODecodeButtons(const unsigned char *jamma);
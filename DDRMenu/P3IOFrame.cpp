@@ -0,0 +1,208 @@
+#include <string.h>
+
+#include "P3IOFrame.h"
+
+/* Every x86 compiler we care about exposes SSE2 when the target has it.
+   P3IO_NO_SSE2 forces the plain loops, so they can be tested on x86 too. */
+#if !defined(P3IO_NO_SSE2) && (defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define P3IO_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+unsigned int P3IOFindEscape(const unsigned char *data, unsigned int length)
+{
+    unsigned int loc = 0;
+
+#ifdef P3IO_USE_SSE2
+    /* Check 16 bytes at a time for either framing byte */
+    const __m128i som = _mm_set1_epi8((char)P3IO_SOM);
+    const __m128i escape = _mm_set1_epi8((char)P3IO_ESCAPE);
+
+    while (loc + 16 <= length)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(data + loc));
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, som), _mm_cmpeq_epi8(chunk, escape)));
+
+        if (mask != 0)
+        {
+            /* Lowest set bit is the first matching byte */
+            while ((mask & 1) == 0)
+            {
+                mask >>= 1;
+                loc++;
+            }
+            return loc;
+        }
+
+        loc += 16;
+    }
+#endif
+
+    /* Finish up whatever is left one byte at a time */
+    while (loc < length)
+    {
+        if (data[loc] == P3IO_SOM || data[loc] == P3IO_ESCAPE)
+        {
+            return loc;
+        }
+        loc++;
+    }
+
+    return length;
+}
+
+unsigned int P3IOEncodeFrame(
+    const unsigned char *payload,
+    unsigned int length,
+    unsigned int sequence,
+    unsigned char *frame,
+    unsigned int framelen
+) {
+    if (length > P3IO_MAX_PAYLOAD_LENGTH)
+    {
+        return 0;
+    }
+
+    /* Make sure the worst case fits so we don't need to check as we go */
+    if (framelen < 3 + (length * 2))
+    {
+        return 0;
+    }
+
+    unsigned int loc = 0;
+    frame[loc++] = P3IO_SOM;
+    frame[loc++] = length + 1;
+    frame[loc++] = sequence & 0xF;
+
+    unsigned int i = 0;
+    while (i < length)
+    {
+        /* Copy everything up to the next byte that needs escaping in one go */
+        unsigned int run = P3IOFindEscape(payload + i, length - i);
+        memcpy(frame + loc, payload + i, run);
+        loc += run;
+        i += run;
+
+        if (i < length)
+        {
+            /* Escape this byte */
+            frame[loc++] = P3IO_ESCAPE;
+            frame[loc++] = ~payload[i];
+            i++;
+        }
+    }
+
+    return loc;
+}
+
+P3IOFrameDecoder::P3IOFrameDecoder()
+{
+    Reset();
+}
+
+void P3IOFrameDecoder::Reset()
+{
+    state = STATE_SOM;
+    sequence = 0;
+    length = 0;
+    received = 0;
+}
+
+/**
+ * Consumes bytes until a whole frame has been decoded, and returns how many
+ * bytes were used. Anything after the end of a frame is left alone so the
+ * caller can Reset() and feed it again for the next frame.
+ */
+unsigned int P3IOFrameDecoder::Feed(const unsigned char *data, unsigned int datalen)
+{
+    unsigned int loc = 0;
+
+    while (loc < datalen && state != STATE_COMPLETE)
+    {
+        switch (state)
+        {
+            case STATE_SOM:
+            {
+                /* Skip any garbage before the start of the frame */
+                if (data[loc++] == P3IO_SOM)
+                {
+                    state = STATE_LENGTH;
+                }
+                break;
+            }
+            case STATE_LENGTH:
+            {
+                /* The length includes the sequence, so zero is never valid */
+                length = data[loc++];
+                if (length == 0)
+                {
+                    state = STATE_SOM;
+                }
+                else
+                {
+                    length--;
+                    state = STATE_SEQUENCE;
+                }
+                break;
+            }
+            case STATE_SEQUENCE:
+            {
+                sequence = data[loc++] & 0xF;
+                received = 0;
+                state = length > 0 ? STATE_PAYLOAD : STATE_COMPLETE;
+                break;
+            }
+            case STATE_PAYLOAD:
+            {
+                /* Copy everything up to the next framing byte in one go */
+                unsigned int want = length - received;
+                unsigned int have = datalen - loc;
+                unsigned int run = P3IOFindEscape(data + loc, want < have ? want : have);
+                memcpy(payload + received, data + loc, run);
+                received += run;
+                loc += run;
+
+                if (received == length)
+                {
+                    state = STATE_COMPLETE;
+                }
+                else if (loc < datalen)
+                {
+                    if (data[loc] == P3IO_SOM)
+                    {
+                        /* A new frame started in the middle of this one, resync on it */
+                        loc++;
+                        state = STATE_LENGTH;
+                    }
+                    else
+                    {
+                        /* Unescape the next byte */
+                        loc++;
+                        state = STATE_ESCAPE;
+                    }
+                }
+                break;
+            }
+            case STATE_ESCAPE:
+            {
+                /* Escaped bytes are never a start of frame, so this is a new frame */
+                if (data[loc] == P3IO_SOM)
+                {
+                    loc++;
+                    state = STATE_LENGTH;
+                    break;
+                }
+
+                payload[received++] = ~data[loc++];
+                state = received == length ? STATE_COMPLETE : STATE_PAYLOAD;
+                break;
+            }
+            default:
+            {
+                break;
+            }
+        }
+    }
+
+    return loc;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+/* Framing bytes used on the P3IO bulk pipe */
+#define P3IO_SOM 0xAA
+#define P3IO_ESCAPE 0xFF
+
+/* The length byte covers the sequence byte as well as the payload */
+#define P3IO_MAX_PAYLOAD_LENGTH 254
+
+/* Worst case size of an encoded frame, with every payload byte escaped */
+#define P3IO_MAX_FRAME_LENGTH (3 + (P3IO_MAX_PAYLOAD_LENGTH * 2))
+
+/* Returns the offset of the first byte that needs escaping, or length if none do */
+unsigned int P3IOFindEscape(const unsigned char *data, unsigned int length);
+
+/* Frames and escapes a payload into a caller-owned buffer. Returns the number
+   of bytes written, or 0 if the payload does not fit. */
+unsigned int P3IOEncodeFrame(
+    const unsigned char *payload,
+    unsigned int length,
+    unsigned int sequence,
+    unsigned char *frame,
+    unsigned int framelen
+);
+
+class P3IOFrameDecoder
+{
+public:
+    P3IOFrameDecoder();
+
+    void Reset();
+    unsigned int Feed(const unsigned char *data, unsigned int length);
+
+    bool Started() { return state != STATE_SOM; }
+    bool Complete() { return state == STATE_COMPLETE; }
+    unsigned int Sequence() { return sequence; }
+    unsigned int Length() { return length; }
+    const unsigned char *Payload() { return payload; }
+private:
+    enum
+    {
+        STATE_SOM,
+        STATE_LENGTH,
+        STATE_SEQUENCE,
+        STATE_PAYLOAD,
+        STATE_ESCAPE,
+        STATE_COMPLETE
+    } state;
+
+    unsigned int sequence;
+    unsigned int length;
+    unsigned int received;
+    unsigned char payload[P3IO_MAX_PAYLOAD_LENGTH];
+};
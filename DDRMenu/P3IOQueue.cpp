@@ -0,0 +1,145 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "P3IOQueue.h"
+
+P3IOQueue::P3IOQueue()
+{
+    memset(requests, 0, sizeof(requests));
+    sequence = 0;
+    pending = 0;
+    unsent = 0;
+    unmatched = 0;
+}
+
+bool P3IOQueue::Submit(const unsigned char *request, unsigned int length, p3io_callback_t callback, void *context)
+{
+    if (length > P3IO_MAX_PAYLOAD_LENGTH)
+    {
+        fprintf(stderr, "Request of size %d is too large for P3IO!\n", length);
+        return false;
+    }
+
+    /* If we've wrapped around to a request that's still out, we can't tell them apart */
+    unsigned int slot = sequence & 0xF;
+    if (requests[slot].used)
+    {
+        return false;
+    }
+
+    requests[slot].used = true;
+    requests[slot].sent = false;
+    requests[slot].callback = callback;
+    requests[slot].context = context;
+    requests[slot].length = length;
+    memcpy(requests[slot].request, request, length);
+
+    sequence++;
+    pending++;
+    unsent++;
+    return true;
+}
+
+/**
+ * Frames as many unsent requests as will fit, oldest first. Returns the number
+ * of bytes to write to the device. Requests that didn't fit stay queued for
+ * the next call.
+ */
+unsigned int P3IOQueue::Encode(unsigned char *buffer, unsigned int buflen)
+{
+    unsigned int loc = 0;
+
+    while (unsent > 0)
+    {
+        unsigned int slot = (sequence - unsent) & 0xF;
+        unsigned int framelen = P3IOEncodeFrame(
+            requests[slot].request,
+            requests[slot].length,
+            slot,
+            buffer + loc,
+            buflen - loc
+        );
+
+        if (framelen == 0)
+        {
+            /* Out of room */
+            break;
+        }
+
+        requests[slot].sent = true;
+        loc += framelen;
+        unsent--;
+    }
+
+    return loc;
+}
+
+/**
+ * Decodes whatever the device sent back, which may be several responses or
+ * only part of one. Returns how many requests were completed.
+ */
+unsigned int P3IOQueue::Receive(const unsigned char *data, unsigned int length)
+{
+    unsigned int completed = 0;
+    unsigned int loc = 0;
+
+    while (loc < length)
+    {
+        loc += decoder.Feed(data + loc, length - loc);
+        if (!decoder.Complete())
+        {
+            /* Need more data to finish this packet */
+            break;
+        }
+
+        /* Anything we never sent, or already gave up on, has no one to go to.
+           Handing it to some other request would only shift every answer
+           after it onto the wrong caller. */
+        unsigned int slot = decoder.Sequence();
+        if (requests[slot].used && requests[slot].sent)
+        {
+            Complete(slot, decoder.Payload(), decoder.Length());
+            completed++;
+        }
+        else
+        {
+            fprintf(stderr, "Dropping response with sequence %d that nothing is waiting on from P3IO!\n", slot);
+            unmatched++;
+        }
+
+        decoder.Reset();
+    }
+
+    return completed;
+}
+
+/**
+ * Gives up on everything we're waiting on, letting each caller know.
+ */
+void P3IOQueue::Fail()
+{
+    for (unsigned int slot = 0; slot < P3IO_MAX_IN_FLIGHT; slot++)
+    {
+        if (requests[slot].used)
+        {
+            Complete(slot, NULL, 0);
+        }
+    }
+
+    unsent = 0;
+    decoder.Reset();
+}
+
+void P3IOQueue::Complete(unsigned int slot, const unsigned char *response, unsigned int length)
+{
+    /* Free the slot first so the callback can submit follow-up requests */
+    p3io_callback_t callback = requests[slot].callback;
+    void *context = requests[slot].context;
+    requests[slot].used = false;
+    pending--;
+
+    if (callback != NULL)
+    {
+        callback(context, response, length);
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "P3IOFrame.h"
+
+/* The sequence field is only 4 bits, so this is how many requests we can tell apart */
+#define P3IO_MAX_IN_FLIGHT 16
+
+/* Called once per request, with a NULL response and zero length if it failed */
+typedef void (*p3io_callback_t)(void *context, const unsigned char *response, unsigned int length);
+
+typedef struct
+{
+    bool used;
+    bool sent;
+    p3io_callback_t callback;
+    void *context;
+    unsigned int length;
+    unsigned char request[P3IO_MAX_PAYLOAD_LENGTH];
+} p3io_request_t;
+
+/**
+ * Keeps several P3IO requests in flight at once, matching responses back up
+ * using the sequence nibble. This does no I/O of its own, callers move the
+ * bytes produced by Encode() to the device and hand whatever comes back to
+ * Receive().
+ */
+class P3IOQueue
+{
+public:
+    P3IOQueue();
+
+    bool Submit(const unsigned char *request, unsigned int length, p3io_callback_t callback, void *context);
+    unsigned int Encode(unsigned char *buffer, unsigned int buflen);
+    unsigned int Receive(const unsigned char *data, unsigned int length);
+    void Fail();
+
+    unsigned int Pending() { return pending; }
+    unsigned int Unsent() { return unsent; }
+    unsigned int Unmatched() { return unmatched; }
+private:
+    p3io_request_t requests[P3IO_MAX_IN_FLIGHT];
+    unsigned int sequence;
+    unsigned int pending;
+    unsigned int unsent;
+    unsigned int unmatched;
+    P3IOFrameDecoder decoder;
+
+    void Complete(unsigned int slot, const unsigned char *response, unsigned int length);
+};
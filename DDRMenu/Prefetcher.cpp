@@ -0,0 +1,354 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Prefetcher.h"
+#include "Clock.h"
+
+Prefetcher::Prefetcher(unsigned long long prefetchBudget, unsigned int prefetchChunk)
+{
+    budget = prefetchBudget;
+    chunk = prefetchChunk > 0 ? prefetchChunk : PREFETCH_CHUNK_BYTES;
+    remaining = 0;
+    target[0] = 0;
+    current[0] = 0;
+    generation = 0;
+    currentGeneration = 0;
+    buffer = (unsigned char *)malloc(chunk);
+
+    warmed = 0;
+    warmTime = 0;
+    files = 0;
+    complete = false;
+    totalWarmed = 0;
+    targets = 0;
+    abandoned = 0;
+
+    running = 1;
+    if (!worker.Start(WorkerThread, this))
+    {
+        fprintf(stderr, "Failed to start prefetch thread!\n");
+        running = 0;
+    }
+}
+
+Prefetcher::~Prefetcher()
+{
+    Stop();
+    free(buffer);
+}
+
+/**
+ * Switches to warming a new game, given the path from its launch entry.
+ */
+void Prefetcher::Target(const char *path)
+{
+    lock.Lock();
+    strncpy(target, path, PREFETCH_MAX_PATH - 1);
+    target[PREFETCH_MAX_PATH - 1] = 0;
+    lock.Unlock();
+
+    AtomicStore(&generation, AtomicLoad(&generation) + 1);
+    changed.Set();
+}
+
+/**
+ * Abandons any reads in progress and waits for the worker to finish, so the
+ * game isn't fighting us for the disk.
+ */
+void Prefetcher::Stop()
+{
+    AtomicStore(&running, 0);
+    changed.Set();
+    worker.Join();
+}
+
+void Prefetcher::WorkerThread(void *param)
+{
+    Prefetcher *prefetcher = (Prefetcher *)param;
+
+    while (AtomicLoad(&prefetcher->running))
+    {
+        if (!prefetcher->changed.Wait(100))
+        {
+            continue;
+        }
+
+        /* Let the selection settle so scrolling past games doesn't read them */
+        while (AtomicLoad(&prefetcher->running) && prefetcher->changed.Wait(PREFETCH_DWELL_MS))
+        {
+        }
+
+        if (AtomicLoad(&prefetcher->running))
+        {
+            prefetcher->Warm();
+        }
+    }
+}
+
+bool Prefetcher::Cancelled()
+{
+    return !AtomicLoad(&running) || AtomicLoad(&generation) != currentGeneration;
+}
+
+void Prefetcher::Warm()
+{
+    lock.Lock();
+    strcpy(current, target);
+    currentGeneration = AtomicLoad(&generation);
+    lock.Unlock();
+
+    remaining = budget;
+    warmed = 0;
+    files = 0;
+    complete = false;
+    targets++;
+
+    unsigned long long start = ClockMicroseconds();
+
+    /* The executable itself matters most, then whatever lives next to it */
+    bool finished = WarmFile(current);
+    if (finished)
+    {
+        char directory[PREFETCH_MAX_PATH];
+        strcpy(directory, current);
+
+        char *slash = strrchr(directory, '\\');
+        char *other = strrchr(directory, '/');
+        if (other > slash)
+        {
+            slash = other;
+        }
+        if (slash != NULL)
+        {
+            *slash = 0;
+            finished = WarmDirectory(directory, slash - directory, 0);
+        }
+    }
+
+    warmTime = ClockMicroseconds() - start;
+    complete = finished && !Cancelled();
+    totalWarmed += warmed;
+
+    /* Cut short by a newer target, rather than the budget or shutting down */
+    if (!finished && AtomicLoad(&generation) != currentGeneration)
+    {
+        abandoned++;
+    }
+}
+
+/**
+ * Warms every file under the given directory, depth first, until we run out
+ * of budget or get cancelled. The directory buffer is appended to in place
+ * and put back the way it was before returning.
+ */
+bool Prefetcher::WarmDirectory(char *directory, unsigned int length, unsigned int depth)
+{
+    if (depth > PREFETCH_MAX_DEPTH)
+    {
+        return true;
+    }
+
+    bool finished = true;
+
+#ifdef _WIN32
+    if (length + 3 > PREFETCH_MAX_PATH)
+    {
+        return true;
+    }
+    strcpy(directory + length, "\\*");
+
+    WIN32_FIND_DATAA found;
+    HANDLE search = FindFirstFileA(directory, &found);
+    directory[length] = 0;
+    if (search == INVALID_HANDLE_VALUE)
+    {
+        return true;
+    }
+
+    do
+    {
+        const char *name = found.cFileName;
+        bool isDirectory = (found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+#else
+    DIR *search = opendir(directory);
+    if (search == NULL)
+    {
+        return true;
+    }
+
+    struct dirent *found;
+    while ((found = readdir(search)) != NULL)
+    {
+        const char *name = found->d_name;
+#endif
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+        {
+            continue;
+        }
+
+        unsigned int namelen = strlen(name);
+        if (length + 1 + namelen + 1 > PREFETCH_MAX_PATH)
+        {
+            continue;
+        }
+        directory[length] = '\\';
+#ifndef _WIN32
+        directory[length] = '/';
+#endif
+        memcpy(directory + length + 1, name, namelen + 1);
+
+#ifndef _WIN32
+        /* Don't follow links out of the game's directory */
+        struct stat info;
+        if (lstat(directory, &info) != 0 || !(S_ISDIR(info.st_mode) || S_ISREG(info.st_mode)))
+        {
+            directory[length] = 0;
+            continue;
+        }
+        bool isDirectory = S_ISDIR(info.st_mode);
+#endif
+
+        if (isDirectory)
+        {
+            finished = WarmDirectory(directory, length + 1 + namelen, depth + 1);
+        }
+        else if (strcmp(directory, current) != 0)
+        {
+            /* The executable was already done first */
+            finished = WarmFile(directory);
+        }
+        directory[length] = 0;
+
+        if (!finished)
+        {
+            break;
+        }
+#ifdef _WIN32
+    } while (FindNextFileA(search, &found));
+
+    FindClose(search);
+#else
+    }
+
+    closedir(search);
+#endif
+
+    return finished;
+}
+
+/**
+ * Pulls a file into the OS cache, a chunk at a time so we notice quickly
+ * when the selection moves on. Returns false once we should stop reading.
+ */
+bool Prefetcher::WarmFile(const char *file)
+{
+    if (Cancelled() || remaining == 0)
+    {
+        return false;
+    }
+
+#ifdef _WIN32
+    /* Sequential scan lets the cache manager read further ahead for us */
+    HANDLE handle = CreateFileA(file, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+    if (handle == INVALID_HANDLE_VALUE)
+    {
+        return true;
+    }
+
+    while (remaining > 0 && !Cancelled())
+    {
+        DWORD length = remaining < chunk ? (DWORD)remaining : chunk;
+        DWORD actual = 0;
+        if (!ReadFile(handle, buffer, length, &actual, 0) || actual == 0)
+        {
+            break;
+        }
+
+        warmed += actual;
+        remaining -= actual;
+    }
+
+    CloseHandle(handle);
+#else
+    int handle = open(file, O_RDONLY);
+    if (handle < 0)
+    {
+        return true;
+    }
+
+    struct stat info;
+    unsigned long long size = 0;
+    if (fstat(handle, &info) == 0)
+    {
+        size = info.st_size;
+    }
+    if (size > remaining)
+    {
+        size = remaining;
+    }
+
+    /* Ask for the whole thing up front, then make sure it actually happens */
+    posix_fadvise(handle, 0, size, POSIX_FADV_WILLNEED);
+
+    unsigned long long offset = 0;
+    while (offset < size && !Cancelled())
+    {
+        unsigned long long length = size - offset < chunk ? size - offset : chunk;
+#ifdef __linux__
+        if (readahead(handle, offset, length) != 0)
+        {
+            break;
+        }
+#else
+        ssize_t actual = pread(handle, buffer, length, offset);
+        if (actual <= 0)
+        {
+            break;
+        }
+        length = actual;
+#endif
+
+        offset += length;
+        warmed += length;
+        remaining -= length;
+    }
+
+    close(handle);
+#endif
+
+    files++;
+    return remaining > 0 && !Cancelled();
+}
+
+void Prefetcher::Dump(FILE *fp)
+{
+    if (targets == 0)
+    {
+        fprintf(fp, "prefetch: nothing warmed\n");
+        return;
+    }
+
+    /* Time spent on cold reads here is time the game doesn't spend booting */
+    fprintf(
+        fp,
+        "prefetch: %s warmed %llu KB in %u files over %llu ms%s, %llu KB total across %u targets, %u abandoned\n",
+        current,
+        warmed / 1024,
+        files,
+        warmTime / 1000,
+        complete ? "" : " (stopped early)",
+        totalWarmed / 1024,
+        targets,
+        abandoned
+    );
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdio.h>
+
+#include "Thread.h"
+
+/* Most we'll read ahead for any one game, so we don't push everything else out of memory */
+#define PREFETCH_BUDGET_BYTES (128ULL * 1024 * 1024)
+
+/* How much we read between checks for a new selection */
+#define PREFETCH_CHUNK_BYTES (256 * 1024)
+
+/* How long a selection has to stay put before we start reading for it */
+#define PREFETCH_DWELL_MS 250
+
+/* How far into a game's directory we go looking for content */
+#define PREFETCH_MAX_DEPTH 4
+#define PREFETCH_MAX_PATH 1024
+
+/**
+ * Reads the highlighted game's executable and the files around it into the
+ * OS file cache while the menu waits, so the game doesn't boot from a cold
+ * disk. Changing the target abandons whatever was being read and starts on
+ * the new one.
+ */
+class Prefetcher
+{
+public:
+    Prefetcher(unsigned long long budget = PREFETCH_BUDGET_BYTES, unsigned int chunk = PREFETCH_CHUNK_BYTES);
+    ~Prefetcher();
+
+    void Target(const char *path);
+    void Stop();
+
+    /* How the last target went, only safe to read once stopped */
+    const char *Current() { return current; }
+    unsigned long long Warmed() { return warmed; }
+    bool Complete() { return complete; }
+    unsigned int Targets() { return targets; }
+    unsigned int Abandoned() { return abandoned; }
+
+    void Dump(FILE *fp);
+private:
+    static void WorkerThread(void *param);
+
+    void Warm();
+    bool WarmDirectory(char *directory, unsigned int length, unsigned int depth);
+    bool WarmFile(const char *file);
+    bool Cancelled();
+
+    Thread worker;
+    Event changed;
+    Mutex lock;
+    volatile long running;
+
+    /* Latest target handed to us, bumping the generation cancels the last one */
+    char target[PREFETCH_MAX_PATH];
+    volatile long generation;
+
+    /* Only touched by the worker until it has been stopped */
+    char current[PREFETCH_MAX_PATH];
+    long currentGeneration;
+    unsigned long long budget;
+    unsigned long long remaining;
+    unsigned int chunk;
+    unsigned char *buffer;
+
+    unsigned long long warmed;
+    unsigned long long warmTime;
+    unsigned int files;
+    bool complete;
+    unsigned long long totalWarmed;
+    unsigned int targets;
+    unsigned int abandoned;
+};
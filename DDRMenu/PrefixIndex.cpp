@@ -0,0 +1,190 @@
+#include <string.h>
+
+#include "PrefixIndex.h"
+
+static char Fold(char letter)
+{
+    return (letter >= 'a' && letter <= 'z') ? letter - 'a' + 'A' : letter;
+}
+
+PrefixIndex::PrefixIndex()
+{
+    catalog = NULL;
+    sorted = NULL;
+    count = 0;
+}
+
+/**
+ * Indexes a catalog in its name order. One loaded from a cache image already
+ * has that, so only a freshly parsed catalog ever gets sorted here.
+ */
+void PrefixIndex::Build(Catalog *newCatalog)
+{
+    catalog = newCatalog;
+    count = catalog->Count();
+    if (catalog->Order() == NULL)
+    {
+        catalog->Sort();
+    }
+    sorted = catalog->Order();
+}
+
+/**
+ * Returns the upper-cased letter at depth in the name at a sorted position,
+ * or 0 if the name is shorter than that. Callers only ask about depths inside
+ * a run that shares a prefix at least that long.
+ */
+char PrefixIndex::LetterAt(unsigned int position, unsigned int depth)
+{
+    const char *name = catalog->GetName(sorted[position]);
+    for (unsigned int i = 0; i < depth; i++)
+    {
+        if (name[i] == 0)
+        {
+            return 0;
+        }
+    }
+    return Fold(name[depth]);
+}
+
+/**
+ * First position in [first, last) whose letter at depth is at least letter.
+ */
+unsigned int PrefixIndex::LowerBound(unsigned int depth, char letter, unsigned int first, unsigned int last)
+{
+    while (first < last)
+    {
+        unsigned int middle = first + ((last - first) / 2);
+        if ((unsigned char)LetterAt(middle, depth) < (unsigned char)letter)
+        {
+            first = middle + 1;
+        }
+        else
+        {
+            last = middle;
+        }
+    }
+
+    return first;
+}
+
+/**
+ * Shrinks a run sharing a depth long prefix down to the entries that continue
+ * with letter. The run comes back empty if nothing does.
+ */
+void PrefixIndex::Narrow(unsigned int depth, char letter, unsigned int *first, unsigned int *last)
+{
+    letter = Fold(letter);
+    unsigned int start = LowerBound(depth, letter, *first, *last);
+    unsigned int end = start;
+    if (letter != (char)0xFF)
+    {
+        end = LowerBound(depth, letter + 1, start, *last);
+    }
+    else
+    {
+        end = *last;
+    }
+
+    *first = start;
+    *last = end;
+}
+
+/**
+ * Returns the smallest letter after the given one that some entry in the run
+ * continues with, or 0 if there isn't one. Pass 0 to get the first letter.
+ */
+char PrefixIndex::NextLetter(unsigned int depth, unsigned int first, unsigned int last, char after)
+{
+    if ((unsigned char)after == 0xFF)
+    {
+        return 0;
+    }
+
+    unsigned int position = LowerBound(depth, after + 1, first, last);
+    return position < last ? LetterAt(position, depth) : 0;
+}
+
+/**
+ * Returns the largest letter before the given one that some entry in the run
+ * continues with, or 0 if there isn't one. Pass 0 to get the last letter.
+ */
+char PrefixIndex::PrevLetter(unsigned int depth, unsigned int first, unsigned int last, char before)
+{
+    unsigned int position = before == 0 ? last : LowerBound(depth, before, first, last);
+    return position > first ? LetterAt(position - 1, depth) : 0;
+}
+
+/**
+ * Works out where every entry here went in another index, by name, storing
+ * INDEX_NO_ENTRY for ones that are gone. Both indexes are already in name
+ * order, so this is a single walk along the two of them together, one group
+ * of names that only differ in case at a time.
+ */
+void PrefixIndex::Map(PrefixIndex *newer, unsigned int *entries)
+{
+    unsigned int position = 0;
+    unsigned int other = 0;
+
+    while (position < count)
+    {
+        const char *name = catalog->GetName(sorted[position]);
+        int difference = other < newer->count ? CatalogCompareNames(name, newer->catalog->GetName(newer->sorted[other])) : -1;
+
+        if (difference < 0)
+        {
+            entries[sorted[position]] = INDEX_NO_ENTRY;
+            position++;
+            continue;
+        }
+        if (difference > 0)
+        {
+            /* Added since */
+            other++;
+            continue;
+        }
+
+        /* Find the end of this group on both sides */
+        unsigned int groupEnd = position + 1;
+        while (groupEnd < count && CatalogCompareNames(name, catalog->GetName(sorted[groupEnd])) == 0)
+        {
+            groupEnd++;
+        }
+        unsigned int otherEnd = other + 1;
+        while (otherEnd < newer->count && CatalogCompareNames(name, newer->catalog->GetName(newer->sorted[otherEnd])) == 0)
+        {
+            otherEnd++;
+        }
+
+        /* Only the exact same name counts, and repeats pair up in order */
+        for (unsigned int entry = position; entry < groupEnd; entry++)
+        {
+            const char *exact = catalog->GetName(sorted[entry]);
+            unsigned int repeat = 0;
+            for (unsigned int earlier = position; earlier < entry; earlier++)
+            {
+                if (strcmp(exact, catalog->GetName(sorted[earlier])) == 0)
+                {
+                    repeat++;
+                }
+            }
+
+            entries[sorted[entry]] = INDEX_NO_ENTRY;
+            for (unsigned int candidate = other; candidate < otherEnd; candidate++)
+            {
+                if (strcmp(exact, newer->catalog->GetName(newer->sorted[candidate])) == 0)
+                {
+                    if (repeat == 0)
+                    {
+                        entries[sorted[entry]] = newer->sorted[candidate];
+                        break;
+                    }
+                    repeat--;
+                }
+            }
+        }
+
+        position = groupEnd;
+        other = otherEnd;
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Catalog.h"
+
+/* What Map() says for an entry with no counterpart */
+#define INDEX_NO_ENTRY 0xFFFFFFFF
+
+/**
+ * Catalog entries in the catalog's name order, ignoring case, so every prefix
+ * matches one contiguous run of them. Narrowing a run by another character is a pair of
+ * binary searches inside the current run, so searching never walks the whole
+ * catalog. Runs are given as [first, last) positions in sorted order.
+ */
+class PrefixIndex
+{
+public:
+    PrefixIndex();
+
+    void Build(Catalog *catalog);
+
+    unsigned int Count() { return count; }
+    unsigned int Entry(unsigned int position) { return sorted[position]; }
+
+    void Narrow(unsigned int depth, char letter, unsigned int *first, unsigned int *last);
+    char NextLetter(unsigned int depth, unsigned int first, unsigned int last, char after);
+    char PrevLetter(unsigned int depth, unsigned int first, unsigned int last, char before);
+    char LetterAt(unsigned int position, unsigned int depth);
+
+    void Map(PrefixIndex *newer, unsigned int *entries);
+private:
+    Catalog *catalog;
+    const unsigned int *sorted;
+    unsigned int count;
+
+    unsigned int LowerBound(unsigned int depth, char letter, unsigned int first, unsigned int last);
+};
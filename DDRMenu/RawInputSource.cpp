@@ -0,0 +1,75 @@
+#include <windows.h>
+
+#include "RawInputSource.h"
+#include "IO.h"
+#include "Clock.h"
+
+/* HID usage for keyboards on the generic desktop page */
+#define HID_USAGE_PAGE_GENERIC 0x01
+#define HID_USAGE_GENERIC_KEYBOARD 0x06
+
+typedef struct
+{
+    unsigned short vkey;
+    unsigned int button;
+} raw_key_t;
+
+static const raw_key_t rawKeys[] = {
+    { VK_LEFT, BUTTON_1P_MENULEFT },
+    { VK_RIGHT, BUTTON_1P_MENURIGHT },
+    { VK_UP, BUTTON_1P_MENUUP },
+    { VK_DOWN, BUTTON_1P_MENUDOWN },
+    { VK_RETURN, BUTTON_1P_START },
+    { 'W', BUTTON_1P_UP },
+    { 'S', BUTTON_1P_DOWN },
+    { 'A', BUTTON_1P_LEFT },
+    { 'D', BUTTON_1P_RIGHT },
+    { VK_F1, BUTTON_TEST },
+    { VK_F2, BUTTON_SERVICE },
+    { VK_F3, BUTTON_COIN },
+};
+
+RawInputSource::RawInputSource()
+{
+    held = 0;
+}
+
+bool RawInputSource::Register(HWND window)
+{
+    /* Sink so we still hear keys while the menu window has focus */
+    RAWINPUTDEVICE device;
+    device.usUsagePage = HID_USAGE_PAGE_GENERIC;
+    device.usUsage = HID_USAGE_GENERIC_KEYBOARD;
+    device.dwFlags = RIDEV_INPUTSINK;
+    device.hwndTarget = window;
+
+    return RegisterRawInputDevices(&device, 1, sizeof(device)) != FALSE;
+}
+
+bool RawInputSource::Input(const RAWINPUT *input, source_change_t change, void *context)
+{
+    if (input->header.dwType != RIM_TYPEKEYBOARD)
+    {
+        return false;
+    }
+
+    unsigned int newheld = held;
+    bool released = (input->data.keyboard.Flags & RI_KEY_BREAK) != 0;
+    for (unsigned int i = 0; i < sizeof(rawKeys) / sizeof(rawKeys[0]); i++)
+    {
+        if (rawKeys[i].vkey == input->data.keyboard.VKey)
+        {
+            newheld = released ? (newheld & ~rawKeys[i].button) : (newheld | rawKeys[i].button);
+        }
+    }
+
+    /* Raw input only carries a coarse message time, so stamp it on arrival.
+       Key repeat comes through as more presses of a held key, ignore those. */
+    if (newheld != held)
+    {
+        held = newheld;
+        change(context, held, ClockMicroseconds());
+    }
+
+    return true;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <windows.h>
+
+#include "InputSource.h"
+
+/**
+ * Every keyboard on the machine, through raw input so it works no matter
+ * which window has focus. The arrow keys drive the menu buttons, enter
+ * starts, WASD stand in for the 1P pad arrows, and F1 to F3 are test,
+ * service and coin.
+ */
+class RawInputSource : public InputSource
+{
+public:
+    RawInputSource();
+
+    const char *Name() { return "keyboard"; }
+    bool Ready() { return true; }
+    bool Register(HWND window);
+    bool Input(const RAWINPUT *input, source_change_t change, void *context);
+private:
+    unsigned int held;
+};
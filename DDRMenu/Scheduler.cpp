@@ -0,0 +1,89 @@
+#include "Scheduler.h"
+#include "Clock.h"
+
+Scheduler::Scheduler(unsigned int tickRate)
+{
+    SetTickRate(tickRate);
+
+    started = ClockMicroseconds();
+    startedCpu = ClockProcessMicroseconds();
+    deadline = started;
+    tickStart = started;
+    busy = 0;
+    ticks = 0;
+}
+
+void Scheduler::SetTickRate(unsigned int tickRate)
+{
+    interval = 1000000 / (tickRate > 0 ? tickRate : MENU_TICK_RATE_HZ);
+}
+
+void Scheduler::BeginTick(unsigned long long now)
+{
+    tickStart = now;
+    ticks++;
+
+    /* Only move the deadline when we got here because of it. If input or a
+       window message woke us up early, the regular tick is still due. */
+    if (now >= deadline)
+    {
+        deadline += interval;
+        if (deadline <= now)
+        {
+            /* Fell behind, don't try to catch up on missed ticks */
+            deadline = now + interval;
+        }
+    }
+}
+
+void Scheduler::EndTick(unsigned long long now)
+{
+    busy += now - tickStart;
+}
+
+unsigned long long Scheduler::MicrosecondsUntilNextTick(unsigned long long now)
+{
+    return deadline > now ? deadline - now : 0;
+}
+
+unsigned int Scheduler::MillisecondsUntilNextTick(unsigned long long now)
+{
+    /* Round up, waking early just means spinning until the deadline */
+    return (unsigned int)((MicrosecondsUntilNextTick(now) + 999) / 1000);
+}
+
+double Scheduler::LoopUsage(unsigned long long now)
+{
+    /* Fraction of wall time the main loop spent doing work instead of waiting */
+    if (now <= started)
+    {
+        return 0.0;
+    }
+    return (double)busy / (double)(now - started);
+}
+
+double Scheduler::CpuUsage(unsigned long long now)
+{
+    /* Fraction of one core the whole process used, background threads included */
+    if (now <= started)
+    {
+        return 0.0;
+    }
+    return (double)(ClockProcessMicroseconds() - startedCpu) / (double)(now - started);
+}
+
+void Scheduler::Dump(FILE *fp)
+{
+    unsigned long long now = ClockMicroseconds();
+    unsigned long long elapsed = now - started;
+
+    fprintf(
+        fp,
+        "scheduler: %u ticks in %llu ms (%.1f Hz), loop busy %.1f%%, process cpu %.1f%%\n",
+        ticks,
+        elapsed / 1000,
+        elapsed > 0 ? (ticks * 1000000.0) / elapsed : 0.0,
+        LoopUsage(now) * 100.0,
+        CpuUsage(now) * 100.0
+    );
+}
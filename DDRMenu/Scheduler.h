@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdio.h>
+
+/* How often the main loop runs when nothing else wakes it up */
+#define MENU_TICK_RATE_HZ 60
+
+/**
+ * Works out how long the main loop can sleep between ticks, and keeps track
+ * of how much time it actually spends busy. This only does the bookkeeping,
+ * waiting is left to the caller so it can also wake up on input or window
+ * messages.
+ */
+class Scheduler
+{
+public:
+    Scheduler(unsigned int tickRate = MENU_TICK_RATE_HZ);
+
+    void SetTickRate(unsigned int tickRate);
+    void BeginTick(unsigned long long now);
+    void EndTick(unsigned long long now);
+
+    unsigned long long MicrosecondsUntilNextTick(unsigned long long now);
+    unsigned int MillisecondsUntilNextTick(unsigned long long now);
+
+    unsigned int Ticks() { return ticks; }
+    double LoopUsage(unsigned long long now);
+    double CpuUsage(unsigned long long now);
+
+    void Dump(FILE *fp);
+private:
+    unsigned long long interval;
+    unsigned long long deadline;
+    unsigned long long tickStart;
+    unsigned long long busy;
+    unsigned long long started;
+    unsigned long long startedCpu;
+    unsigned int ticks;
+};
@@ -0,0 +1,217 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ScriptedBackend.h"
+#include "IO.h"
+#include "Clock.h"
+
+typedef struct
+{
+    const char *name;
+    unsigned int button;
+} button_name_t;
+
+static const button_name_t buttonNames[] = {
+    { "1P_UP", BUTTON_1P_UP },
+    { "1P_DOWN", BUTTON_1P_DOWN },
+    { "1P_LEFT", BUTTON_1P_LEFT },
+    { "1P_RIGHT", BUTTON_1P_RIGHT },
+    { "2P_UP", BUTTON_2P_UP },
+    { "2P_DOWN", BUTTON_2P_DOWN },
+    { "2P_LEFT", BUTTON_2P_LEFT },
+    { "2P_RIGHT", BUTTON_2P_RIGHT },
+    { "1P_MENUUP", BUTTON_1P_MENUUP },
+    { "1P_MENUDOWN", BUTTON_1P_MENUDOWN },
+    { "1P_MENULEFT", BUTTON_1P_MENULEFT },
+    { "1P_MENURIGHT", BUTTON_1P_MENURIGHT },
+    { "2P_MENUUP", BUTTON_2P_MENUUP },
+    { "2P_MENUDOWN", BUTTON_2P_MENUDOWN },
+    { "2P_MENULEFT", BUTTON_2P_MENULEFT },
+    { "2P_MENURIGHT", BUTTON_2P_MENURIGHT },
+    { "1P_START", BUTTON_1P_START },
+    { "2P_START", BUTTON_2P_START },
+    { "TEST", BUTTON_TEST },
+    { "SERVICE", BUTTON_SERVICE },
+    { "COIN", BUTTON_COIN },
+};
+
+ScriptedBackend::ScriptedBackend()
+{
+    stepCount = 0;
+    cursor = 0;
+    lightCount = 0;
+    cablights = 0;
+    padlights = 0;
+    start = ClockMicroseconds();
+}
+
+bool ScriptedBackend::Load(const _TCHAR *path)
+{
+    MappedFile file;
+    if (!file.Open(path))
+    {
+        return false;
+    }
+
+    Parse(file.Data(), file.Length());
+    return true;
+}
+
+void ScriptedBackend::Parse(const char *data, unsigned int length)
+{
+    const char *end = data + length;
+    const char *line = data;
+    unsigned int lineNumber = 0;
+
+    while (line < end)
+    {
+        const char *eol = (const char *)memchr(line, '\n', end - line);
+        if (eol == NULL)
+        {
+            eol = end;
+        }
+        lineNumber++;
+
+        /* Work on a terminated copy so we can use strtoul and friends */
+        char buffer[512];
+        unsigned int buflen = (unsigned int)(eol - line);
+        if (buflen >= sizeof(buffer))
+        {
+            fprintf(stderr, "Script line %u is too long, skipping!\n", lineNumber);
+            line = eol + 1;
+            continue;
+        }
+        memcpy(buffer, line, buflen);
+        buffer[buflen] = 0;
+        line = eol + 1;
+
+        /* Strip comments */
+        char *comment = strchr(buffer, '#');
+        if (comment != NULL)
+        {
+            *comment = 0;
+        }
+
+        char *token = strtok(buffer, " \t\r");
+        if (token == NULL)
+        {
+            continue;
+        }
+
+        unsigned long long milliseconds = strtoul(token, NULL, 10);
+        unsigned int buttons = 0;
+
+        while ((token = strtok(NULL, " \t\r|")) != NULL)
+        {
+            if (token[0] == '0' && (token[1] == 'x' || token[1] == 'X'))
+            {
+                buttons |= strtoul(token, NULL, 16);
+                continue;
+            }
+
+            bool found = false;
+            for (unsigned int i = 0; i < sizeof(buttonNames) / sizeof(buttonNames[0]); i++)
+            {
+                if (strcmp(token, buttonNames[i].name) == 0)
+                {
+                    buttons |= buttonNames[i].button;
+                    found = true;
+                    break;
+                }
+            }
+
+            if (!found)
+            {
+                fprintf(stderr, "Unknown button %s on script line %u!\n", token, lineNumber);
+            }
+        }
+
+        Add(milliseconds, buttons);
+    }
+}
+
+void ScriptedBackend::Add(unsigned long long milliseconds, unsigned int buttons)
+{
+    script_step_t *previous = stepCount > 0 ? (script_step_t *)steps.Get((stepCount - 1) * sizeof(script_step_t)) : NULL;
+    unsigned long long time = milliseconds * 1000;
+
+    /* Playback walks forward only, so steps must be in order */
+    if (previous != NULL && time < previous->time)
+    {
+        fprintf(stderr, "Script step at %llu ms is out of order!\n", milliseconds);
+        time = previous->time;
+    }
+
+    script_step_t *step = (script_step_t *)steps.Get(steps.Allocate(sizeof(script_step_t)));
+    step->time = time;
+    step->buttons = buttons;
+    stepCount++;
+}
+
+unsigned int ScriptedBackend::PollButtons()
+{
+    const script_step_t *timeline = (const script_step_t *)steps.Base();
+    unsigned long long elapsed = ClockMicroseconds() - start;
+
+    if (stepCount == 0 || elapsed < timeline[0].time)
+    {
+        return 0;
+    }
+
+    /* Only the polling thread moves the cursor */
+    while (cursor + 1 < stepCount && timeline[cursor + 1].time <= elapsed)
+    {
+        cursor++;
+    }
+
+    return timeline[cursor].buttons;
+}
+
+void ScriptedBackend::SetCabLights(unsigned int newCablights)
+{
+    cablights = newCablights;
+    RecordLights();
+}
+
+void ScriptedBackend::SetPadLights(unsigned int newPadlights)
+{
+    padlights = newPadlights;
+    RecordLights();
+}
+
+void ScriptedBackend::RecordLights()
+{
+    light_record_t *record = (light_record_t *)lights.Get(lights.Allocate(sizeof(light_record_t)));
+    record->time = ClockMicroseconds() - start;
+    record->cablights = cablights;
+    record->padlights = padlights;
+    lightCount++;
+}
+
+bool ScriptedBackend::Finished()
+{
+    if (stepCount == 0)
+    {
+        return true;
+    }
+
+    const script_step_t *timeline = (const script_step_t *)steps.Base();
+    return (ClockMicroseconds() - start) >= timeline[stepCount - 1].time;
+}
+
+void ScriptedBackend::DumpLights(FILE *fp)
+{
+    const light_record_t *records = Lights();
+    for (unsigned int i = 0; i < lightCount; i++)
+    {
+        fprintf(
+            fp,
+            "%llu.%03llu ms: cab %08X pad %08X\n",
+            records[i].time / 1000,
+            records[i].time % 1000,
+            records[i].cablights,
+            records[i].padlights
+        );
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdio.h>
+
+#include "IOBackend.h"
+#include "Arena.h"
+#include "MappedFile.h"
+
+typedef struct
+{
+    unsigned long long time;
+    unsigned int buttons;
+} script_step_t;
+
+typedef struct
+{
+    unsigned long long time;
+    unsigned int cablights;
+    unsigned int padlights;
+} light_record_t;
+
+/**
+ * Headless cabinet for running the menu without any hardware. Buttons are
+ * played back from a timeline, and every light change is recorded so runs
+ * can be compared. Timeline files look like this, with times in
+ * milliseconds since the backend was created:
+ *
+ * # Scroll right twice then pick a game
+ * 1000 1P_MENURIGHT
+ * 1050
+ * 1500 1P_MENURIGHT
+ * 1550
+ * 2000 1P_START
+ *
+ * Each line gives every button held from that point on. Buttons can be given
+ * by name or as a raw mask such as 0x10000.
+ */
+class ScriptedBackend : public IOBackend
+{
+public:
+    ScriptedBackend();
+
+    bool Load(const _TCHAR *path);
+    void Parse(const char *data, unsigned int length);
+    void Add(unsigned long long milliseconds, unsigned int buttons);
+
+    bool Ready() { return true; }
+    unsigned int PollButtons();
+    void SetCabLights(unsigned int cablights);
+    void SetPadLights(unsigned int padlights);
+
+    bool Finished();
+    unsigned int LightChanges() { return lightCount; }
+    const light_record_t *Lights() { return (const light_record_t *)lights.Base(); }
+    void DumpLights(FILE *fp);
+private:
+    Arena steps;
+    unsigned int stepCount;
+    unsigned int cursor;
+
+    Arena lights;
+    unsigned int lightCount;
+    unsigned int cablights;
+    unsigned int padlights;
+
+    unsigned long long start;
+
+    void RecordLights();
+};
@@ -0,0 +1,253 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "Thread.h"
+
+#ifdef _WIN32
+/* Needed for timeBeginPeriod() so short sleeps are actually short */
+#pragma comment(lib, "winmm.lib")
+#endif
+
+Thread::Thread()
+{
+    started = false;
+    func = 0;
+    param = 0;
+}
+
+Thread::~Thread()
+{
+    Join();
+}
+
+bool Thread::Start(thread_func_t threadFunc, void *threadParam)
+{
+    if (started)
+    {
+        return false;
+    }
+
+    func = threadFunc;
+    param = threadParam;
+
+#ifdef _WIN32
+    handle = CreateThread(0, 0, Entry, this, 0, 0);
+    started = handle != 0;
+#else
+    started = pthread_create(&handle, 0, Entry, this) == 0;
+#endif
+
+    return started;
+}
+
+void Thread::Join()
+{
+    if (!started)
+    {
+        return;
+    }
+
+#ifdef _WIN32
+    WaitForSingleObject(handle, INFINITE);
+    CloseHandle(handle);
+#else
+    pthread_join(handle, 0);
+#endif
+
+    started = false;
+}
+
+#ifdef _WIN32
+DWORD WINAPI Thread::Entry(LPVOID threadParam)
+{
+    Thread *thread = (Thread *)threadParam;
+    thread->func(thread->param);
+    return 0;
+}
+#else
+void *Thread::Entry(void *threadParam)
+{
+    Thread *thread = (Thread *)threadParam;
+    thread->func(thread->param);
+    return 0;
+}
+#endif
+
+Event::Event()
+{
+#ifdef _WIN32
+    handle = CreateEvent(0, FALSE, FALSE, 0);
+#else
+    pthread_mutex_init(&mutex, 0);
+    pthread_cond_init(&cond, 0);
+    signalled = false;
+#endif
+}
+
+Event::~Event()
+{
+#ifdef _WIN32
+    CloseHandle(handle);
+#else
+    pthread_cond_destroy(&cond);
+    pthread_mutex_destroy(&mutex);
+#endif
+}
+
+void Event::Set()
+{
+#ifdef _WIN32
+    SetEvent(handle);
+#else
+    pthread_mutex_lock(&mutex);
+    signalled = true;
+    pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&mutex);
+#endif
+}
+
+/**
+ * Waits up to the given time for the event, returning true if it was set.
+ */
+bool Event::Wait(unsigned int milliseconds)
+{
+#ifdef _WIN32
+    return WaitForSingleObject(handle, milliseconds) == WAIT_OBJECT_0;
+#else
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += milliseconds / 1000;
+    deadline.tv_nsec += (milliseconds % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    pthread_mutex_lock(&mutex);
+    while (!signalled)
+    {
+        if (pthread_cond_timedwait(&cond, &mutex, &deadline) != 0)
+        {
+            break;
+        }
+    }
+
+    bool wasSignalled = signalled;
+    signalled = false;
+    pthread_mutex_unlock(&mutex);
+    return wasSignalled;
+#endif
+}
+
+Mutex::Mutex()
+{
+#ifdef _WIN32
+    InitializeCriticalSection(&section);
+#else
+    pthread_mutex_init(&mutex, 0);
+#endif
+}
+
+Mutex::~Mutex()
+{
+#ifdef _WIN32
+    DeleteCriticalSection(&section);
+#else
+    pthread_mutex_destroy(&mutex);
+#endif
+}
+
+void Mutex::Lock()
+{
+#ifdef _WIN32
+    EnterCriticalSection(&section);
+#else
+    pthread_mutex_lock(&mutex);
+#endif
+}
+
+void Mutex::Unlock()
+{
+#ifdef _WIN32
+    LeaveCriticalSection(&section);
+#else
+    pthread_mutex_unlock(&mutex);
+#endif
+}
+
+void ThreadSleep(unsigned int microseconds)
+{
+#ifdef _WIN32
+    static bool period = false;
+    if (!period)
+    {
+        /* Default scheduler granularity is ~15ms, which is useless for polling */
+        timeBeginPeriod(1);
+        period = true;
+    }
+
+    /* Round up, Sleep(0) only yields and a short wait would spin the core */
+    Sleep((microseconds + 999) / 1000);
+#else
+    struct timespec duration;
+    duration.tv_sec = microseconds / 1000000;
+    duration.tv_nsec = (microseconds % 1000000) * 1000;
+    nanosleep(&duration, 0);
+#endif
+}
+
+typedef struct
+{
+    parallel_func_t func;
+    void *context;
+    unsigned int count;
+    volatile long next;
+} parallel_t;
+
+static void ParallelWorker(void *param)
+{
+    parallel_t *parallel = (parallel_t *)param;
+
+    /* Items are handed out one at a time, so one slow item doesn't hold up
+       the ones that would have been queued behind it */
+    while (true)
+    {
+        unsigned int item = (unsigned int)(AtomicIncrement(&parallel->next) - 1);
+        if (item >= parallel->count)
+        {
+            return;
+        }
+        parallel->func(parallel->context, item);
+    }
+}
+
+/**
+ * Runs func for every item and waits for all of them to finish. The calling
+ * thread does its share too, so nothing is started for a single item.
+ */
+void ParallelFor(unsigned int count, unsigned int threads, parallel_func_t func, void *context)
+{
+    parallel_t parallel;
+    parallel.func = func;
+    parallel.context = context;
+    parallel.count = count;
+    parallel.next = 0;
+
+    unsigned int helpers = threads < count ? threads : count;
+    helpers = helpers > 0 ? helpers - 1 : 0;
+
+    Thread *workers = helpers > 0 ? new Thread[helpers] : NULL;
+    for (unsigned int i = 0; i < helpers; i++)
+    {
+        workers[i].Start(ParallelWorker, &parallel);
+    }
+
+    ParallelWorker(&parallel);
+
+    /* Joins them all */
+    delete[] workers;
+}
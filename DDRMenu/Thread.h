@@ -0,0 +1,122 @@
+#pragma once
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+typedef void (*thread_func_t)(void *param);
+
+class Thread
+{
+public:
+    Thread();
+    ~Thread();
+
+    bool Start(thread_func_t func, void *param);
+    void Join();
+    bool Started() { return started; }
+private:
+#ifdef _WIN32
+    HANDLE handle;
+    static DWORD WINAPI Entry(LPVOID param);
+#else
+    pthread_t handle;
+    static void *Entry(void *param);
+#endif
+    bool started;
+    thread_func_t func;
+    void *param;
+};
+
+/**
+ * Auto-reset event, one waiter is woken per Set() and the event clears again.
+ */
+class Event
+{
+public:
+    Event();
+    ~Event();
+
+    void Set();
+    bool Wait(unsigned int milliseconds);
+
+#ifdef _WIN32
+    HANDLE Handle() { return handle; }
+#endif
+private:
+#ifdef _WIN32
+    HANDLE handle;
+#else
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool signalled;
+#endif
+};
+
+/**
+ * Plain lock, for handing over anything bigger than a single value.
+ */
+class Mutex
+{
+public:
+    Mutex();
+    ~Mutex();
+
+    void Lock();
+    void Unlock();
+private:
+#ifdef _WIN32
+    CRITICAL_SECTION section;
+#else
+    pthread_mutex_t mutex;
+#endif
+};
+
+void ThreadSleep(unsigned int microseconds);
+
+/* Runs func once for every item from 0 to count, spread over a few threads */
+typedef void (*parallel_func_t)(void *context, unsigned int item);
+void ParallelFor(unsigned int count, unsigned int threads, parallel_func_t func, void *context);
+
+/* Loads and stores that are safe to use for handing data between threads */
+inline long AtomicLoad(volatile long *value)
+{
+#ifdef _WIN32
+    long loaded = *value;
+    MemoryBarrier();
+    return loaded;
+#else
+    return __sync_fetch_and_add(value, 0);
+#endif
+}
+
+inline void AtomicStore(volatile long *value, long newvalue)
+{
+#ifdef _WIN32
+    InterlockedExchange(value, newvalue);
+#else
+    __sync_synchronize();
+    *value = newvalue;
+    __sync_synchronize();
+#endif
+}
+
+inline long AtomicIncrement(volatile long *value)
+{
+#ifdef _WIN32
+    return InterlockedIncrement(value);
+#else
+    return __sync_add_and_fetch(value, 1);
+#endif
+}
+
+inline long AtomicDecrement(volatile long *value)
+{
+#ifdef _WIN32
+    return InterlockedDecrement(value);
+#else
+    return __sync_sub_and_fetch(value, 1);
+#endif
+}
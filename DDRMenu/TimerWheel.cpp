@@ -0,0 +1,208 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "TimerWheel.h"
+
+TimerWheel::TimerWheel(unsigned long long now)
+{
+    memset(timers, 0, sizeof(timers));
+    for (unsigned int i = 0; i < TIMER_WHEEL_SLOTS; i++)
+    {
+        slots[i] = -1;
+    }
+    current = now / TIMER_WHEEL_RESOLUTION_US;
+    pass = 0;
+}
+
+/**
+ * Schedules a callback for the given ClockMicroseconds() time. Returns the
+ * timer, or -1 if there's no room for another one.
+ */
+int TimerWheel::Add(unsigned long long deadline, timer_callback_t callback, void *context)
+{
+    for (int timer = 0; timer < TIMER_MAX; timer++)
+    {
+        if (!timers[timer].used)
+        {
+            timers[timer].used = true;
+            timers[timer].deadline = deadline;
+            timers[timer].callback = callback;
+            timers[timer].context = context;
+            Link(timer);
+            return timer;
+        }
+    }
+
+    fprintf(stderr, "Too many timers scheduled at once!\n");
+    return -1;
+}
+
+void TimerWheel::Cancel(int timer)
+{
+    if (timer < 0 || timer >= TIMER_MAX || !timers[timer].used)
+    {
+        return;
+    }
+
+    /* A timer cancelling itself from its callback is already out of the wheel */
+    if (timers[timer].linked)
+    {
+        Unlink(timer);
+    }
+    timers[timer].used = false;
+}
+
+void TimerWheel::Reschedule(int timer, unsigned long long deadline)
+{
+    if (timer < 0 || timer >= TIMER_MAX || !timers[timer].used)
+    {
+        return;
+    }
+
+    if (timers[timer].linked)
+    {
+        Unlink(timer);
+    }
+    timers[timer].deadline = deadline;
+    Link(timer);
+}
+
+/**
+ * Fires every timer that is due by now. Returns how many fired.
+ */
+unsigned int TimerWheel::Advance(unsigned long long now)
+{
+    unsigned long long target = now / TIMER_WHEEL_RESOLUTION_US;
+    unsigned int fired = 0;
+
+    /* Everything linked from here on is stamped with this pass and left alone */
+    pass++;
+
+    /* After a long sleep, one trip around the wheel sees everything */
+    unsigned long long tick = current;
+    if (target >= TIMER_WHEEL_SLOTS && tick < target - TIMER_WHEEL_SLOTS + 1)
+    {
+        tick = target - TIMER_WHEEL_SLOTS + 1;
+    }
+
+    /* Anything scheduled from here on lands in the last slot or later, so
+       it's never left behind in a slot the walk has already been past. The
+       last slot stays current, it may hold timers due later in the same tick. */
+    if (target > current)
+    {
+        current = target;
+    }
+
+    for (; tick <= target; tick++)
+    {
+        unsigned int slot = (unsigned int)(tick % TIMER_WHEEL_SLOTS);
+        int timer = slots[slot];
+        while (timer >= 0)
+        {
+            /* Timers further out than one trip around wait for a later pass */
+            if (timers[timer].pass == pass || timers[timer].deadline > now)
+            {
+                timer = timers[timer].next;
+                continue;
+            }
+
+            Unlink(timer);
+            unsigned long long again = timers[timer].callback(timers[timer].context, now);
+            fired++;
+
+            /* Unless the callback already cancelled or rescheduled it itself */
+            if (timers[timer].used && !timers[timer].linked)
+            {
+                if (again != 0)
+                {
+                    timers[timer].deadline = again;
+                    Link(timer);
+                }
+                else
+                {
+                    timers[timer].used = false;
+                }
+            }
+
+            /* The callback may have moved or cancelled anything in this slot,
+               so start it over. Timers that fired are stamped and skipped. */
+            timer = slots[slot];
+        }
+    }
+
+    return fired;
+}
+
+/**
+ * Returns the soonest deadline of any timer, or 0 if none are scheduled.
+ */
+unsigned long long TimerWheel::NextDeadline()
+{
+    unsigned long long next = 0;
+
+    for (int timer = 0; timer < TIMER_MAX; timer++)
+    {
+        if (timers[timer].used && (next == 0 || timers[timer].deadline < next))
+        {
+            next = timers[timer].deadline;
+        }
+    }
+
+    return next;
+}
+
+unsigned int TimerWheel::MillisecondsUntilNext(unsigned long long now)
+{
+    unsigned long long next = NextDeadline();
+    if (next == 0)
+    {
+        return 0xFFFFFFFF;
+    }
+    if (next <= now)
+    {
+        return 0;
+    }
+
+    /* Round up so we don't wake up just before the timer is due */
+    return (unsigned int)((next - now + 999) / 1000);
+}
+
+void TimerWheel::Link(int timer)
+{
+    /* Never put a timer behind the wheel, it would wait a whole trip around */
+    unsigned long long tick = timers[timer].deadline / TIMER_WHEEL_RESOLUTION_US;
+    if (tick < current)
+    {
+        tick = current;
+    }
+
+    unsigned int slot = (unsigned int)(tick % TIMER_WHEEL_SLOTS);
+    timers[timer].slot = slot;
+    timers[timer].linked = true;
+    timers[timer].pass = pass;
+    timers[timer].prev = -1;
+    timers[timer].next = slots[slot];
+    if (slots[slot] >= 0)
+    {
+        timers[slots[slot]].prev = timer;
+    }
+    slots[slot] = timer;
+}
+
+void TimerWheel::Unlink(int timer)
+{
+    if (timers[timer].prev >= 0)
+    {
+        timers[timers[timer].prev].next = timers[timer].next;
+    }
+    else
+    {
+        slots[timers[timer].slot] = timers[timer].next;
+    }
+
+    if (timers[timer].next >= 0)
+    {
+        timers[timers[timer].next].prev = timers[timer].prev;
+    }
+    timers[timer].linked = false;
+}
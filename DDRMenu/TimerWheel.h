@@ -0,0 +1,55 @@
+#pragma once
+
+/* Each slot covers this much time, and the wheel goes round once every SLOTS of them */
+#define TIMER_WHEEL_RESOLUTION_US 1000
+#define TIMER_WHEEL_SLOTS 64
+
+/* How many timers can be waiting at once */
+#define TIMER_MAX 16
+
+/* Returns when to fire again, or 0 if the timer is done */
+typedef unsigned long long (*timer_callback_t)(void *context, unsigned long long now);
+
+typedef struct
+{
+    bool used;
+    unsigned long long deadline;
+    timer_callback_t callback;
+    void *context;
+    int next;
+    int prev;
+    unsigned int slot;
+    bool linked;
+    unsigned int pass;
+} timer_entry_t;
+
+/**
+ * Hashed timer wheel for everything the main loop has to do at a given time.
+ * Adding, cancelling and firing a timer only touches the one slot it lives
+ * in, and Advance() only walks the slots that time has passed through.
+ * Timers reschedule themselves through their callback's return value.
+ * Callbacks may also add, cancel or reschedule any timer, their own
+ * included, which wins over what they return. Each timer fires at most once
+ * per Advance(), anything scheduled while timers fire waits for the next.
+ */
+class TimerWheel
+{
+public:
+    TimerWheel(unsigned long long now);
+
+    int Add(unsigned long long deadline, timer_callback_t callback, void *context);
+    void Cancel(int timer);
+    void Reschedule(int timer, unsigned long long deadline);
+    unsigned int Advance(unsigned long long now);
+
+    unsigned long long NextDeadline();
+    unsigned int MillisecondsUntilNext(unsigned long long now);
+private:
+    timer_entry_t timers[TIMER_MAX];
+    int slots[TIMER_WHEEL_SLOTS];
+    unsigned long long current;
+    unsigned int pass;
+
+    void Link(int timer);
+    void Unlink(int timer);
+};
@@ -0,0 +1,78 @@
+#include "Viewport.h"
+
+Viewport::Viewport()
+{
+    rowHeight = 1;
+    padding = 0;
+    rows = 1;
+    count = 0;
+    first = 0;
+}
+
+/**
+ * Rows are rowHeight tall with padding between them and above the first one,
+ * and only rows that fit entirely in height pixels are shown.
+ */
+void Viewport::SetLayout(unsigned int newRowHeight, unsigned int newPadding, unsigned int height)
+{
+    rowHeight = newRowHeight;
+    padding = newPadding;
+
+    unsigned int stride = rowHeight + padding;
+    rows = height > padding ? (height - padding) / stride : 0;
+    if (rows < 1)
+    {
+        rows = 1;
+    }
+}
+
+void Viewport::SetCount(unsigned int newCount)
+{
+    count = newCount;
+
+    /* Don't leave empty space at the bottom if the list shrank */
+    if (first + rows > count)
+    {
+        first = count > rows ? count - rows : 0;
+    }
+}
+
+/**
+ * Scrolls the least amount needed to put item on screen. Returns true if the
+ * view moved and everything on screen needs to be redrawn.
+ */
+bool Viewport::ScrollTo(unsigned int item)
+{
+    unsigned int oldFirst = first;
+
+    if (item < first)
+    {
+        first = item;
+    }
+    else if (item >= first + rows)
+    {
+        first = item - rows + 1;
+    }
+
+    return first != oldFirst;
+}
+
+unsigned int Viewport::Last()
+{
+    unsigned int last = first + rows;
+    return last < count ? last : count;
+}
+
+int Viewport::RowTop(unsigned int item)
+{
+    return ((int)(rowHeight + padding) * ((int)item - (int)first)) + (int)padding;
+}
+
+unsigned int Viewport::RowAt(int y)
+{
+    if (y < 0)
+    {
+        return first;
+    }
+    return first + (y / (rowHeight + padding));
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+/**
+ * Tracks which slice of a list of fixed-height rows is on screen. Everything
+ * here is constant time, so the size of the list never matters.
+ */
+class Viewport
+{
+public:
+    Viewport();
+
+    void SetLayout(unsigned int rowHeight, unsigned int padding, unsigned int height);
+    void SetCount(unsigned int count);
+    bool ScrollTo(unsigned int item);
+
+    unsigned int First() { return first; }
+    unsigned int Last();
+    unsigned int Rows() { return rows; }
+    bool IsVisible(unsigned int item) { return item >= first && item < Last(); }
+
+    int RowTop(unsigned int item);
+    unsigned int RowAt(int y);
+private:
+    unsigned int rowHeight;
+    unsigned int padding;
+    unsigned int rows;
+    unsigned int count;
+    unsigned int first;
+};
@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "Catalog.h"
+#include "CatalogCache.h"
+#include "Test.h"
+
+/* Written next to the test binary, like the benchmark's cache */
+#define TEST_CACHE "test_catalog.cache"
+
+static void SaveCatalog(const catalog_source_t *source)
+{
+    Catalog catalog;
+    catalog.Add("game two", 8, "C:\\games\\two.bat", 16);
+    catalog.Add("Game One", 8, "C:\\games\\one.exe", 16);
+    CHECK(CatalogCacheSave(&catalog, TEST_CACHE, source));
+}
+
+/* Overwrites part of the image in place, the way a bad sector or a bug would */
+static void Corrupt(unsigned int offset, const void *data, unsigned int length)
+{
+    FILE *fp = fopen(TEST_CACHE, "r+b");
+    CHECK(fp != NULL);
+    if (fp == NULL)
+    {
+        return;
+    }
+    fseek(fp, offset, SEEK_SET);
+    fwrite(data, 1, length, fp);
+    fclose(fp);
+}
+
+static void TestRoundTrip()
+{
+    catalog_source_t source = { 1234, 5678, 0x1122334455667788ULL };
+    SaveCatalog(&source);
+
+    MappedFile *image = CatalogCacheOpen(TEST_CACHE);
+    CHECK(image != NULL);
+    if (image == NULL)
+    {
+        return;
+    }
+    CHECK(CatalogCacheMatches(image, &source, false));
+    CHECK(CatalogCacheMatches(image, &source, true));
+
+    Catalog catalog;
+    CatalogCacheAdopt(&catalog, image);
+    CHECK(catalog.Count() == 2);
+    CHECK(catalog.Order() != NULL && catalog.Order()[0] == 1 && catalog.Order()[1] == 0);
+    CHECK(strcmp(catalog.GetName(0), "game two") == 0);
+    CHECK(strcmp(catalog.GetLocation(1), "C:\\games\\one.exe") == 0);
+}
+
+static void TestBadOffsets()
+{
+    catalog_source_t source = { 1, 2, 3 };
+    unsigned int table = sizeof(catalog_cache_header_t);
+
+    /* A name past the end of the text */
+    SaveCatalog(&source);
+    launcher_program_t bad = { 0, 0x10000 };
+    Corrupt(table + sizeof(launcher_program_t), &bad, sizeof(bad));
+    CHECK(CatalogCacheOpen(TEST_CACHE) == NULL);
+
+    /* A location exactly at the end, one past the terminator */
+    SaveCatalog(&source);
+    MappedFile *image = CatalogCacheOpen(TEST_CACHE);
+    CHECK(image != NULL);
+    unsigned int textlen = image != NULL ? ((const catalog_cache_header_t *)image->Data())->textlen : 0;
+    delete image;
+    bad.location = textlen;
+    bad.name = 0;
+    Corrupt(table, &bad, sizeof(bad));
+    CHECK(CatalogCacheOpen(TEST_CACHE) == NULL);
+
+    /* A name order pointing past the last entry */
+    SaveCatalog(&source);
+    unsigned int entry = 2;
+    Corrupt(table + (2 * sizeof(launcher_program_t)), &entry, sizeof(entry));
+    CHECK(CatalogCacheOpen(TEST_CACHE) == NULL);
+}
+
+static void TestUnterminated()
+{
+    catalog_source_t source = { 1, 2, 3 };
+    SaveCatalog(&source);
+
+    /* Text that runs off the end of the image, with nothing to stop it */
+    MappedFile *image = CatalogCacheOpen(TEST_CACHE);
+    CHECK(image != NULL);
+    unsigned int length = image != NULL ? image->Length() : 0;
+    delete image;
+
+    const char junk = 'x';
+    Corrupt(length - 1, &junk, 1);
+    CHECK(CatalogCacheOpen(TEST_CACHE) == NULL);
+}
+
+int main()
+{
+    TestRoundTrip();
+    TestBadOffsets();
+    TestUnterminated();
+
+    remove(TEST_CACHE);
+    return TEST_RESULT();
+}
@@ -0,0 +1,263 @@
+#ifdef __linux__
+#include <fcntl.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include "EXTIOLink.h"
+#include "Test.h"
+#include "Thread.h"
+
+/* Lights frames the pty stand-in gets sent in one go, far more than the link can take */
+#define TEST_BURST_FRAMES 50
+
+static void TestEncodeFrame()
+{
+    unsigned char frame[EXTIO_FRAME_LENGTH];
+
+    /* The first byte always has its top bit set, the checksum never does */
+    EXTIOEncodeFrame(0x000000, frame);
+    CHECK(frame[0] == 0x80 && frame[1] == 0x00 && frame[2] == 0x00 && frame[3] == 0x00);
+
+    EXTIOEncodeFrame(0x7F7F7F, frame);
+    CHECK(frame[0] == 0xFF && frame[1] == 0x7F && frame[2] == 0x7F);
+    CHECK(frame[3] == ((0xFF + 0x7F + 0x7F) & 0x7F));
+}
+
+static void TestAcks()
+{
+    EXTIOLink link;
+    unsigned char buffer[EXTIO_FRAME_LENGTH];
+    const unsigned char ack = EXTIO_ACK;
+
+    CHECK(link.Idle());
+    CHECK(link.Encode(buffer, sizeof(buffer), 0) == 0);
+
+    /* Too small a buffer sends nothing and keeps the frame */
+    link.Submit(0x010203);
+    CHECK(link.Encode(buffer, EXTIO_FRAME_LENGTH - 1, 0) == 0);
+    CHECK(link.Encode(buffer, sizeof(buffer), 1000) == EXTIO_FRAME_LENGTH);
+    CHECK(buffer[1] == 0x02 && buffer[2] == 0x01);
+    CHECK(!link.Idle());
+
+    link.Submit(0x040506);
+    CHECK(link.Encode(buffer, sizeof(buffer), 3000) == EXTIO_FRAME_LENGTH);
+    CHECK(link.Outstanding() == 2);
+
+    /* Acks retire frames oldest first, and latency is measured from each one's send */
+    CHECK(link.Receive(&ack, 1, 6000) == 1);
+    CHECK(link.Outstanding() == 1);
+    CHECK(link.AckLatency()->Count() == 1 && link.AckLatency()->Max() == 5000);
+
+    /* Line noise isn't an ack */
+    const unsigned char noise[3] = { 0x00, EXTIO_ACK, 0x55 };
+    CHECK(link.Receive(noise, sizeof(noise), 7000) == 1);
+    CHECK(link.Malformed() == 2);
+    CHECK(link.AckLatency()->Count() == 2 && link.AckLatency()->Max() == 5000);
+    CHECK(link.Idle());
+
+    /* An ack with nothing out is ignored */
+    CHECK(link.Receive(&ack, 1, 8000) == 0);
+    CHECK(link.Acked() == 2);
+    CHECK(link.Sent() == 2);
+    CHECK(link.Dropped() == 0);
+    CHECK(link.Timeouts() == 0);
+}
+
+static void TestSaturated()
+{
+    EXTIOLink link;
+    unsigned char buffer[EXTIO_FRAME_LENGTH];
+    const unsigned char ack = EXTIO_ACK;
+
+    /* Fill the link up */
+    for (unsigned int i = 0; i < EXTIO_MAX_IN_FLIGHT; i++)
+    {
+        link.Submit(i);
+        CHECK(link.Encode(buffer, sizeof(buffer), 0) == EXTIO_FRAME_LENGTH);
+    }
+
+    /* While it's full, each new frame replaces the one waiting to go out */
+    link.Submit(0x111111);
+    CHECK(link.Encode(buffer, sizeof(buffer), 0) == 0);
+    link.Submit(0x222222);
+    link.Submit(0x333333);
+    CHECK(link.Encode(buffer, sizeof(buffer), 0) == 0);
+    CHECK(link.Dropped() == 2);
+
+    /* Once an ack makes room, only the newest frame goes */
+    CHECK(link.Receive(&ack, 1, 10) == 1);
+    CHECK(link.Encode(buffer, sizeof(buffer), 10) == EXTIO_FRAME_LENGTH);
+    CHECK(buffer[1] == 0x33 && buffer[2] == 0x33);
+    CHECK(link.Encode(buffer, sizeof(buffer), 10) == 0);
+
+    CHECK(link.Sent() == EXTIO_MAX_IN_FLIGHT + 1);
+    CHECK(link.Dropped() == 2);
+}
+
+static void TestTimeout()
+{
+    EXTIOLink link;
+    unsigned char buffer[EXTIO_FRAME_LENGTH];
+    const unsigned char ack = EXTIO_ACK;
+
+    link.Submit(1);
+    CHECK(link.Encode(buffer, sizeof(buffer), 1000) == EXTIO_FRAME_LENGTH);
+    link.Submit(2);
+    CHECK(link.Encode(buffer, sizeof(buffer), 50000) == EXTIO_FRAME_LENGTH);
+
+    /* Just short of the timeout nothing is given up on */
+    link.Timeout(1000 + EXTIO_ACK_TIMEOUT_US - 1);
+    CHECK(link.Outstanding() == 2);
+
+    /* Each frame times out on its own clock */
+    link.Timeout(1000 + EXTIO_ACK_TIMEOUT_US);
+    CHECK(link.Outstanding() == 1);
+    CHECK(link.Timeouts() == 1);
+
+    /* With room again a new frame can go out even though the EXTIO is quiet */
+    link.Submit(3);
+    CHECK(link.Encode(buffer, sizeof(buffer), 120000) == EXTIO_FRAME_LENGTH);
+    link.Timeout(50000 + EXTIO_ACK_TIMEOUT_US);
+    CHECK(link.Outstanding() == 1);
+    CHECK(link.Timeouts() == 2);
+
+    /* The ack that does come in goes to the frame still waiting */
+    CHECK(link.Receive(&ack, 1, 130000) == 1);
+    CHECK(link.AckLatency()->Max() == 10000);
+    CHECK(link.Idle());
+
+    /* A failed port gives up on everything at once */
+    link.Submit(4);
+    CHECK(link.Encode(buffer, sizeof(buffer), 140000) == EXTIO_FRAME_LENGTH);
+    link.Fail();
+    CHECK(link.Idle());
+    CHECK(link.Timeouts() == 3);
+    CHECK(link.Acked() == 1);
+    CHECK(link.Sent() == 4);
+}
+
+#ifdef __linux__
+/**
+ * Runs the link over a pty, with the far end acking every well formed frame
+ * the way an EXTIO does, to check it holds together over a real serial
+ * style file descriptor with bytes arriving whenever they like.
+ */
+static void TestPty()
+{
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    CHECK(master >= 0);
+    if (master < 0)
+    {
+        return;
+    }
+    CHECK(grantpt(master) == 0 && unlockpt(master) == 0);
+
+    int port = open(ptsname(master), O_RDWR | O_NOCTTY | O_NONBLOCK);
+    CHECK(port >= 0);
+    if (port < 0)
+    {
+        close(master);
+        return;
+    }
+
+    /* Raw bytes both ways, same as the EXTIO's COM port */
+    struct termios settings;
+    tcgetattr(port, &settings);
+    cfmakeraw(&settings);
+    tcsetattr(port, TCSANOW, &settings);
+    fcntl(master, F_SETFL, O_NONBLOCK);
+
+    EXTIOLink link;
+    unsigned long long now = 0;
+    unsigned int submitted = 0;
+    unsigned char frame[EXTIO_FRAME_LENGTH];
+    unsigned int framelen = 0;
+    unsigned int badFrames = 0;
+
+    while (submitted < TEST_BURST_FRAMES || !link.Idle())
+    {
+        /* New lights every tick, whether or not the EXTIO kept up */
+        if (submitted < TEST_BURST_FRAMES)
+        {
+            link.Submit(0x010101 * (submitted & 0x3F));
+            submitted++;
+        }
+
+        unsigned char buffer[EXTIO_FRAME_LENGTH];
+        unsigned int length = link.Encode(buffer, sizeof(buffer), now);
+        if (length > 0)
+        {
+            CHECK(write(port, buffer, length) == (ssize_t)length);
+        }
+
+        /* The EXTIO end, which only gets round to one frame every other tick */
+        unsigned char byte;
+        if ((now / 1000) % 2 == 1)
+        {
+            while (framelen < EXTIO_FRAME_LENGTH && read(master, &byte, 1) == 1)
+            {
+                frame[framelen++] = byte;
+            }
+            if (framelen == EXTIO_FRAME_LENGTH)
+            {
+                framelen = 0;
+                if ((frame[0] & 0x80) && frame[3] == ((frame[0] + frame[1] + frame[2]) & 0x7F))
+                {
+                    byte = EXTIO_ACK;
+                    CHECK(write(master, &byte, 1) == 1);
+                }
+                else
+                {
+                    badFrames++;
+                }
+            }
+        }
+
+        unsigned char acks[16];
+        ssize_t actual = read(port, acks, sizeof(acks));
+        if (actual > 0)
+        {
+            link.Receive(acks, actual, now);
+        }
+        link.Timeout(now);
+
+        /* Give the pty a real tick too, it passes bytes along in the background */
+        ThreadSleep(1000);
+        now += 1000;
+        if (now > 10 * EXTIO_ACK_TIMEOUT_US)
+        {
+            break;
+        }
+    }
+
+    CHECK(link.Idle());
+    CHECK(badFrames == 0);
+    CHECK(link.Timeouts() == 0);
+    CHECK(link.Malformed() == 0);
+    CHECK(link.Sent() == link.Acked());
+    CHECK(link.Sent() + link.Dropped() == TEST_BURST_FRAMES);
+    CHECK(link.Dropped() > 0);
+    link.Dump(stdout);
+
+    close(port);
+    close(master);
+}
+#endif
+
+int main()
+{
+    TestEncodeFrame();
+    TestAcks();
+    TestSaturated();
+    TestTimeout();
+#ifdef __linux__
+    TestPty();
+#endif
+
+    return TEST_RESULT();
+}
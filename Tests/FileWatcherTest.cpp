@@ -0,0 +1,211 @@
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "Clock.h"
+#include "FileWatcher.h"
+#include "Test.h"
+#include "Thread.h"
+
+#define TEST_DIRECTORY_TEMPLATE "/tmp/ddrmenu watch XXXXXX"
+
+/* Far longer than a change takes to settle and be reported */
+#define TEST_CALLBACK_WAIT_MS (WATCH_SETTLE_MS * 10)
+
+/* Long enough that a callback that was going to come would have */
+#define TEST_QUIET_US (WATCH_SETTLE_MS * 3 * 1000)
+
+/* Writes in a burst land this far apart, well inside the settle time */
+#define TEST_BURST_US (WATCH_SETTLE_MS * 1000 / 4)
+
+/* Room to put any of the test's file names after it in a PATH_MAX buffer */
+#define TEST_DIRECTORY_LENGTH 256
+
+static char directory[TEST_DIRECTORY_LENGTH];
+
+typedef struct
+{
+    volatile long calls;
+    volatile long calledAt;
+} test_watch_t;
+
+static unsigned long long started;
+
+static void Changed(void *context)
+{
+    test_watch_t *watch = (test_watch_t *)context;
+    AtomicStore(&watch->calledAt, (long)((ClockMicroseconds() - started) / 1000));
+    AtomicIncrement(&watch->calls);
+}
+
+static void Path(char *path, const char *name)
+{
+    snprintf(path, PATH_MAX, "%s/%s", directory, name);
+}
+
+static void WriteFile(const char *name, const char *contents)
+{
+    char path[PATH_MAX];
+    Path(path, name);
+
+    FILE *fp = fopen(path, "w");
+    CHECK(fp != NULL);
+    if (fp != NULL)
+    {
+        fputs(contents, fp);
+        fclose(fp);
+    }
+}
+
+/* How an editor that's careful about crashes saves, a new file renamed over the old */
+static void ReplaceFile(const char *name, const char *contents)
+{
+    char path[PATH_MAX];
+    char temp[PATH_MAX];
+    Path(path, name);
+    Path(temp, ".save.tmp");
+
+    WriteFile(".save.tmp", contents);
+    CHECK(rename(temp, path) == 0);
+}
+
+static void RemoveFile(const char *name)
+{
+    char path[PATH_MAX];
+    Path(path, name);
+    unlink(path);
+}
+
+/* Waits for the watcher to have called back at least this many times in all */
+static bool WaitForCalls(test_watch_t *watch, long calls)
+{
+    unsigned long long deadline = ClockMicroseconds() + TEST_CALLBACK_WAIT_MS * 1000ULL;
+    while (AtomicLoad(&watch->calls) < calls && ClockMicroseconds() < deadline)
+    {
+        ThreadSleep(1000);
+    }
+    return AtomicLoad(&watch->calls) >= calls;
+}
+
+/* Milliseconds since the test started, comparable with calledAt */
+static long Now()
+{
+    return (long)((ClockMicroseconds() - started) / 1000);
+}
+
+/**
+ * Rewriting the INI in place, or saving over it with a rename, each call
+ * back once things have gone quiet. Other files in the same directory don't.
+ */
+static void TestRewrite()
+{
+    WriteFile("games.ini", "[Game]\nname=One\n");
+    WriteFile("notes.txt", "nothing to see\n");
+
+    char path[PATH_MAX];
+    Path(path, "games.ini");
+    test_watch_t watch = { 0, 0 };
+    FileWatcher watcher;
+    CHECK(watcher.Watch(path, Changed, &watch));
+
+    /* Rewritten in place, reported only after it has settled */
+    long written = Now();
+    WriteFile("games.ini", "[Game]\nname=Two\n");
+    CHECK(WaitForCalls(&watch, 1));
+    CHECK(AtomicLoad(&watch.calledAt) - written >= WATCH_SETTLE_MS);
+
+    /* Saved over with a rename */
+    ReplaceFile("games.ini", "[Game]\nname=Three\n");
+    CHECK(WaitForCalls(&watch, 2));
+
+    /* A burst of writes is reported once, after the last of them */
+    long last = 0;
+    for (unsigned int i = 0; i < 4; i++)
+    {
+        last = Now();
+        WriteFile("games.ini", "[Game]\nname=Four\n");
+        ThreadSleep(TEST_BURST_US);
+    }
+    CHECK(WaitForCalls(&watch, 3));
+    CHECK(AtomicLoad(&watch.calledAt) - last >= WATCH_SETTLE_MS);
+    ThreadSleep(TEST_QUIET_US);
+    CHECK(AtomicLoad(&watch.calls) == 3);
+
+    /* Neighbours, including one whose name ends the same, are ignored */
+    WriteFile("notes.txt", "still nothing\n");
+    WriteFile("old games.ini", "[Game]\nname=Old\n");
+    ThreadSleep(TEST_QUIET_US);
+    CHECK(AtomicLoad(&watch.calls) == 3);
+
+    watcher.Stop();
+
+    /* Nothing is reported once stopped */
+    WriteFile("games.ini", "[Game]\nname=Five\n");
+    ThreadSleep(TEST_QUIET_US);
+    CHECK(AtomicLoad(&watch.calls) == 3);
+
+    RemoveFile("games.ini");
+    RemoveFile("notes.txt");
+    RemoveFile("old games.ini");
+}
+
+/**
+ * A star followed by an ending watches every file with that ending,
+ * including ones that didn't exist when watching started.
+ */
+static void TestEnding()
+{
+    char path[PATH_MAX];
+    Path(path, "*.ini");
+    test_watch_t watch = { 0, 0 };
+    FileWatcher watcher;
+    CHECK(watcher.Watch(path, Changed, &watch));
+
+    WriteFile("new.ini", "[Game]\nname=New\n");
+    CHECK(WaitForCalls(&watch, 1));
+
+    WriteFile("new.txt", "not a catalog\n");
+    WriteFile("ini", "no ending at all\n");
+    ThreadSleep(TEST_QUIET_US);
+    CHECK(AtomicLoad(&watch.calls) == 1);
+
+    watcher.Stop();
+    RemoveFile("new.ini");
+    RemoveFile("new.txt");
+    RemoveFile("ini");
+}
+
+/**
+ * A directory that isn't there can't be watched, and says so.
+ */
+static void TestMissing()
+{
+    char path[PATH_MAX];
+    Path(path, "missing/games.ini");
+    test_watch_t watch = { 0, 0 };
+    FileWatcher watcher;
+    CHECK(!watcher.Watch(path, Changed, &watch));
+}
+
+int main()
+{
+    char temp[] = TEST_DIRECTORY_TEMPLATE;
+    char resolved[PATH_MAX];
+    if (mkdtemp(temp) == NULL || realpath(temp, resolved) == NULL || strlen(resolved) >= sizeof(directory))
+    {
+        fprintf(stderr, "Failed to make a directory to watch!\n");
+        return 1;
+    }
+    strcpy(directory, resolved);
+    started = ClockMicroseconds();
+
+    TestRewrite();
+    TestEnding();
+    TestMissing();
+
+    rmdir(directory);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,216 @@
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Catalog.h"
+#include "GameScanner.h"
+#include "Test.h"
+#include "Thread.h"
+
+#define TEST_DIRECTORY_TEMPLATE "/tmp/ddrmenu scan XXXXXX"
+
+/* File systems only keep times to a few milliseconds, so wait this long
+   before changing anything a scan has already seen */
+#define TEST_TICK_US 20000
+
+/* Room to put any of the test's file names after it in a PATH_MAX buffer */
+#define TEST_DIRECTORY_LENGTH 256
+#define TEST_MAX_CREATED 64
+
+static char directory[TEST_DIRECTORY_LENGTH];
+
+/* Everything made under the directory, so it can be cleaned up in reverse */
+static char *created[TEST_MAX_CREATED];
+static unsigned int createdCount = 0;
+
+static void Path(char *path, const char *name)
+{
+    snprintf(path, PATH_MAX, "%s/%s", directory, name);
+}
+
+static void Created(const char *path)
+{
+    if (createdCount < TEST_MAX_CREATED)
+    {
+        created[createdCount] = (char *)malloc(strlen(path) + 1);
+        strcpy(created[createdCount], path);
+        createdCount++;
+    }
+}
+
+static void MakeDirectory(const char *name)
+{
+    char path[PATH_MAX];
+    Path(path, name);
+    CHECK(mkdir(path, 0755) == 0);
+    Created(path);
+}
+
+static void MakeFile(const char *name)
+{
+    char path[PATH_MAX];
+    Path(path, name);
+
+    FILE *fp = fopen(path, "w");
+    CHECK(fp != NULL);
+    if (fp != NULL)
+    {
+        fputs("@echo off\n", fp);
+        fclose(fp);
+    }
+    Created(path);
+}
+
+static void RemoveAll()
+{
+    while (createdCount > 0)
+    {
+        createdCount--;
+        remove(created[createdCount]);
+        free(created[createdCount]);
+    }
+}
+
+static void AddRoot(GameScanner *scanner, const char *name)
+{
+    char path[PATH_MAX];
+    Path(path, name);
+    CHECK(scanner->AddRoot(path, strlen(path)));
+}
+
+/* Which file the cache is, so a rewrite shows up as a new one */
+static ino_t CacheFile(const char *path)
+{
+    struct stat info;
+    return stat(path, &info) == 0 ? info.st_ino : 0;
+}
+
+static bool HasEntry(Catalog *catalog, unsigned int entry, const char *name, const char *location)
+{
+    char path[PATH_MAX];
+    Path(path, location);
+    return entry < catalog->Count() &&
+           strcmp(catalog->GetName(entry), name) == 0 &&
+           strcmp(catalog->GetLocation(entry), path) == 0;
+}
+
+/**
+ * Lays out two roots with games of every kind, and scans them from nothing,
+ * from the cache, and again after some of them change.
+ */
+int main()
+{
+    char temp[] = TEST_DIRECTORY_TEMPLATE;
+    char resolved[PATH_MAX];
+    if (mkdtemp(temp) == NULL || realpath(temp, resolved) == NULL || strlen(resolved) >= sizeof(directory))
+    {
+        fprintf(stderr, "Failed to make a directory to scan!\n");
+        return 1;
+    }
+    strcpy(directory, resolved);
+
+    MakeDirectory("arcade");
+    MakeDirectory("arcade/Alpha");
+    MakeDirectory("arcade/Alpha/contents");
+    MakeFile("arcade/Alpha/contents/gamestart.bat");
+    MakeDirectory("arcade/beta");
+    MakeFile("arcade/beta/gamestart.bat");
+    MakeDirectory("arcade/Delta");
+    MakeDirectory("arcade/Delta/contents");
+    MakeFile("arcade/Delta/contents/gamestart.bat");
+    MakeFile("arcade/Delta/gamestart.bat");
+    MakeDirectory("arcade/Gamma");
+    MakeFile("arcade/notes.txt");
+    MakeDirectory("extra");
+    MakeDirectory("extra/Epsilon");
+    MakeFile("extra/Epsilon/gamestart.bat");
+
+    char cache[PATH_MAX];
+    Path(cache, "scan.cache");
+    Created(cache);
+
+    GameScanner scanner;
+    AddRoot(&scanner, "arcade");
+    AddRoot(&scanner, "extra/");
+    AddRoot(&scanner, "missing");
+    CHECK(scanner.Roots() == 3);
+
+    /* Games come out per root in name order, each with its best script */
+    scanner.Scan(cache);
+    CHECK(scanner.Found() == 4);
+    CHECK(CacheFile(cache) != 0);
+
+    Catalog catalog;
+    scanner.AddTo(&catalog);
+    CHECK(catalog.Count() == 4);
+    CHECK(HasEntry(&catalog, 0, "Alpha", "arcade/Alpha/contents/gamestart.bat"));
+    CHECK(HasEntry(&catalog, 1, "beta", "arcade/beta/gamestart.bat"));
+    CHECK(HasEntry(&catalog, 2, "Delta", "arcade/Delta/contents/gamestart.bat"));
+    CHECK(HasEntry(&catalog, 3, "Epsilon", "extra/Epsilon/gamestart.bat"));
+
+    /* Entries already in the catalog win, matched by name or by location */
+    char location[PATH_MAX];
+    Path(location, "arcade/beta/gamestart.bat");
+    Catalog written;
+    written.Add("ALPHA", 5, "C:\\Games\\alpha.bat", 18);
+    written.Add("Beta Mix", 8, location, strlen(location));
+    scanner.AddTo(&written);
+    CHECK(written.Count() == 4);
+    CHECK(HasEntry(&written, 2, "Delta", "arcade/Delta/contents/gamestart.bat"));
+    CHECK(HasEntry(&written, 3, "Epsilon", "extra/Epsilon/gamestart.bat"));
+
+    /* Nothing changed, so it all comes from the cache, which isn't rewritten */
+    ino_t first = CacheFile(cache);
+    scanner.Scan(cache);
+    CHECK(scanner.Found() == 4);
+    CHECK(CacheFile(cache) == first);
+
+    /* A script turning up in a game's own directory, and one going from
+       a contents directory, are both noticed */
+    ThreadSleep(TEST_TICK_US);
+    MakeFile("arcade/Gamma/gamestart.bat");
+    char removed[PATH_MAX];
+    Path(removed, "arcade/Alpha/contents/gamestart.bat");
+    CHECK(unlink(removed) == 0);
+    scanner.Scan(cache);
+    CHECK(scanner.Found() == 4);
+    CHECK(CacheFile(cache) != first);
+
+    Catalog changed;
+    scanner.AddTo(&changed);
+    CHECK(changed.Count() == 4);
+    CHECK(HasEntry(&changed, 2, "Gamma", "arcade/Gamma/gamestart.bat"));
+
+    /* So is a whole new game under a root */
+    ThreadSleep(TEST_TICK_US);
+    MakeDirectory("extra/Zeta");
+    MakeDirectory("extra/Zeta/contents");
+    MakeFile("extra/Zeta/contents/gamestart.bat");
+    scanner.Scan(cache);
+    CHECK(scanner.Found() == 5);
+
+    /* A cache that makes no sense is thrown away and everything scanned */
+    FILE *fp = fopen(cache, "wb");
+    CHECK(fp != NULL);
+    if (fp != NULL)
+    {
+        fputs("not a scan cache at all, just some text", fp);
+        fclose(fp);
+    }
+    scanner.Scan(cache);
+    CHECK(scanner.Found() == 5);
+
+    GameScanner fresh;
+    AddRoot(&fresh, "arcade");
+    AddRoot(&fresh, "extra");
+    fresh.Scan(cache);
+    CHECK(fresh.Found() == 5);
+
+    RemoveAll();
+    rmdir(directory);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,281 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "Clock.h"
+#include "IO.h"
+#include "InputMux.h"
+#include "ScriptedBackend.h"
+#include "Test.h"
+
+/* Far longer than anything written to a pipe takes to show up */
+#define TEST_WAIT_US 1000000
+#define TEST_TIMEOUT_US 20000
+
+#define TEST_MAX_CHANGES 16
+
+/**
+ * A source fed through a pipe, so the test can hold buttons down on it. Each
+ * write is one change, the buttons held from then on.
+ */
+class PipeSource : public InputSource
+{
+public:
+    PipeSource(const char *name, bool open = true)
+    {
+        this->name = name;
+        fds[0] = -1;
+        fds[1] = -1;
+        if (open && pipe(fds) == 0)
+        {
+            fcntl(fds[0], F_SETFL, O_NONBLOCK);
+        }
+    }
+
+    ~PipeSource()
+    {
+        Unplug();
+        if (fds[0] >= 0)
+        {
+            close(fds[0]);
+        }
+    }
+
+    const char *Name() { return name; }
+    bool Ready() { return fds[0] >= 0; }
+    int Descriptor() { return fds[0]; }
+
+    void Read(source_change_t change, void *context)
+    {
+        unsigned int held;
+        while (read(fds[0], &held, sizeof(held)) == sizeof(held))
+        {
+            change(context, held, ClockMicroseconds());
+        }
+    }
+
+    void Hold(unsigned int buttons)
+    {
+        CHECK(write(fds[1], &buttons, sizeof(buttons)) == sizeof(buttons));
+    }
+
+    void Unplug()
+    {
+        if (fds[1] >= 0)
+        {
+            close(fds[1]);
+            fds[1] = -1;
+        }
+    }
+private:
+    const char *name;
+    int fds[2];
+};
+
+/* Every change the mux handed out during a Wait() */
+typedef struct
+{
+    unsigned int count;
+    unsigned int source[TEST_MAX_CHANGES];
+    unsigned int held[TEST_MAX_CHANGES];
+} test_changes_t;
+
+static void Changed(void *context, unsigned int source, unsigned int held, unsigned long long when)
+{
+    test_changes_t *changes = (test_changes_t *)context;
+    if (changes->count < TEST_MAX_CHANGES)
+    {
+        changes->source[changes->count] = source;
+        changes->held[changes->count] = held;
+    }
+    changes->count++;
+}
+
+static void Wait(InputMux *mux, test_changes_t *changes, unsigned long long microseconds)
+{
+    memset(changes, 0, sizeof(*changes));
+    mux->Wait(microseconds, Changed, changes);
+}
+
+/**
+ * Two sources holding different buttons come out merged, and letting go on
+ * one leaves the other's held.
+ */
+static void TestMerge()
+{
+    InputMux mux;
+    PipeSource *keyboard = new PipeSource("keyboard");
+    PipeSource *gamepad = new PipeSource("gamepad");
+    CHECK(mux.Add(keyboard) && mux.Add(gamepad));
+    CHECK(mux.Count() == 2);
+    CHECK(strcmp(mux.Name(1), "gamepad") == 0);
+    CHECK(mux.Open());
+
+    test_changes_t changes;
+    keyboard->Hold(BUTTON_1P_MENULEFT);
+    Wait(&mux, &changes, TEST_WAIT_US);
+    CHECK(changes.count == 1);
+    CHECK(changes.source[0] == 0 && changes.held[0] == BUTTON_1P_MENULEFT);
+
+    gamepad->Hold(BUTTON_1P_START);
+    Wait(&mux, &changes, TEST_WAIT_US);
+    CHECK(changes.count == 1);
+    CHECK(changes.source[0] == 1 && changes.held[0] == (BUTTON_1P_MENULEFT | BUTTON_1P_START));
+
+    /* Both holding the same button still only lets go once both have */
+    gamepad->Hold(BUTTON_1P_START | BUTTON_1P_MENULEFT);
+    Wait(&mux, &changes, TEST_WAIT_US);
+    keyboard->Hold(0);
+    Wait(&mux, &changes, TEST_WAIT_US);
+    CHECK(changes.count == 1);
+    CHECK(changes.source[0] == 0 && changes.held[0] == (BUTTON_1P_MENULEFT | BUTTON_1P_START));
+
+    gamepad->Hold(0);
+    Wait(&mux, &changes, TEST_WAIT_US);
+    CHECK(changes.count == 1 && changes.held[0] == 0);
+}
+
+/**
+ * A tap that comes and goes between wakeups is still handed over, every
+ * change in the order it happened.
+ */
+static void TestEveryChange()
+{
+    InputMux mux;
+    PipeSource *keyboard = new PipeSource("keyboard");
+    PipeSource *gamepad = new PipeSource("gamepad");
+    mux.Add(keyboard);
+    mux.Add(gamepad);
+    CHECK(mux.Open());
+
+    gamepad->Hold(BUTTON_2P_START);
+    test_changes_t changes;
+    Wait(&mux, &changes, TEST_WAIT_US);
+
+    keyboard->Hold(BUTTON_1P_MENURIGHT);
+    keyboard->Hold(0);
+    keyboard->Hold(BUTTON_1P_MENURIGHT);
+    keyboard->Hold(0);
+    Wait(&mux, &changes, TEST_WAIT_US);
+    CHECK(changes.count == 4);
+    for (unsigned int i = 0; i < 4 && i < changes.count; i++)
+    {
+        unsigned int tapped = (i % 2) == 0 ? BUTTON_1P_MENURIGHT : 0;
+        CHECK(changes.source[i] == 0 && changes.held[i] == (tapped | BUTTON_2P_START));
+    }
+}
+
+/**
+ * With nothing to read the wait runs its full length, and an unplugged
+ * source lets go of its buttons and is never waited on again.
+ */
+static void TestUnplug()
+{
+    InputMux mux;
+    PipeSource *keyboard = new PipeSource("keyboard");
+    PipeSource *gamepad = new PipeSource("gamepad");
+    mux.Add(keyboard);
+    mux.Add(gamepad);
+    CHECK(mux.Open());
+
+    test_changes_t changes;
+    unsigned long long start = ClockMicroseconds();
+    Wait(&mux, &changes, TEST_TIMEOUT_US);
+    CHECK(changes.count == 0);
+    CHECK(ClockMicroseconds() - start >= TEST_TIMEOUT_US);
+
+    keyboard->Hold(BUTTON_1P_UP);
+    gamepad->Hold(BUTTON_1P_START);
+    Wait(&mux, &changes, TEST_WAIT_US);
+    if (changes.count < 2)
+    {
+        Wait(&mux, &changes, TEST_WAIT_US);
+    }
+
+    keyboard->Unplug();
+    Wait(&mux, &changes, TEST_WAIT_US);
+    CHECK(changes.count == 1);
+    CHECK(changes.source[0] == 0 && changes.held[0] == BUTTON_1P_START);
+
+    /* A hung up pipe is always readable, so this would return straight
+       away if it were still being watched */
+    start = ClockMicroseconds();
+    Wait(&mux, &changes, TEST_TIMEOUT_US);
+    CHECK(changes.count == 0);
+    CHECK(ClockMicroseconds() - start >= TEST_TIMEOUT_US);
+
+    /* The one left still works */
+    gamepad->Hold(0);
+    Wait(&mux, &changes, TEST_WAIT_US);
+    CHECK(changes.count == 1 && changes.source[0] == 1 && changes.held[0] == 0);
+}
+
+/**
+ * Sources that didn't open, or that there's no room for, are turned away.
+ */
+static void TestAdd()
+{
+    InputMux mux;
+    CHECK(!mux.Add(new PipeSource("closed", false)));
+
+    for (unsigned int i = 0; i < INPUT_MAX_SOURCES; i++)
+    {
+        CHECK(mux.Add(new PipeSource("spare")));
+    }
+    CHECK(!mux.Add(new PipeSource("extra")));
+    CHECK(mux.Count() == INPUT_MAX_SOURCES);
+}
+
+/**
+ * The IO merges what the sources hold with what the cabinet does.
+ */
+static void TestIO()
+{
+    ScriptedBackend *backend = new ScriptedBackend();
+    backend->Add(0, BUTTON_1P_MENURIGHT);
+
+    InputMux *mux = new InputMux();
+    PipeSource *keyboard = new PipeSource("keyboard");
+    PipeSource *gamepad = new PipeSource("gamepad");
+    mux->Add(keyboard);
+    mux->Add(gamepad);
+    IO *io = new IO(backend, mux);
+
+    keyboard->Hold(BUTTON_1P_START);
+    gamepad->Hold(BUTTON_TEST);
+
+    unsigned int wanted = BUTTON_1P_MENURIGHT | BUTTON_1P_START | BUTTON_TEST;
+    unsigned int pressed = 0;
+    unsigned long long deadline = ClockMicroseconds() + TEST_WAIT_US;
+    while (io->ButtonsHeld() != wanted && ClockMicroseconds() < deadline)
+    {
+        io->InputEvent()->Wait(TEST_WAIT_US / 1000);
+        io->Tick();
+        pressed |= io->ButtonsPressed();
+    }
+    CHECK(io->ButtonsHeld() == wanted);
+    CHECK(pressed == wanted);
+
+    keyboard->Hold(0);
+    deadline = ClockMicroseconds() + TEST_WAIT_US;
+    while (io->ButtonsHeld() != (BUTTON_1P_MENURIGHT | BUTTON_TEST) && ClockMicroseconds() < deadline)
+    {
+        io->InputEvent()->Wait(TEST_WAIT_US / 1000);
+        io->Tick();
+    }
+    CHECK(io->ButtonsHeld() == (BUTTON_1P_MENURIGHT | BUTTON_TEST));
+
+    delete io;
+}
+
+int main()
+{
+    TestMerge();
+    TestEveryChange();
+    TestUnplug();
+    TestAdd();
+    TestIO();
+
+    return TEST_RESULT();
+}
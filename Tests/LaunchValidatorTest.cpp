@@ -0,0 +1,100 @@
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "Catalog.h"
+#include "Clock.h"
+#include "LaunchValidator.h"
+#include "Test.h"
+#include "Thread.h"
+
+/* Far longer than checking a handful of local files takes */
+#define TEST_VALIDATE_WAIT_MS 2000
+
+#define TEST_DIRECTORY_TEMPLATE "/tmp/ddrmenu validate XXXXXX"
+
+/* Room to put any of the test's file names after it in a PATH_MAX buffer */
+#define TEST_DIRECTORY_LENGTH 256
+
+static char directory[TEST_DIRECTORY_LENGTH];
+
+static void AddEntry(Catalog *catalog, const char *name, const char *location)
+{
+    catalog->Add(name, strlen(name), location, strlen(location));
+}
+
+static void AddFile(Catalog *catalog, const char *name, const char *contents)
+{
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", directory, name);
+
+    if (contents != NULL)
+    {
+        FILE *fp = fopen(path, "w");
+        CHECK(fp != NULL);
+        if (fp != NULL)
+        {
+            fputs(contents, fp);
+            fclose(fp);
+        }
+    }
+    AddEntry(catalog, name, path);
+}
+
+int main()
+{
+    char temp[] = TEST_DIRECTORY_TEMPLATE;
+    char resolved[PATH_MAX];
+    if (mkdtemp(temp) == NULL || realpath(temp, resolved) == NULL || strlen(resolved) >= sizeof(directory))
+    {
+        fprintf(stderr, "Failed to make a directory to validate in!\n");
+        return 1;
+    }
+    strcpy(directory, resolved);
+
+    Catalog catalog;
+    AddFile(&catalog, "game.sh", "echo game\n");
+    AddFile(&catalog, "empty.sh", "");
+    AddFile(&catalog, "gone.sh", NULL);
+    AddEntry(&catalog, "Directory", directory);
+
+    /* Command lines the launcher hands to the shell, which aren't files */
+    AddEntry(&catalog, "Arguments", "/bin/sh -c 'echo game'");
+    AddEntry(&catalog, "Bare", "true");
+    AddEntry(&catalog, "Quoted", "\"/bin/sh\" -c true");
+    AddEntry(&catalog, "Gone", "/nonexistent/game.sh --fullscreen");
+
+    LaunchValidator validator;
+    validator.Validate(&catalog);
+
+    unsigned long long deadline = ClockMicroseconds() + TEST_VALIDATE_WAIT_MS * 1000ULL;
+    while (validator.Progress() < catalog.Count() && ClockMicroseconds() < deadline)
+    {
+        ThreadSleep(1000);
+    }
+    CHECK(validator.Progress() == catalog.Count());
+
+    CHECK(validator.Status(0) == VALIDATE_OK);
+    CHECK(validator.Status(1) == VALIDATE_EMPTY);
+    CHECK(validator.Status(2) == VALIDATE_MISSING);
+    CHECK(validator.Status(3) == VALIDATE_MISSING);
+    CHECK(validator.Status(4) == VALIDATE_UNKNOWN);
+    CHECK(validator.Status(5) == VALIDATE_UNKNOWN);
+    CHECK(validator.Status(6) == VALIDATE_UNKNOWN);
+    CHECK(validator.Status(7) == VALIDATE_MISSING);
+    validator.Dump(stdout);
+    CHECK(validator.Stop(VALIDATE_STOP_MS));
+
+    const char *names[] = { "game.sh", "empty.sh" };
+    char path[PATH_MAX];
+    for (unsigned int i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+    {
+        snprintf(path, sizeof(path), "%s/%s", directory, names[i]);
+        unlink(path);
+    }
+    rmdir(directory);
+
+    return TEST_RESULT();
+}
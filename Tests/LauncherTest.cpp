@@ -0,0 +1,171 @@
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Clock.h"
+#include "Launcher.h"
+#include "Test.h"
+#include "Thread.h"
+
+/* How long a launched game gets to leave its mark */
+#define TEST_LAUNCH_WAIT_MS 2000
+
+/* Spaces in both the directory and the file name, like most install paths */
+#define TEST_DIRECTORY_TEMPLATE "/tmp/ddrmenu launch XXXXXX"
+
+/* Room to put any of the test's file names after it in a PATH_MAX buffer */
+#define TEST_DIRECTORY_LENGTH 256
+
+static char directory[TEST_DIRECTORY_LENGTH];
+
+static void WriteFile(const char *name, const char *contents, bool executable)
+{
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", directory, name);
+
+    FILE *fp = fopen(path, "w");
+    CHECK(fp != NULL);
+    if (fp == NULL)
+    {
+        return;
+    }
+    fputs(contents, fp);
+    fclose(fp);
+    chmod(path, executable ? 0755 : 0644);
+}
+
+/**
+ * Waits for a launched game to write a file, and returns its first line
+ * with the newline taken off.
+ */
+static bool ReadResult(const char *name, char *line, unsigned int length)
+{
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", directory, name);
+
+    unsigned long long deadline = ClockMicroseconds() + TEST_LAUNCH_WAIT_MS * 1000ULL;
+    while (ClockMicroseconds() < deadline)
+    {
+        FILE *fp = fopen(path, "r");
+        if (fp != NULL)
+        {
+            bool read = fgets(line, length, fp) != NULL && strchr(line, '\n') != NULL;
+            fclose(fp);
+            if (read)
+            {
+                *strchr(line, '\n') = 0;
+                unlink(path);
+                return true;
+            }
+        }
+        ThreadSleep(10000);
+    }
+
+    return false;
+}
+
+static void Launch(const char *path)
+{
+    Launcher launcher(path);
+    CHECK(launcher.WaitForRelease(NULL, LAUNCH_RELEASE_TIMEOUT_MS));
+    CHECK(launcher.Launch());
+    launcher.Dump(stdout);
+}
+
+static void TestScript()
+{
+    /* Run by the shell as a file, from its own directory */
+    WriteFile("game start.sh", "pwd -P > cwd.txt\n", false);
+    CHECK(chdir("/") == 0);
+
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/game start.sh", directory);
+    Launch(path);
+
+    char cwd[PATH_MAX];
+    CHECK(ReadResult("cwd.txt", cwd, sizeof(cwd)));
+    CHECK(strcmp(cwd, directory) == 0);
+}
+
+static void TestExecutable()
+{
+    /* Started directly, no shell in between */
+    WriteFile("run game", "#!/bin/sh\npwd -P > cwd.txt\n", true);
+    CHECK(chdir("/") == 0);
+
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/run game", directory);
+    Launch(path);
+
+    char cwd[PATH_MAX];
+    CHECK(ReadResult("cwd.txt", cwd, sizeof(cwd)));
+    CHECK(strcmp(cwd, directory) == 0);
+}
+
+static void TestCommandLine()
+{
+    /* Not a file, so the shell gets the whole line to split up */
+    char command[PATH_MAX * 2];
+    snprintf(command, sizeof(command), "echo launched with arguments > '%s/command.txt'", directory);
+    Launch(command);
+
+    char line[PATH_MAX];
+    CHECK(ReadResult("command.txt", line, sizeof(line)));
+    CHECK(strcmp(line, "launched with arguments") == 0);
+}
+
+static unsigned int releaseChecks = 0;
+
+static bool ReleasedEventually()
+{
+    return ++releaseChecks >= 3;
+}
+
+static bool NeverReleased()
+{
+    return false;
+}
+
+static void TestRelease()
+{
+    Launcher launcher("/bin/true");
+    CHECK(launcher.WaitForRelease(ReleasedEventually, LAUNCH_RELEASE_TIMEOUT_MS));
+    CHECK(releaseChecks == 3);
+
+    /* Gives up on time, but still says so */
+    unsigned long long start = ClockMicroseconds();
+    CHECK(!launcher.WaitForRelease(NeverReleased, 50));
+    unsigned long long waited = ClockMicroseconds() - start;
+    CHECK(waited >= 50000 && waited < LAUNCH_RELEASE_TIMEOUT_MS * 1000ULL);
+}
+
+int main()
+{
+    char temp[] = TEST_DIRECTORY_TEMPLATE;
+    char resolved[PATH_MAX];
+    if (mkdtemp(temp) == NULL || realpath(temp, resolved) == NULL || strlen(resolved) >= sizeof(directory))
+    {
+        fprintf(stderr, "Failed to make a directory to launch from!\n");
+        return 1;
+    }
+    strcpy(directory, resolved);
+
+    TestScript();
+    TestExecutable();
+    TestCommandLine();
+    TestRelease();
+
+    char path[PATH_MAX];
+    const char *names[] = { "game start.sh", "run game" };
+    for (unsigned int i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+    {
+        snprintf(path, sizeof(path), "%s/%s", directory, names[i]);
+        unlink(path);
+    }
+    rmdir(directory);
+
+    return TEST_RESULT();
+}
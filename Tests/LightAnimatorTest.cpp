@@ -0,0 +1,160 @@
+#include <stdio.h>
+
+#include "IO.h"
+#include "LightAnimator.h"
+#include "Test.h"
+
+/* An arbitrary start well away from zero, so nothing lines up by accident */
+#define TEST_START_US 7000000000ULL
+#define TEST_MS 1000ULL
+
+/* Menu buttons on for 100 ms, off for 50 */
+static const light_keyframe_t blinkFrames[] =
+{
+    { LIGHT_1P_MENU, 100 },
+    { 0, 50 },
+};
+static const light_timeline_t blink = LIGHT_TIMELINE(blinkFrames, LIGHT_1P_MENU);
+
+/* Pad arrows changing every millisecond, faster than the EXTIO can keep up */
+static const light_keyframe_t spinFrames[] =
+{
+    { LIGHT_1P_UP, 1 },
+    { LIGHT_1P_DOWN, 1 },
+    { LIGHT_1P_LEFT, 1 },
+};
+static const light_timeline_t spin = LIGHT_TIMELINE(spinFrames, LIGHT_1P_UP | LIGHT_1P_DOWN | LIGHT_1P_LEFT);
+
+/* Menu buttons changing every 2 ms, which the P3IO can just about take */
+static const light_keyframe_t flickerFrames[] =
+{
+    { LIGHT_2P_MENU, 2 },
+    { 0, 2 },
+};
+static const light_timeline_t flicker = LIGHT_TIMELINE(flickerFrames, LIGHT_2P_MENU);
+
+/* Copies of blink, each of which counts as a timeline of its own */
+static light_timeline_t copies[LIGHT_MAX_TRACKS];
+
+static const light_keyframe_t emptyFrames[1] = { { 0, 0 } };
+static const light_timeline_t empty = { emptyFrames, 0, 0 };
+
+/**
+ * Each keyframe shows up once its deadline passes and not before, and
+ * NextDeadline() says exactly when that is.
+ */
+static void TestKeyframes()
+{
+    LightAnimator animator;
+    CHECK(animator.NextDeadline() == 0);
+    CHECK(animator.Play(&blink, TEST_START_US));
+
+    CHECK(animator.Update(TEST_START_US));
+    CHECK(animator.Lights() == LIGHT_1P_MENU);
+    CHECK(animator.NextDeadline() == TEST_START_US + (100 * TEST_MS));
+
+    CHECK(!animator.Update(TEST_START_US + (100 * TEST_MS) - 1));
+    CHECK(animator.Lights() == LIGHT_1P_MENU);
+
+    CHECK(animator.Update(TEST_START_US + (100 * TEST_MS)));
+    CHECK(animator.Lights() == 0);
+    CHECK(animator.NextDeadline() == TEST_START_US + (150 * TEST_MS));
+
+    /* Waking up late doesn't push the timeline back */
+    CHECK(animator.Update(TEST_START_US + (160 * TEST_MS)));
+    CHECK(animator.Lights() == LIGHT_1P_MENU);
+    CHECK(animator.NextDeadline() == TEST_START_US + (250 * TEST_MS));
+}
+
+/**
+ * Sleeping through whole loops of a timeline skips them, rather than
+ * stepping through every keyframe missed.
+ */
+static void TestSleptThrough()
+{
+    LightAnimator animator;
+    animator.Play(&blink, TEST_START_US);
+    CHECK(animator.Update(TEST_START_US));
+
+    /* Seven loops and 20 ms into the off keyframe */
+    CHECK(animator.Update(TEST_START_US + (1170 * TEST_MS)));
+    CHECK(animator.Lights() == 0);
+    CHECK(animator.NextDeadline() == TEST_START_US + (1200 * TEST_MS));
+}
+
+/**
+ * Changes to a bus that's still busy are held back until it's free, then go
+ * out as whatever is latest, without holding up the other bus.
+ */
+static void TestHoldBack()
+{
+    LightAnimator animator;
+    animator.Play(&spin, TEST_START_US);
+    animator.Play(&flicker, TEST_START_US);
+
+    CHECK(animator.Update(TEST_START_US));
+    CHECK(animator.Lights() == (LIGHT_1P_UP | LIGHT_2P_MENU));
+
+    /* The pads want to move on, but the EXTIO is busy */
+    CHECK(!animator.Update(TEST_START_US + TEST_MS));
+    CHECK(animator.Lights() == (LIGHT_1P_UP | LIGHT_2P_MENU));
+    CHECK(animator.NextDeadline() == TEST_START_US + (2 * TEST_MS));
+
+    /* The P3IO is free again so the menu buttons go out, the pads still wait */
+    CHECK(animator.Update(TEST_START_US + (2 * TEST_MS)));
+    CHECK(animator.Lights() == LIGHT_1P_UP);
+    CHECK(animator.NextDeadline() == TEST_START_US + LIGHT_PAD_MIN_INTERVAL_US);
+
+    /* And the pads skip straight to the latest keyframe once they can */
+    CHECK(animator.Update(TEST_START_US + LIGHT_PAD_MIN_INTERVAL_US));
+    CHECK(animator.Lights() == LIGHT_1P_LEFT);
+    CHECK(animator.NextDeadline() == TEST_START_US + (3 * TEST_MS));
+}
+
+/**
+ * Stopping a timeline turns its lights off on the next update, playing one
+ * again restarts it, and there's only room for so many.
+ */
+static void TestPlayStop()
+{
+    LightAnimator animator;
+    CHECK(!animator.Play(&empty, TEST_START_US));
+
+    animator.Play(&blink, TEST_START_US);
+    animator.Play(&flicker, TEST_START_US);
+    CHECK(animator.Update(TEST_START_US));
+    CHECK(animator.Lights() == (LIGHT_1P_MENU | LIGHT_2P_MENU));
+
+    animator.Stop(&flicker);
+    CHECK(animator.Lights() == (LIGHT_1P_MENU | LIGHT_2P_MENU));
+    CHECK(animator.NextDeadline() == TEST_START_US + LIGHT_CAB_MIN_INTERVAL_US);
+    CHECK(animator.Update(TEST_START_US + LIGHT_CAB_MIN_INTERVAL_US));
+    CHECK(animator.Lights() == LIGHT_1P_MENU);
+
+    /* Restarting puts it back at its first keyframe from now */
+    CHECK(animator.Play(&blink, TEST_START_US + (120 * TEST_MS)));
+    CHECK(animator.NextDeadline() == TEST_START_US + (220 * TEST_MS));
+
+    animator.Stop(&blink);
+    CHECK(animator.NextDeadline() == TEST_START_US + (2 * LIGHT_CAB_MIN_INTERVAL_US));
+    CHECK(animator.Update(TEST_START_US + (121 * TEST_MS)));
+    CHECK(animator.Lights() == 0);
+    CHECK(animator.NextDeadline() == 0);
+
+    for (unsigned int i = 0; i < LIGHT_MAX_TRACKS; i++)
+    {
+        copies[i] = blink;
+        CHECK(animator.Play(&copies[i], TEST_START_US));
+    }
+    CHECK(!animator.Play(&blink, TEST_START_US));
+}
+
+int main()
+{
+    TestKeyframes();
+    TestSleptThrough();
+    TestHoldBack();
+    TestPlayStop();
+
+    return TEST_RESULT();
+}
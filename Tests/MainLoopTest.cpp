@@ -0,0 +1,190 @@
+#include <stdio.h>
+
+#include "Clock.h"
+#include "IO.h"
+#include "MainLoop.h"
+#include "Scheduler.h"
+#include "ScriptedBackend.h"
+#include "Test.h"
+#include "TimerWheel.h"
+
+/* Far longer than any of the scripts below take to play out */
+#define TEST_LOOP_WAIT_MS 5000
+
+#define TEST_ENTRIES 10
+
+/* A menu with no window, scrolled by the pad's menu buttons */
+class TestView : public MenuView
+{
+public:
+    TestView(IO *io)
+    {
+        this->io = io;
+        selected = 0;
+        ticks = 0;
+        closeAfter = 0;
+    }
+
+    void Tick()
+    {
+        ticks++;
+        if (io->ButtonPressed(BUTTON_1P_MENURIGHT))
+        {
+            selected = (selected + 1) % TEST_ENTRIES;
+        }
+        if (io->ButtonPressed(BUTTON_1P_MENULEFT))
+        {
+            selected = (selected + TEST_ENTRIES - 1) % TEST_ENTRIES;
+        }
+    }
+
+    bool WasClosed() { return closeAfter > 0 && ticks >= closeAfter; }
+    bool ShouldBootDefault() { return false; }
+    unsigned int GetSelectedItem() { return selected; }
+
+    IO *io;
+    unsigned int selected;
+    unsigned int ticks;
+    unsigned int closeAfter;
+};
+
+/**
+ * Runs the loop the way the menu does, sleeping on the input event between
+ * ticks, until it finishes or the script has long since run out.
+ */
+static void Run(MainLoop *loop, IO *io)
+{
+    unsigned long long deadline = ClockMicroseconds() + TEST_LOOP_WAIT_MS * 1000ULL;
+    while (loop->Tick())
+    {
+        if (ClockMicroseconds() >= deadline)
+        {
+            fprintf(stderr, "Main loop never finished!\n");
+            testFailures++;
+            return;
+        }
+        io->InputEvent()->Wait(loop->MillisecondsUntilNext());
+    }
+}
+
+/* Index of the first record where the lights under mask read value, from start on */
+static unsigned int FindLights(ScriptedBackend *backend, unsigned int start, unsigned int mask, unsigned int value)
+{
+    const light_record_t *records = backend->Lights();
+    for (unsigned int i = start; i < backend->LightChanges(); i++)
+    {
+        if (((records[i].cablights | records[i].padlights) & mask) == value)
+        {
+            return i;
+        }
+    }
+    return backend->LightChanges();
+}
+
+/**
+ * Scrolls a couple of entries and picks one, checking what the cabinet's
+ * lights did along the way.
+ */
+static void TestPick()
+{
+    ScriptedBackend *backend = new ScriptedBackend();
+    backend->Add(100, BUTTON_1P_MENURIGHT);
+    backend->Add(130, 0);
+    backend->Add(200, BUTTON_1P_MENURIGHT);
+    backend->Add(230, 0);
+    backend->Add(300, BUTTON_1P_MENURIGHT);
+    backend->Add(330, 0);
+    backend->Add(400, BUTTON_1P_MENULEFT);
+    backend->Add(430, 0);
+    backend->Add(600, BUTTON_1P_START);
+
+    IO *io = new IO(backend);
+    TimerWheel timers(ClockUpdate());
+    Scheduler scheduler;
+    TestView view(io);
+    MainLoop loop(io, &timers, &scheduler, &view);
+    loop.Start(ClockNow());
+
+    Run(&loop, io);
+    CHECK(loop.Chosen() == 2);
+    CHECK(backend->Finished());
+
+    /* Stopping turns everything off, one bus at a time, and that goes in
+       the record too */
+    io->Stop();
+    const light_record_t *records = backend->Lights();
+    unsigned int count = backend->LightChanges();
+    CHECK(count > 6);
+    if (count <= 6)
+    {
+        delete io;
+        return;
+    }
+    CHECK(records[count - 1].cablights == 0 && records[count - 1].padlights == 0);
+
+    /* IO clears both buses as it starts, then every pattern starts on its
+       first keyframe, the cab bus first */
+    CHECK(records[0].cablights == 0 && records[1].padlights == 0);
+    CHECK(records[2].cablights == (LIGHT_1P_MENU | LIGHT_2P_MENU | LIGHT_MARQUEE_UPPER_LEFT));
+    CHECK(records[3].padlights == (LIGHT_1P_UP | LIGHT_2P_UP | LIGHT_BASS_NEONS));
+    for (unsigned int i = 0; i < count; i++)
+    {
+        CHECK((records[i].cablights & ~LIGHT_CAB_MASK) == 0);
+        CHECK((records[i].padlights & ~LIGHT_PAD_MASK) == 0);
+    }
+
+    /* The marquee steps round every 250 ms, and never before it's due */
+    unsigned int marquee = LIGHT_MARQUEE_UPPER_LEFT | LIGHT_MARQUEE_UPPER_RIGHT | LIGHT_MARQUEE_LOWER_RIGHT | LIGHT_MARQUEE_LOWER_LEFT;
+    unsigned int right = FindLights(backend, 0, marquee, LIGHT_MARQUEE_UPPER_RIGHT);
+    unsigned int lower = FindLights(backend, right, marquee, LIGHT_MARQUEE_LOWER_RIGHT);
+    CHECK(right < count && records[right].time >= 250000);
+    CHECK(lower < count && records[lower].time >= 500000);
+
+    /* The pads sweep every 200 ms, and the neons thump twice at the start */
+    unsigned int pads = LIGHT_1P_UP | LIGHT_1P_RIGHT | LIGHT_1P_DOWN | LIGHT_1P_LEFT;
+    unsigned int sweep = FindLights(backend, 0, pads, LIGHT_1P_RIGHT);
+    CHECK(sweep < count && records[sweep].time >= 200000);
+    unsigned int off = FindLights(backend, 4, LIGHT_BASS_NEONS, 0);
+    unsigned int on = FindLights(backend, off, LIGHT_BASS_NEONS, LIGHT_BASS_NEONS);
+    CHECK(off < count && records[off].time >= 100000);
+    CHECK(on < count && records[on].time >= 200000);
+
+    /* The menu buttons stay lit for the first second, up until the stop */
+    for (unsigned int i = 2; i < count - 2; i++)
+    {
+        CHECK((records[i].cablights & (LIGHT_1P_MENU | LIGHT_2P_MENU)) == (LIGHT_1P_MENU | LIGHT_2P_MENU));
+    }
+
+    delete io;
+}
+
+/**
+ * Closing the menu stops the loop without picking anything.
+ */
+static void TestClosed()
+{
+    ScriptedBackend *backend = new ScriptedBackend();
+    backend->Add(50, BUTTON_1P_MENURIGHT);
+
+    IO *io = new IO(backend);
+    TimerWheel timers(ClockUpdate());
+    Scheduler scheduler;
+    TestView view(io);
+    view.closeAfter = 5;
+    MainLoop loop(io, &timers, &scheduler, &view);
+    loop.Start(ClockNow());
+
+    Run(&loop, io);
+    CHECK(loop.Chosen() == MAIN_LOOP_NO_ENTRY);
+    CHECK(view.ticks == 5);
+
+    delete io;
+}
+
+int main()
+{
+    TestPick();
+    TestClosed();
+
+    return TEST_RESULT();
+}
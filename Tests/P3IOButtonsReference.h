@@ -0,0 +1,119 @@
+#pragma once
+
+#include "IO.h"
+
+/**
+ * The branch per button decoder the tables replaced, exactly as it was in
+ * IO.cpp. Kept only to check the tables against and to time them against.
+ */
+static inline unsigned int P3IODecodeButtonsReference(const unsigned char *jamma)
+{
+    /* Map the return to our actual buttons */
+    unsigned int newbuttons = 0;
+
+    /* JAMMA reports active low, so lets swap relevant bytes */
+    unsigned char buttonbuf[4] = {
+        (unsigned char)(~jamma[0]),
+        (unsigned char)(~jamma[1]),
+        (unsigned char)(~jamma[2]),
+        (unsigned char)(~jamma[3])
+    };
+
+    /* 1P Pad inputs */
+    if (buttonbuf[0] & 0x02)
+    {
+        newbuttons |= BUTTON_1P_UP;
+    }
+    if (buttonbuf[0] & 0x04)
+    {
+        newbuttons |= BUTTON_1P_DOWN;
+    }
+    if (buttonbuf[0] & 0x08)
+    {
+        newbuttons |= BUTTON_1P_LEFT;
+    }
+    if (buttonbuf[0] & 0x10)
+    {
+        newbuttons |= BUTTON_1P_RIGHT;
+    }
+
+    /* 2P Pad inputs */
+    if (buttonbuf[1] & 0x02)
+    {
+        newbuttons |= BUTTON_2P_UP;
+    }
+    if (buttonbuf[1] & 0x04)
+    {
+        newbuttons |= BUTTON_2P_DOWN;
+    }
+    if (buttonbuf[1] & 0x08)
+    {
+        newbuttons |= BUTTON_2P_LEFT;
+    }
+    if (buttonbuf[1] & 0x10)
+    {
+        newbuttons |= BUTTON_2P_RIGHT;
+    }
+
+    /* 1P Menu inputs */
+    if (buttonbuf[3] & 0x01)
+    {
+        newbuttons |= BUTTON_1P_MENUUP;
+    }
+    if (buttonbuf[3] & 0x02)
+    {
+        newbuttons |= BUTTON_1P_MENUDOWN;
+    }
+    if (buttonbuf[0] & 0x40)
+    {
+        newbuttons |= BUTTON_1P_MENULEFT;
+    }
+    if (buttonbuf[0] & 0x80)
+    {
+        newbuttons |= BUTTON_1P_MENURIGHT;
+    }
+
+    /* 2P Menu inputs */
+    if (buttonbuf[3] & 0x04)
+    {
+        newbuttons |= BUTTON_2P_MENUUP;
+    }
+    if (buttonbuf[3] & 0x08)
+    {
+        newbuttons |= BUTTON_2P_MENUDOWN;
+    }
+    if (buttonbuf[1] & 0x40)
+    {
+        newbuttons |= BUTTON_2P_MENULEFT;
+    }
+    if (buttonbuf[1] & 0x80)
+    {
+        newbuttons |= BUTTON_2P_MENURIGHT;
+    }
+
+    /* Start inputs */
+    if (buttonbuf[0] & 0x01)
+    {
+        newbuttons |= BUTTON_1P_START;
+    }
+    if (buttonbuf[1] & 0x01)
+    {
+        newbuttons |= BUTTON_2P_START;
+    }
+
+    /* Cabinet buttons */
+    if (buttonbuf[2] & 0x20)
+    {
+        newbuttons |= BUTTON_COIN;
+    }
+    if (buttonbuf[2] & 0x40)
+    {
+        newbuttons |= BUTTON_SERVICE;
+    }
+    if (buttonbuf[2] & 0x10)
+    {
+        newbuttons |= BUTTON_TEST;
+    }
+
+    return newbuttons;
+}
@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "P3IOButtons.h"
+#include "P3IOButtonsReference.h"
+#include "Test.h"
+
+static bool Matches(const unsigned char *jamma)
+{
+    unsigned int tables = P3IODecodeButtons(jamma);
+    unsigned int branches = P3IODecodeButtonsReference(jamma);
+    if (tables != branches)
+    {
+        fprintf(
+            stderr,
+            "Button decode mismatch for %02X %02X %02X %02X: tables give %06X, branches give %06X!\n",
+            jamma[0],
+            jamma[1],
+            jamma[2],
+            jamma[3],
+            tables,
+            branches
+        );
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Checks every value of each byte with the other three all released and all
+ * held. This covers every input, not just a sample of them. Both decoders
+ * are an OR of one term per JAMMA byte, and each term only looks at its own
+ * byte. The tables are built that way, one lookup per byte. The branch code
+ * only ever ORs in a constant after testing one bit of one byte. With the
+ * others released their terms are zero, so the sweep shows each byte's
+ * term is the same in both. ORing equal terms then gives equal results for
+ * all four billion states. The all held pass checks the same thing against
+ * every other button pressed.
+ */
+static void TestEveryByte()
+{
+    unsigned char jamma[P3IO_JAMMA_LENGTH];
+    unsigned char released[P3IO_JAMMA_LENGTH];
+    memset(released, 0xFF, sizeof(released));
+    CHECK(P3IODecodeButtons(released) == 0);
+
+    for (unsigned int byte = 0; byte < P3IO_JAMMA_LENGTH; byte++)
+    {
+        for (unsigned int others = 0; others < 2; others++)
+        {
+            memset(jamma, others ? 0x00 : 0xFF, sizeof(jamma));
+            for (unsigned int value = 0; value < 256; value++)
+            {
+                jamma[byte] = (unsigned char)value;
+                CHECK(Matches(jamma));
+            }
+        }
+    }
+}
+
+/**
+ * Every held button comes out as its own bit, and nothing else does.
+ */
+static void TestSingleButtons()
+{
+    unsigned char jamma[P3IO_JAMMA_LENGTH];
+    unsigned int seen = 0;
+
+    for (unsigned int byte = 0; byte < P3IO_JAMMA_LENGTH; byte++)
+    {
+        for (unsigned int bit = 0; bit < 8; bit++)
+        {
+            memset(jamma, 0xFF, sizeof(jamma));
+            jamma[byte] &= ~(1u << bit);
+
+            unsigned int buttons = P3IODecodeButtons(jamma);
+            CHECK((buttons & (buttons - 1)) == 0);
+            CHECK((seen & buttons) == 0);
+            seen |= buttons;
+        }
+    }
+
+    /* And holding everything holds exactly those */
+    memset(jamma, 0x00, sizeof(jamma));
+    CHECK(P3IODecodeButtons(jamma) == seen);
+    CHECK(seen == (
+        BUTTON_1P_UP | BUTTON_1P_DOWN | BUTTON_1P_LEFT | BUTTON_1P_RIGHT |
+        BUTTON_2P_UP | BUTTON_2P_DOWN | BUTTON_2P_LEFT | BUTTON_2P_RIGHT |
+        BUTTON_1P_MENUUP | BUTTON_1P_MENUDOWN | BUTTON_1P_MENULEFT | BUTTON_1P_MENURIGHT |
+        BUTTON_2P_MENUUP | BUTTON_2P_MENUDOWN | BUTTON_2P_MENULEFT | BUTTON_2P_MENURIGHT |
+        BUTTON_1P_START | BUTTON_2P_START | BUTTON_TEST | BUTTON_SERVICE | BUTTON_COIN
+    ));
+}
+
+/**
+ * Tries all four billion states, for when the argument above is in doubt.
+ * Takes a while, so only when asked for.
+ */
+static void TestExhaustive()
+{
+    unsigned char jamma[P3IO_JAMMA_LENGTH];
+    unsigned int state = 0;
+    do
+    {
+        jamma[0] = (unsigned char)state;
+        jamma[1] = (unsigned char)(state >> 8);
+        jamma[2] = (unsigned char)(state >> 16);
+        jamma[3] = (unsigned char)(state >> 24);
+        if (!Matches(jamma))
+        {
+            testFailures++;
+            return;
+        }
+    } while (++state != 0);
+}
+
+int main(int argc, char *argv[])
+{
+    TestEveryByte();
+    TestSingleButtons();
+    if (argc > 1 && strcmp(argv[1], "--exhaustive") == 0)
+    {
+        TestExhaustive();
+    }
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,219 @@
+#include <string.h>
+
+#include "P3IOFrame.h"
+#include "Test.h"
+
+/* Sized so the 16 byte SSE2 chunks and the leftover bytes both get a turn */
+#define TEST_SCAN_LENGTH 80
+
+/* Payloads every frame test is run against */
+#define PATTERN_ZERO 0
+#define PATTERN_RAMP 1
+#define PATTERN_SOM 2
+#define PATTERN_ESCAPE 3
+#define PATTERN_ALTERNATE 4
+#define PATTERN_RANDOM 5
+#define PATTERN_COUNT 6
+
+static void FillPayload(unsigned char *payload, unsigned int length, unsigned int pattern)
+{
+    unsigned int seed = 12345 + length;
+    for (unsigned int i = 0; i < length; i++)
+    {
+        switch (pattern)
+        {
+            case PATTERN_ZERO:
+                payload[i] = 0;
+                break;
+            case PATTERN_RAMP:
+                payload[i] = (unsigned char)i;
+                break;
+            case PATTERN_SOM:
+                payload[i] = P3IO_SOM;
+                break;
+            case PATTERN_ESCAPE:
+                payload[i] = P3IO_ESCAPE;
+                break;
+            case PATTERN_ALTERNATE:
+                payload[i] = (i & 1) ? P3IO_ESCAPE : P3IO_SOM;
+                break;
+            default:
+                seed = seed * 1103515245 + 12345;
+                payload[i] = (unsigned char)(seed >> 16);
+                break;
+        }
+    }
+}
+
+static bool Decoded(P3IOFrameDecoder *decoder, const unsigned char *payload, unsigned int length, unsigned int sequence)
+{
+    return decoder->Complete() &&
+           decoder->Sequence() == (sequence & 0xF) &&
+           decoder->Length() == length &&
+           memcmp(decoder->Payload(), payload, length) == 0;
+}
+
+static void TestFindEscape()
+{
+    unsigned char data[TEST_SCAN_LENGTH];
+    const unsigned char special[2] = { P3IO_SOM, P3IO_ESCAPE };
+
+    for (unsigned int length = 0; length <= TEST_SCAN_LENGTH; length++)
+    {
+        memset(data, 0x55, sizeof(data));
+        CHECK(P3IOFindEscape(data, length) == length);
+
+        for (unsigned int which = 0; which < 2; which++)
+        {
+            for (unsigned int pos = 0; pos < length; pos++)
+            {
+                /* The first of several matches wins */
+                memset(data, 0x55, sizeof(data));
+                data[pos] = special[which];
+                if (pos + 1 < length)
+                {
+                    data[length - 1] = special[1 - which];
+                }
+                CHECK(P3IOFindEscape(data, length) == pos);
+            }
+        }
+    }
+}
+
+static void TestEncodeLimits()
+{
+    unsigned char payload[P3IO_MAX_PAYLOAD_LENGTH + 1];
+    unsigned char frame[P3IO_MAX_FRAME_LENGTH + 2];
+    FillPayload(payload, sizeof(payload), PATTERN_ESCAPE);
+
+    CHECK(P3IOEncodeFrame(payload, P3IO_MAX_PAYLOAD_LENGTH + 1, 0, frame, sizeof(frame)) == 0);
+    CHECK(P3IOEncodeFrame(payload, P3IO_MAX_PAYLOAD_LENGTH, 0, frame, P3IO_MAX_FRAME_LENGTH) == P3IO_MAX_FRAME_LENGTH);
+    CHECK(P3IOEncodeFrame(payload, P3IO_MAX_PAYLOAD_LENGTH, 0, frame, P3IO_MAX_FRAME_LENGTH - 1) == 0);
+
+    /* The room check is for the worst case, even if this payload needs no escapes */
+    FillPayload(payload, sizeof(payload), PATTERN_ZERO);
+    CHECK(P3IOEncodeFrame(payload, 10, 0, frame, 22) == 0);
+    CHECK(P3IOEncodeFrame(payload, 10, 0, frame, 23) == 13);
+}
+
+static void TestRoundTrip()
+{
+    unsigned char payload[P3IO_MAX_PAYLOAD_LENGTH];
+    unsigned char frame[P3IO_MAX_FRAME_LENGTH];
+    P3IOFrameDecoder decoder;
+
+    for (unsigned int pattern = 0; pattern < PATTERN_COUNT; pattern++)
+    {
+        for (unsigned int length = 0; length <= P3IO_MAX_PAYLOAD_LENGTH; length++)
+        {
+            unsigned int sequence = length + pattern;
+            FillPayload(payload, length, pattern);
+
+            unsigned int framelen = P3IOEncodeFrame(payload, length, sequence, frame, sizeof(frame));
+            CHECK(framelen >= 3 + length);
+            CHECK(frame[0] == P3IO_SOM);
+            CHECK(frame[1] == length + 1);
+            CHECK(frame[2] == (sequence & 0xF));
+
+            /* Nothing past the header may look like the start of a frame */
+            CHECK(memchr(frame + 3, P3IO_SOM, framelen - 3) == NULL);
+
+            /* All at once */
+            decoder.Reset();
+            CHECK(decoder.Feed(frame, framelen) == framelen);
+            CHECK(Decoded(&decoder, payload, length, sequence));
+
+            /* One byte at a time, only finishing on the last */
+            decoder.Reset();
+            for (unsigned int i = 0; i < framelen; i++)
+            {
+                CHECK(!decoder.Complete());
+                CHECK(decoder.Feed(frame + i, 1) == 1);
+            }
+            CHECK(Decoded(&decoder, payload, length, sequence));
+
+            /* Split into two reads at every point, so escapes get cut in half */
+            for (unsigned int split = 0; split <= framelen; split++)
+            {
+                decoder.Reset();
+                CHECK(decoder.Feed(frame, split) == split);
+                CHECK(decoder.Feed(frame + split, framelen - split) == framelen - split);
+                CHECK(Decoded(&decoder, payload, length, sequence));
+            }
+        }
+    }
+}
+
+static void TestBackToBack()
+{
+    unsigned char first[40];
+    unsigned char second[40];
+    unsigned char stream[7 + (2 * P3IO_MAX_FRAME_LENGTH)];
+    FillPayload(first, sizeof(first), PATTERN_ALTERNATE);
+    FillPayload(second, sizeof(second), PATTERN_RANDOM);
+
+    /* Garbage first, which is skipped looking for the start of a frame */
+    unsigned int streamlen = 0;
+    stream[streamlen++] = 0x00;
+    stream[streamlen++] = P3IO_ESCAPE;
+    stream[streamlen++] = 0x12;
+    streamlen += P3IOEncodeFrame(first, sizeof(first), 3, stream + streamlen, sizeof(stream) - streamlen);
+    streamlen += P3IOEncodeFrame(second, sizeof(second), 4, stream + streamlen, sizeof(stream) - streamlen);
+
+    P3IOFrameDecoder decoder;
+    unsigned int used = decoder.Feed(stream, streamlen);
+    CHECK(used < streamlen);
+    CHECK(Decoded(&decoder, first, sizeof(first), 3));
+
+    decoder.Reset();
+    CHECK(decoder.Feed(stream + used, streamlen - used) == streamlen - used);
+    CHECK(Decoded(&decoder, second, sizeof(second), 4));
+}
+
+static void TestBadInput()
+{
+    P3IOFrameDecoder decoder;
+    const unsigned char expected[1] = { 0x66 };
+
+    /* A zero length can't even hold the sequence, so it is dropped */
+    const unsigned char zeroLength[] = { P3IO_SOM, 0x00, P3IO_SOM, 0x02, 0x05, 0x66 };
+    decoder.Reset();
+    CHECK(decoder.Feed(zeroLength, sizeof(zeroLength)) == sizeof(zeroLength));
+    CHECK(Decoded(&decoder, expected, 1, 5));
+
+    /* A frame cut short by the start of the next one */
+    const unsigned char truncated[] = { P3IO_SOM, 0x05, 0x01, 0x11, 0x22, P3IO_SOM, 0x02, 0x05, 0x66 };
+    decoder.Reset();
+    CHECK(decoder.Feed(truncated, sizeof(truncated)) == sizeof(truncated));
+    CHECK(Decoded(&decoder, expected, 1, 5));
+
+    /* An escape can never be followed by the start of a frame, so that's a new frame too */
+    const unsigned char badEscape[] = { P3IO_SOM, 0x04, 0x01, 0x11, P3IO_ESCAPE, P3IO_SOM, 0x02, 0x05, 0x66 };
+    decoder.Reset();
+    CHECK(decoder.Feed(badEscape, sizeof(badEscape)) == sizeof(badEscape));
+    CHECK(Decoded(&decoder, expected, 1, 5));
+
+    /* Same again, with the escape and what follows it arriving separately */
+    decoder.Reset();
+    CHECK(decoder.Feed(badEscape, 5) == 5);
+    CHECK(!decoder.Complete());
+    CHECK(decoder.Feed(badEscape + 5, sizeof(badEscape) - 5) == sizeof(badEscape) - 5);
+    CHECK(Decoded(&decoder, expected, 1, 5));
+
+    /* A frame that never finishes never completes */
+    decoder.Reset();
+    CHECK(decoder.Feed(truncated, 5) == 5);
+    CHECK(decoder.Started());
+    CHECK(!decoder.Complete());
+}
+
+int main()
+{
+    TestFindEscape();
+    TestEncodeLimits();
+    TestRoundTrip();
+    TestBackToBack();
+    TestBadInput();
+
+    return TEST_RESULT();
+}
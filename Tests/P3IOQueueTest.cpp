@@ -0,0 +1,346 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "Clock.h"
+#include "P3IOQueue.h"
+#include "Test.h"
+#include "Thread.h"
+
+/* Plenty for a queue's worth of worst case responses */
+#define FAKE_BUFFER_LENGTH (P3IO_MAX_IN_FLIGHT * P3IO_MAX_FRAME_LENGTH)
+
+/* Roughly what one USB bulk round trip costs on a cabinet */
+#define FAKE_ROUND_TRIP_US 2000
+
+/* The init sequence the backend runs: version, mode, cab type, coinstock, cab type */
+#define STARTUP_REQUESTS 5
+
+/**
+ * Stands in for the P3IO on the other end of the bulk pipe. Every request
+ * written is answered with the same bytes plus one, under the same sequence,
+ * and the answers can be reordered, dribbled out or mixed with strays.
+ */
+class FakeP3IO
+{
+public:
+    FakeP3IO()
+    {
+        outlen = 0;
+        outloc = 0;
+        roundTrips = 0;
+        reverse = false;
+        chunk = 0;
+        latency = 0;
+    }
+
+    void Write(const unsigned char *data, unsigned int length)
+    {
+        unsigned int responses[P3IO_MAX_IN_FLIGHT];
+        unsigned int count = 0;
+        unsigned int loc = 0;
+        P3IOFrameDecoder decoder;
+
+        while (loc < length)
+        {
+            loc += decoder.Feed(data + loc, length - loc);
+            if (!decoder.Complete())
+            {
+                break;
+            }
+
+            unsigned char response[P3IO_MAX_PAYLOAD_LENGTH];
+            for (unsigned int i = 0; i < decoder.Length(); i++)
+            {
+                response[i] = decoder.Payload()[i] + 1;
+            }
+            responses[count++] = outlen;
+            outlen += P3IOEncodeFrame(response, decoder.Length(), decoder.Sequence(), out + outlen, sizeof(out) - outlen);
+            decoder.Reset();
+        }
+
+        if (reverse && count > 1)
+        {
+            /* Same frames, last one first */
+            unsigned char reversed[FAKE_BUFFER_LENGTH];
+            unsigned int end = outlen;
+            unsigned int reversedlen = 0;
+            while (count > 0)
+            {
+                unsigned int start = responses[--count];
+                memcpy(reversed + reversedlen, out + start, end - start);
+                reversedlen += end - start;
+                end = start;
+            }
+            memcpy(out + responses[0], reversed, reversedlen);
+        }
+    }
+
+    /* Queues up a response to a request that was never made */
+    void Stray(unsigned int sequence)
+    {
+        unsigned char response[2] = { 0xDE, 0xAD };
+        outlen += P3IOEncodeFrame(response, sizeof(response), sequence, out + outlen, sizeof(out) - outlen);
+    }
+
+    unsigned int Read(unsigned char *buffer, unsigned int buflen)
+    {
+        /* Each read the host waits on is another trip over the bus */
+        if (outloc == 0)
+        {
+            roundTrips++;
+            if (latency > 0)
+            {
+                ThreadSleep(latency);
+            }
+        }
+
+        unsigned int length = outlen - outloc;
+        if (chunk > 0 && length > chunk)
+        {
+            length = chunk;
+        }
+        if (length > buflen)
+        {
+            length = buflen;
+        }
+
+        memcpy(buffer, out + outloc, length);
+        outloc += length;
+        if (outloc == outlen)
+        {
+            outloc = 0;
+            outlen = 0;
+        }
+        return length;
+    }
+
+    unsigned int roundTrips;
+    bool reverse;
+    unsigned int chunk;
+    unsigned int latency;
+private:
+    unsigned char out[FAKE_BUFFER_LENGTH];
+    unsigned int outlen;
+    unsigned int outloc;
+};
+
+/* Same as P3IOBackend::FlushP3IO, against the fake instead of the pipe */
+static bool Flush(P3IOQueue *queue, FakeP3IO *device)
+{
+    unsigned char buffer[P3IO_MAX_FRAME_LENGTH * 2];
+    while (queue->Unsent() > 0)
+    {
+        unsigned int length = queue->Encode(buffer, sizeof(buffer));
+        device->Write(buffer, length);
+    }
+
+    unsigned int reads = 0;
+    unsigned int maxreads = queue->Pending() * 4;
+    while (queue->Pending() > 0 && reads < maxreads)
+    {
+        unsigned int actual = device->Read(buffer, sizeof(buffer));
+        if (actual == 0)
+        {
+            break;
+        }
+
+        queue->Receive(buffer, actual);
+        reads++;
+    }
+
+    if (queue->Pending() > 0)
+    {
+        queue->Fail();
+        return false;
+    }
+    return true;
+}
+
+typedef struct
+{
+    unsigned char request;
+    unsigned int calls;
+    bool failed;
+    bool matched;
+} test_request_t;
+
+static void Response(void *context, const unsigned char *response, unsigned int length)
+{
+    test_request_t *request = (test_request_t *)context;
+    request->calls++;
+    if (response == NULL)
+    {
+        request->failed = true;
+        return;
+    }
+    request->matched = length == 1 && response[0] == (unsigned char)(request->request + 1);
+}
+
+static void Submit(P3IOQueue *queue, test_request_t *request, unsigned char value)
+{
+    request->request = value;
+    request->calls = 0;
+    request->failed = false;
+    request->matched = false;
+    CHECK(queue->Submit(&request->request, 1, Response, request));
+}
+
+static bool AllMatched(test_request_t *requests, unsigned int count)
+{
+    for (unsigned int i = 0; i < count; i++)
+    {
+        if (requests[i].calls != 1 || !requests[i].matched)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Runs the startup sequence one exchange at a time, the way it used to be,
+ * and then all queued up, and reports what each cost.
+ */
+static void TestRoundTrips()
+{
+    test_request_t requests[STARTUP_REQUESTS];
+
+    FakeP3IO serialDevice;
+    serialDevice.latency = FAKE_ROUND_TRIP_US;
+    P3IOQueue serial;
+    unsigned long long start = ClockMicroseconds();
+    for (unsigned int i = 0; i < STARTUP_REQUESTS; i++)
+    {
+        Submit(&serial, &requests[i], 0x10 + i);
+        CHECK(Flush(&serial, &serialDevice));
+    }
+    unsigned long long serialTime = ClockMicroseconds() - start;
+    CHECK(AllMatched(requests, STARTUP_REQUESTS));
+
+    FakeP3IO pipelinedDevice;
+    pipelinedDevice.latency = FAKE_ROUND_TRIP_US;
+    P3IOQueue pipelined;
+    start = ClockMicroseconds();
+    for (unsigned int i = 0; i < STARTUP_REQUESTS; i++)
+    {
+        Submit(&pipelined, &requests[i], 0x10 + i);
+    }
+    CHECK(Flush(&pipelined, &pipelinedDevice));
+    unsigned long long pipelinedTime = ClockMicroseconds() - start;
+    CHECK(AllMatched(requests, STARTUP_REQUESTS));
+
+    CHECK(serialDevice.roundTrips == STARTUP_REQUESTS);
+    CHECK(pipelinedDevice.roundTrips == 1);
+    CHECK(pipelinedTime < serialTime);
+
+    printf("Startup one at a time: %u round trips, %llu us\n", serialDevice.roundTrips, serialTime);
+    printf("Startup queued up: %u round trips, %llu us\n", pipelinedDevice.roundTrips, pipelinedTime);
+}
+
+static void TestOutOfOrder()
+{
+    test_request_t requests[P3IO_MAX_IN_FLIGHT];
+    FakeP3IO device;
+    device.reverse = true;
+    P3IOQueue queue;
+
+    for (unsigned int i = 0; i < P3IO_MAX_IN_FLIGHT; i++)
+    {
+        Submit(&queue, &requests[i], 0x20 + i);
+    }
+    CHECK(Flush(&queue, &device));
+    CHECK(AllMatched(requests, P3IO_MAX_IN_FLIGHT));
+}
+
+static void TestDribbled()
+{
+    /* Answers that need escaping, so escapes get split across reads too */
+    const unsigned char values[4] = { 0xA9, 0xFE, 0x10, 0x11 };
+    test_request_t requests[4];
+    FakeP3IO device;
+    device.chunk = 1;
+    P3IOQueue queue;
+
+    for (unsigned int i = 0; i < 4; i++)
+    {
+        Submit(&queue, &requests[i], values[i]);
+    }
+
+    unsigned char buffer[P3IO_MAX_FRAME_LENGTH * 4];
+    device.Write(buffer, queue.Encode(buffer, sizeof(buffer)));
+
+    unsigned int completed = 0;
+    unsigned int actual;
+    while ((actual = device.Read(buffer, sizeof(buffer))) > 0)
+    {
+        completed += queue.Receive(buffer, actual);
+    }
+    CHECK(completed == 4);
+    CHECK(queue.Pending() == 0);
+    CHECK(AllMatched(requests, 4));
+}
+
+static void TestFull()
+{
+    test_request_t requests[P3IO_MAX_IN_FLIGHT + 1];
+    FakeP3IO device;
+    P3IOQueue queue;
+
+    for (unsigned int i = 0; i < P3IO_MAX_IN_FLIGHT; i++)
+    {
+        Submit(&queue, &requests[i], i);
+    }
+
+    /* No room until something comes back */
+    unsigned char extra = 0x40;
+    CHECK(!queue.Submit(&extra, 1, Response, &requests[P3IO_MAX_IN_FLIGHT]));
+    CHECK(Flush(&queue, &device));
+    CHECK(queue.Pending() == 0);
+    Submit(&queue, &requests[P3IO_MAX_IN_FLIGHT], extra);
+    CHECK(Flush(&queue, &device));
+    CHECK(AllMatched(requests, P3IO_MAX_IN_FLIGHT + 1));
+}
+
+static void TestUnmatched()
+{
+    test_request_t requests[3];
+    FakeP3IO device;
+    P3IOQueue queue;
+
+    /* A stray ahead of real responses is dropped rather than handed to the oldest request */
+    Submit(&queue, &requests[0], 0x50);
+    Submit(&queue, &requests[1], 0x51);
+    device.Stray(9);
+    CHECK(Flush(&queue, &device));
+    CHECK(AllMatched(requests, 2));
+    CHECK(queue.Unmatched() == 1);
+
+    /* A response that turns up after we gave up on its request is dropped too */
+    Submit(&queue, &requests[2], 0x52);
+    unsigned char buffer[P3IO_MAX_FRAME_LENGTH];
+    device.Write(buffer, queue.Encode(buffer, sizeof(buffer)));
+    queue.Fail();
+    CHECK(requests[2].calls == 1 && requests[2].failed);
+
+    unsigned int actual = device.Read(buffer, sizeof(buffer));
+    CHECK(queue.Receive(buffer, actual) == 0);
+    CHECK(requests[2].calls == 1);
+    CHECK(queue.Unmatched() == 2);
+
+    /* And nothing was knocked out of step for the next request */
+    Submit(&queue, &requests[0], 0x53);
+    CHECK(Flush(&queue, &device));
+    CHECK(AllMatched(requests, 1));
+    CHECK(queue.Unmatched() == 2);
+}
+
+int main()
+{
+    TestRoundTrips();
+    TestOutOfOrder();
+    TestDribbled();
+    TestFull();
+    TestUnmatched();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,232 @@
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Clock.h"
+#include "Prefetcher.h"
+#include "Test.h"
+#include "Thread.h"
+
+#define TEST_DIRECTORY_TEMPLATE "/tmp/ddrmenu prefetch XXXXXX"
+
+/* Long enough for the worker to have picked up a target and got going */
+#define TEST_SETTLE_US ((PREFETCH_DWELL_MS + 250) * 1000)
+
+/* Read a byte at a time through a huge sparse file, so warming it takes far
+   longer than any test waits and is sure to be interrupted */
+#define TEST_SLOW_CHUNK 1
+#define TEST_ENDLESS_BYTES (1024ULL * 1024 * 1024)
+
+/* Room to put any of the test's file names after it in a PATH_MAX buffer */
+#define TEST_DIRECTORY_LENGTH 256
+
+static char directory[TEST_DIRECTORY_LENGTH];
+
+static void MakeFile(const char *name, unsigned int size)
+{
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", directory, name);
+
+    FILE *fp = fopen(path, "wb");
+    CHECK(fp != NULL);
+    if (fp == NULL)
+    {
+        return;
+    }
+
+    char block[4096];
+    memset(block, 0x5A, sizeof(block));
+    while (size > 0)
+    {
+        unsigned int length = size < sizeof(block) ? size : sizeof(block);
+        fwrite(block, 1, length, fp);
+        size -= length;
+    }
+    fclose(fp);
+}
+
+static void MakeSparseFile(const char *name, unsigned long long size)
+{
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", directory, name);
+
+    FILE *fp = fopen(path, "wb");
+    CHECK(fp != NULL);
+    if (fp == NULL)
+    {
+        return;
+    }
+    CHECK(ftruncate(fileno(fp), size) == 0);
+    fclose(fp);
+}
+
+static void MakeDirectory(const char *name)
+{
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", directory, name);
+    CHECK(mkdir(path, 0755) == 0);
+}
+
+static void Path(const char *name, char *path)
+{
+    snprintf(path, PATH_MAX, "%s/%s", directory, name);
+}
+
+/**
+ * A game with more content than the budget allows stops reading at exactly
+ * the budget, having done its executable first.
+ */
+static void TestBudget()
+{
+    char path[PATH_MAX];
+    Path("big/game.exe", path);
+
+    Prefetcher prefetcher(1024 * 1024);
+    prefetcher.Target(path);
+    ThreadSleep(TEST_SETTLE_US);
+    prefetcher.Stop();
+
+    CHECK(prefetcher.Targets() == 1);
+    CHECK(prefetcher.Warmed() == 1024 * 1024);
+    CHECK(!prefetcher.Complete());
+    CHECK(prefetcher.Abandoned() == 0);
+    prefetcher.Dump(stdout);
+}
+
+/**
+ * A game that fits warms everything under its directory, and no more.
+ */
+static void TestWholeGame()
+{
+    char path[PATH_MAX];
+    Path("small/game.exe", path);
+
+    Prefetcher prefetcher(1024 * 1024);
+    prefetcher.Target(path);
+    ThreadSleep(TEST_SETTLE_US);
+    prefetcher.Stop();
+
+    CHECK(prefetcher.Targets() == 1);
+    CHECK(prefetcher.Warmed() == 12288 + 4096 + 8192);
+    CHECK(prefetcher.Complete());
+    prefetcher.Dump(stdout);
+}
+
+/**
+ * Scrolling past a game never reads it, only where the selection stops.
+ */
+static void TestDwell()
+{
+    char big[PATH_MAX];
+    char small[PATH_MAX];
+    Path("big/game.exe", big);
+    Path("small/game.exe", small);
+
+    Prefetcher prefetcher(1024 * 1024);
+    prefetcher.Target(big);
+    prefetcher.Target(small);
+    ThreadSleep(TEST_SETTLE_US);
+    prefetcher.Stop();
+
+    CHECK(prefetcher.Targets() == 1);
+    CHECK(strcmp(prefetcher.Current(), small) == 0);
+    CHECK(prefetcher.Complete());
+}
+
+/**
+ * Moving on while a game is being read abandons it and starts on the new
+ * one, without the old one using up the new one's budget.
+ */
+static void TestRetarget()
+{
+    char endless[PATH_MAX];
+    char small[PATH_MAX];
+    Path("endless/game.exe", endless);
+    Path("small/game.exe", small);
+
+    Prefetcher prefetcher(PREFETCH_BUDGET_BYTES, TEST_SLOW_CHUNK);
+    prefetcher.Target(endless);
+    ThreadSleep(TEST_SETTLE_US);
+    prefetcher.Target(small);
+    ThreadSleep(TEST_SETTLE_US);
+    prefetcher.Stop();
+
+    CHECK(prefetcher.Targets() == 2);
+    CHECK(prefetcher.Abandoned() == 1);
+    CHECK(strcmp(prefetcher.Current(), small) == 0);
+    CHECK(prefetcher.Warmed() == 12288 + 4096 + 8192);
+    CHECK(prefetcher.Complete());
+    prefetcher.Dump(stdout);
+}
+
+/**
+ * Stopping doesn't wait for a slow read to finish.
+ */
+static void TestStop()
+{
+    char endless[PATH_MAX];
+    Path("endless/game.exe", endless);
+
+    Prefetcher prefetcher(PREFETCH_BUDGET_BYTES, TEST_SLOW_CHUNK);
+    prefetcher.Target(endless);
+    ThreadSleep(TEST_SETTLE_US);
+
+    unsigned long long start = ClockMicroseconds();
+    prefetcher.Stop();
+    CHECK(ClockMicroseconds() - start < TEST_SETTLE_US);
+
+    CHECK(prefetcher.Targets() == 1);
+    CHECK(prefetcher.Warmed() > 0 && prefetcher.Warmed() < PREFETCH_BUDGET_BYTES);
+    CHECK(!prefetcher.Complete());
+    CHECK(prefetcher.Abandoned() == 0);
+}
+
+int main()
+{
+    char temp[] = TEST_DIRECTORY_TEMPLATE;
+    char resolved[PATH_MAX];
+    if (mkdtemp(temp) == NULL || realpath(temp, resolved) == NULL || strlen(resolved) >= sizeof(directory))
+    {
+        fprintf(stderr, "Failed to make a directory to prefetch from!\n");
+        return 1;
+    }
+    strcpy(directory, resolved);
+
+    /* One game with more content than the budget, one with a little, and
+       one that takes forever */
+    MakeDirectory("big");
+    MakeDirectory("big/data");
+    MakeFile("big/game.exe", 512 * 1024);
+    MakeFile("big/data/songs.bin", 2 * 1024 * 1024);
+    MakeDirectory("small");
+    MakeDirectory("small/data");
+    MakeFile("small/game.exe", 12288);
+    MakeFile("small/config.ini", 4096);
+    MakeFile("small/data/songs.bin", 8192);
+    MakeDirectory("endless");
+    MakeSparseFile("endless/game.exe", TEST_ENDLESS_BYTES);
+
+    TestBudget();
+    TestWholeGame();
+    TestDwell();
+    TestRetarget();
+    TestStop();
+
+    const char *names[] = {
+        "big/data/songs.bin", "big/game.exe", "big/data", "big",
+        "small/data/songs.bin", "small/config.ini", "small/game.exe", "small/data", "small",
+        "endless/game.exe", "endless"
+    };
+    char path[PATH_MAX];
+    for (unsigned int i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+    {
+        Path(names[i], path);
+        remove(path);
+    }
+    rmdir(directory);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,128 @@
+#include <stdio.h>
+
+#include "Clock.h"
+#include "Scheduler.h"
+#include "Test.h"
+
+/* 10 ms ticks, so the numbers below are easy to follow */
+#define TEST_TICK_RATE_HZ 100
+#define TEST_INTERVAL_US 10000
+
+/* Every wakeup the fake loop gets comes this late */
+#define TEST_LATE_US 3000
+
+/**
+ * Starts a scheduler ticking at a known time, and returns when its next
+ * tick is due. The scheduler starts from the real clock, so the test can
+ * only begin from there too.
+ */
+static unsigned long long Start(Scheduler *scheduler)
+{
+    unsigned long long now = ClockMicroseconds();
+    scheduler->BeginTick(now);
+    scheduler->EndTick(now);
+    return now + scheduler->MicrosecondsUntilNextTick(now);
+}
+
+/**
+ * Waking up late every tick doesn't push the schedule back, the next
+ * deadline is always one interval after the last one.
+ */
+static void TestNoDrift()
+{
+    Scheduler scheduler(TEST_TICK_RATE_HZ);
+    unsigned long long deadline = Start(&scheduler);
+
+    for (unsigned int i = 0; i < 100; i++)
+    {
+        unsigned long long now = deadline + TEST_LATE_US;
+        scheduler.BeginTick(now);
+        scheduler.EndTick(now + 100);
+        deadline += TEST_INTERVAL_US;
+        CHECK(scheduler.MicrosecondsUntilNextTick(now) == TEST_INTERVAL_US - TEST_LATE_US);
+    }
+
+    CHECK(scheduler.Ticks() == 101);
+}
+
+/**
+ * Input waking the loop early gets its tick, but the regular one is still
+ * due when it was.
+ */
+static void TestEarlyWake()
+{
+    Scheduler scheduler(TEST_TICK_RATE_HZ);
+    unsigned long long deadline = Start(&scheduler);
+
+    unsigned long long now = deadline - 4000;
+    scheduler.BeginTick(now);
+    CHECK(scheduler.MicrosecondsUntilNextTick(now) == 4000);
+
+    scheduler.BeginTick(deadline);
+    CHECK(scheduler.MicrosecondsUntilNextTick(deadline) == TEST_INTERVAL_US);
+}
+
+/**
+ * After a long stall the missed ticks aren't all run back to back, the
+ * schedule starts over from now.
+ */
+static void TestCatchUp()
+{
+    Scheduler scheduler(TEST_TICK_RATE_HZ);
+    unsigned long long deadline = Start(&scheduler);
+
+    unsigned long long now = deadline + (5 * TEST_INTERVAL_US) + 1234;
+    scheduler.BeginTick(now);
+    CHECK(scheduler.MicrosecondsUntilNextTick(now) == TEST_INTERVAL_US);
+
+    /* And carries on from there without drifting */
+    now += TEST_INTERVAL_US + TEST_LATE_US;
+    scheduler.BeginTick(now);
+    CHECK(scheduler.MicrosecondsUntilNextTick(now) == TEST_INTERVAL_US - TEST_LATE_US);
+}
+
+/**
+ * Waits in milliseconds round up, so the loop never wakes just before the
+ * deadline and has to spin.
+ */
+static void TestMilliseconds()
+{
+    Scheduler scheduler(TEST_TICK_RATE_HZ);
+    unsigned long long deadline = Start(&scheduler);
+
+    CHECK(scheduler.MillisecondsUntilNextTick(deadline - TEST_INTERVAL_US) == 10);
+    CHECK(scheduler.MillisecondsUntilNextTick(deadline - 1001) == 2);
+    CHECK(scheduler.MillisecondsUntilNextTick(deadline - 1000) == 1);
+    CHECK(scheduler.MillisecondsUntilNextTick(deadline - 1) == 1);
+    CHECK(scheduler.MillisecondsUntilNextTick(deadline) == 0);
+    CHECK(scheduler.MillisecondsUntilNextTick(deadline + 5000) == 0);
+    CHECK(scheduler.MicrosecondsUntilNextTick(deadline + 5000) == 0);
+}
+
+/**
+ * No rate at all falls back to the menu's, and a new rate applies from the
+ * next tick on.
+ */
+static void TestTickRate()
+{
+    Scheduler scheduler(0);
+    unsigned long long now = ClockMicroseconds();
+    scheduler.BeginTick(now);
+    scheduler.BeginTick(now + 1000000);
+    CHECK(scheduler.MicrosecondsUntilNextTick(now + 1000000) == 1000000 / MENU_TICK_RATE_HZ);
+
+    scheduler.SetTickRate(1000);
+    scheduler.BeginTick(now + 2000000);
+    CHECK(scheduler.MicrosecondsUntilNextTick(now + 2000000) == 1000);
+}
+
+int main()
+{
+    TestNoDrift();
+    TestEarlyWake();
+    TestCatchUp();
+    TestMilliseconds();
+    TestTickRate();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdio.h>
+
+/* Every failed check bumps this, each test's main returns TEST_RESULT() */
+static unsigned int testFailures = 0;
+
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            testFailures++; \
+        } \
+    } while (0)
+
+#define TEST_RESULT() (testFailures == 0 ? 0 : 1)
@@ -0,0 +1,256 @@
+#include <stdio.h>
+
+#include "Test.h"
+#include "TimerWheel.h"
+
+/* An arbitrary start well away from zero, so nothing lines up by accident */
+#define TEST_START_US 5000000000ULL
+#define TEST_MS 1000ULL
+
+/* What a test timer does when it fires */
+typedef struct
+{
+    TimerWheel *wheel;
+    unsigned int fired;
+    unsigned long long firedAt;
+    unsigned long long again;
+    int cancel;
+    int reschedule;
+    unsigned long long rescheduleTo;
+} test_timer_t;
+
+static void Reset(test_timer_t *timer, TimerWheel *wheel)
+{
+    timer->wheel = wheel;
+    timer->fired = 0;
+    timer->firedAt = 0;
+    timer->again = 0;
+    timer->cancel = -1;
+    timer->reschedule = -1;
+    timer->rescheduleTo = 0;
+}
+
+static unsigned long long Fire(void *context, unsigned long long now)
+{
+    test_timer_t *timer = (test_timer_t *)context;
+    timer->fired++;
+    timer->firedAt = now;
+
+    if (timer->cancel >= 0)
+    {
+        timer->wheel->Cancel(timer->cancel);
+    }
+    if (timer->reschedule >= 0)
+    {
+        timer->wheel->Reschedule(timer->reschedule, timer->rescheduleTo);
+    }
+
+    unsigned long long again = timer->again;
+    timer->again = 0;
+    return again;
+}
+
+/* Steps the wheel a millisecond at a time, the way the main loop would */
+static unsigned int Step(TimerWheel *wheel, unsigned long long from, unsigned long long to)
+{
+    unsigned int fired = 0;
+    for (unsigned long long now = from; now <= to; now += TEST_MS)
+    {
+        fired += wheel->Advance(now);
+    }
+    return fired;
+}
+
+/**
+ * Timers more than one trip around the wheel away share slots with nearer
+ * ones, and have to sit out every pass until their own.
+ */
+static void TestWraparound()
+{
+    TimerWheel wheel(TEST_START_US);
+    test_timer_t near;
+    test_timer_t far;
+    test_timer_t further;
+    Reset(&near, &wheel);
+    Reset(&far, &wheel);
+    Reset(&further, &wheel);
+
+    /* All three land in the same slot */
+    unsigned long long trip = TIMER_WHEEL_SLOTS * TIMER_WHEEL_RESOLUTION_US;
+    wheel.Add(TEST_START_US + (10 * TEST_MS), Fire, &near);
+    wheel.Add(TEST_START_US + (10 * TEST_MS) + trip, Fire, &far);
+    wheel.Add(TEST_START_US + (10 * TEST_MS) + (3 * trip), Fire, &further);
+
+    CHECK(Step(&wheel, TEST_START_US, TEST_START_US + (9 * TEST_MS)) == 0);
+    CHECK(Step(&wheel, TEST_START_US + (10 * TEST_MS), TEST_START_US + (10 * TEST_MS)) == 1);
+    CHECK(near.fired == 1 && far.fired == 0 && further.fired == 0);
+
+    CHECK(Step(&wheel, TEST_START_US + (11 * TEST_MS), TEST_START_US + (9 * TEST_MS) + trip) == 0);
+    CHECK(Step(&wheel, TEST_START_US + (10 * TEST_MS) + trip, TEST_START_US + (9 * TEST_MS) + (3 * trip)) == 1);
+    CHECK(far.fired == 1 && far.firedAt == TEST_START_US + (10 * TEST_MS) + trip);
+    CHECK(further.fired == 0);
+
+    CHECK(wheel.Advance(TEST_START_US + (10 * TEST_MS) + (3 * trip)) == 1);
+    CHECK(further.fired == 1);
+    CHECK(wheel.NextDeadline() == 0);
+}
+
+/**
+ * Sleeping far past several deadlines fires each of them once, in one go.
+ */
+static void TestLongSleep()
+{
+    TimerWheel wheel(TEST_START_US);
+    test_timer_t timers[5];
+    for (unsigned int i = 0; i < 5; i++)
+    {
+        Reset(&timers[i], &wheel);
+        wheel.Add(TEST_START_US + ((i + 1) * 37 * TEST_MS), Fire, &timers[i]);
+    }
+
+    /* A repeating timer due all along only catches up once */
+    test_timer_t repeating;
+    Reset(&repeating, &wheel);
+    repeating.again = TEST_START_US + (2 * TEST_MS);
+    wheel.Add(TEST_START_US + TEST_MS, Fire, &repeating);
+
+    unsigned long long woke = TEST_START_US + (1000 * TEST_MS);
+    CHECK(wheel.Advance(woke) == 6);
+    for (unsigned int i = 0; i < 5; i++)
+    {
+        CHECK(timers[i].fired == 1 && timers[i].firedAt == woke);
+    }
+    CHECK(repeating.fired == 1);
+
+    /* It asked to go again at a time already past, so it's next */
+    CHECK(wheel.NextDeadline() == TEST_START_US + (2 * TEST_MS));
+    CHECK(wheel.MillisecondsUntilNext(woke) == 0);
+    CHECK(wheel.Advance(woke + TEST_MS) == 1);
+    CHECK(repeating.fired == 2);
+    CHECK(wheel.NextDeadline() == 0);
+    CHECK(wheel.MillisecondsUntilNext(woke) == 0xFFFFFFFF);
+}
+
+/**
+ * A callback moving another timer that's due in the same slot, which the
+ * walk would otherwise have gone on to.
+ */
+static void TestRescheduleFromCallback()
+{
+    TimerWheel wheel(TEST_START_US);
+    test_timer_t first;
+    test_timer_t second;
+    test_timer_t mover;
+    Reset(&first, &wheel);
+    Reset(&second, &wheel);
+    Reset(&mover, &wheel);
+
+    /* Slots are walked newest first, so the mover goes before the others */
+    unsigned long long due = TEST_START_US + (5 * TEST_MS);
+    wheel.Add(due, Fire, &first);
+    int secondTimer = wheel.Add(due, Fire, &second);
+    wheel.Add(due, Fire, &mover);
+
+    /* Pushed out past a whole trip around, so it has to skip a pass too */
+    mover.reschedule = secondTimer;
+    mover.rescheduleTo = due + (100 * TEST_MS);
+    CHECK(wheel.Advance(due) == 2);
+    CHECK(mover.fired == 1 && first.fired == 1 && second.fired == 0);
+
+    CHECK(Step(&wheel, due + TEST_MS, due + (99 * TEST_MS)) == 0);
+    CHECK(wheel.Advance(due + (100 * TEST_MS)) == 1);
+    CHECK(second.fired == 1);
+
+    /* Rescheduling itself wins over what it returns */
+    test_timer_t self;
+    Reset(&self, &wheel);
+    int selfTimer = wheel.Add(due + (200 * TEST_MS), Fire, &self);
+    self.reschedule = selfTimer;
+    self.rescheduleTo = due + (210 * TEST_MS);
+    self.again = due + (205 * TEST_MS);
+    CHECK(wheel.Advance(due + (200 * TEST_MS)) == 1);
+    self.reschedule = -1;
+    CHECK(wheel.NextDeadline() == due + (210 * TEST_MS));
+    CHECK(Step(&wheel, due + (201 * TEST_MS), due + (209 * TEST_MS)) == 0);
+    CHECK(wheel.Advance(due + (210 * TEST_MS)) == 1);
+    CHECK(self.fired == 2);
+    CHECK(wheel.NextDeadline() == 0);
+}
+
+/**
+ * A callback cancelling the timer after it in the same slot, and one
+ * cancelling itself.
+ */
+static void TestCancelFromCallback()
+{
+    TimerWheel wheel(TEST_START_US);
+    test_timer_t victim;
+    test_timer_t other;
+    test_timer_t killer;
+    Reset(&victim, &wheel);
+    Reset(&other, &wheel);
+    Reset(&killer, &wheel);
+
+    unsigned long long due = TEST_START_US + (3 * TEST_MS);
+    wheel.Add(due, Fire, &other);
+    int victimTimer = wheel.Add(due, Fire, &victim);
+    wheel.Add(due, Fire, &killer);
+    killer.cancel = victimTimer;
+
+    CHECK(wheel.Advance(due) == 2);
+    CHECK(killer.fired == 1 && other.fired == 1 && victim.fired == 0);
+    CHECK(wheel.NextDeadline() == 0);
+
+    /* The cancelled one's place is free and the wheel still works */
+    test_timer_t reused;
+    Reset(&reused, &wheel);
+    CHECK(wheel.Add(due + TEST_MS, Fire, &reused) >= 0);
+    CHECK(wheel.Advance(due + TEST_MS) == 1);
+    CHECK(reused.fired == 1);
+
+    /* Cancelling itself wins over asking to go again */
+    test_timer_t quitter;
+    Reset(&quitter, &wheel);
+    quitter.cancel = wheel.Add(due + (2 * TEST_MS), Fire, &quitter);
+    quitter.again = due + (3 * TEST_MS);
+    CHECK(wheel.Advance(due + (2 * TEST_MS)) == 1);
+    CHECK(wheel.NextDeadline() == 0);
+    CHECK(Step(&wheel, due + (3 * TEST_MS), due + (10 * TEST_MS)) == 0);
+    CHECK(quitter.fired == 1);
+}
+
+/**
+ * A timer added by a callback, already due, waits for the next advance
+ * rather than firing in the middle of this one.
+ */
+static unsigned long long AddLater(void *context, unsigned long long now)
+{
+    test_timer_t *timer = (test_timer_t *)context;
+    timer->wheel->Add(now, Fire, timer);
+    return 0;
+}
+
+static void TestAddFromCallback()
+{
+    TimerWheel wheel(TEST_START_US);
+    test_timer_t added;
+    Reset(&added, &wheel);
+
+    unsigned long long due = TEST_START_US + TEST_MS;
+    wheel.Add(due, AddLater, &added);
+    CHECK(wheel.Advance(due) == 1);
+    CHECK(added.fired == 0);
+    CHECK(wheel.Advance(due) == 1);
+    CHECK(added.fired == 1);
+}
+
+int main()
+{
+    TestWraparound();
+    TestLongSleep();
+    TestRescheduleFromCallback();
+    TestCancelFromCallback();
+    TestAddFromCallback();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,139 @@
+#include <stdio.h>
+
+#include "Test.h"
+#include "Viewport.h"
+
+/* Nine 40 pixel rows with 10 pixels above each fit in 480, with 20 spare */
+#define TEST_ROW_HEIGHT 40
+#define TEST_ROW_PADDING 10
+#define TEST_SCREEN_HEIGHT 480
+#define TEST_ROWS 9
+
+static void Layout(Viewport *viewport, unsigned int count)
+{
+    viewport->SetLayout(TEST_ROW_HEIGHT, TEST_ROW_PADDING, TEST_SCREEN_HEIGHT);
+    viewport->SetCount(count);
+}
+
+/**
+ * Scrolling to either end of a long list puts that end flush with the
+ * screen, with no empty rows past it.
+ */
+static void TestEnds()
+{
+    Viewport viewport;
+    Layout(&viewport, 1000);
+    CHECK(viewport.Rows() == TEST_ROWS);
+    CHECK(viewport.First() == 0 && viewport.Last() == TEST_ROWS);
+
+    CHECK(viewport.ScrollTo(999));
+    CHECK(viewport.First() == 1000 - TEST_ROWS && viewport.Last() == 1000);
+    CHECK(viewport.IsVisible(999) && !viewport.IsVisible(1000 - TEST_ROWS - 1));
+
+    /* Moving within what's already on screen doesn't scroll */
+    CHECK(!viewport.ScrollTo(1000 - TEST_ROWS));
+    CHECK(!viewport.ScrollTo(999));
+
+    CHECK(viewport.ScrollTo(0));
+    CHECK(viewport.First() == 0 && viewport.Last() == TEST_ROWS);
+    CHECK(viewport.IsVisible(0) && !viewport.IsVisible(TEST_ROWS));
+}
+
+/**
+ * Stepping a row past the edge of the screen scrolls by exactly one row, in
+ * either direction.
+ */
+static void TestStep()
+{
+    Viewport viewport;
+    Layout(&viewport, 100);
+
+    for (unsigned int item = 0; item < TEST_ROWS; item++)
+    {
+        CHECK(!viewport.ScrollTo(item));
+    }
+    CHECK(viewport.ScrollTo(TEST_ROWS));
+    CHECK(viewport.First() == 1);
+
+    CHECK(viewport.ScrollTo(50));
+    CHECK(viewport.First() == 50 - TEST_ROWS + 1);
+    CHECK(viewport.ScrollTo(50 - TEST_ROWS));
+    CHECK(viewport.First() == 50 - TEST_ROWS);
+}
+
+/**
+ * A list shorter than the screen never scrolls, and Last() stops at the end
+ * of the list rather than the screen.
+ */
+static void TestShortList()
+{
+    Viewport viewport;
+    Layout(&viewport, 3);
+    CHECK(viewport.First() == 0 && viewport.Last() == 3);
+    CHECK(!viewport.ScrollTo(2));
+    CHECK(!viewport.IsVisible(3));
+
+    /* Nor does an empty one */
+    viewport.SetCount(0);
+    CHECK(viewport.First() == 0 && viewport.Last() == 0);
+    CHECK(!viewport.IsVisible(0));
+}
+
+/**
+ * When the list shrinks out from under the view, it's pulled back so the
+ * bottom of the screen isn't left empty.
+ */
+static void TestShrink()
+{
+    Viewport viewport;
+    Layout(&viewport, 1000);
+    viewport.ScrollTo(999);
+
+    viewport.SetCount(500);
+    CHECK(viewport.First() == 500 - TEST_ROWS && viewport.Last() == 500);
+
+    viewport.SetCount(5);
+    CHECK(viewport.First() == 0 && viewport.Last() == 5);
+
+    /* Growing again leaves the view where it was */
+    viewport.SetCount(1000);
+    CHECK(viewport.First() == 0 && viewport.Last() == TEST_ROWS);
+}
+
+/**
+ * A screen too short for even one row still shows one, and rows map to and
+ * from pixels either side of the scroll position.
+ */
+static void TestRows()
+{
+    Viewport viewport;
+    viewport.SetLayout(TEST_ROW_HEIGHT, TEST_ROW_PADDING, TEST_ROW_PADDING);
+    CHECK(viewport.Rows() == 1);
+    viewport.SetLayout(TEST_ROW_HEIGHT, TEST_ROW_PADDING, 0);
+    CHECK(viewport.Rows() == 1);
+
+    Layout(&viewport, 1000);
+    viewport.ScrollTo(20);
+    unsigned int first = viewport.First();
+    unsigned int stride = TEST_ROW_HEIGHT + TEST_ROW_PADDING;
+    CHECK(viewport.RowTop(first) == TEST_ROW_PADDING);
+    CHECK(viewport.RowTop(first + 2) == (int)(2 * stride) + TEST_ROW_PADDING);
+    CHECK(viewport.RowTop(first - 1) == TEST_ROW_PADDING - (int)stride);
+
+    CHECK(viewport.RowAt(-5) == first);
+    CHECK(viewport.RowAt(0) == first);
+    CHECK(viewport.RowAt(stride - 1) == first);
+    CHECK(viewport.RowAt(stride) == first + 1);
+    CHECK(viewport.RowAt(viewport.RowTop(first + 4)) == first + 4);
+}
+
+int main()
+{
+    TestEnds();
+    TestStep();
+    TestShortList();
+    TestShrink();
+    TestRows();
+
+    return TEST_RESULT();
+}